@@ -0,0 +1,48 @@
+# Runs the solver twice, with the options of REFERENCE_ARGS and of TESTED_ARGS
+# (semicolon separated lists), and fails when the dumped fields differ. The
+# tested run is prefixed by TESTED_LAUNCHER when given, such as an mpiexec
+# command whose processes each dump their own cells to <dump>.<rank>: these
+# dumps are then merged and compared with the reference line by line.
+#   cmake -DFDTD=<solver> -DREFERENCE_ARGS=<...> -DTESTED_ARGS=<...>
+#         [-DTESTED_LAUNCHER=<...>] -DOUTPUT=<prefix> -P compare-runs.cmake
+
+file(GLOB stale_dumps ${OUTPUT}_TESTED.dat.*)
+if(stale_dumps)
+  file(REMOVE ${stale_dumps})
+endif()
+
+foreach(run IN ITEMS REFERENCE TESTED)
+  execute_process(COMMAND ${${run}_LAUNCHER} ${FDTD} ${${run}_ARGS}
+                          -q -o ${OUTPUT}_${run}.dat
+                  RESULT_VARIABLE result
+                  OUTPUT_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${run} run failed: ${${run}_LAUNCHER} ${FDTD} "
+                        "${${run}_ARGS}")
+  endif()
+endforeach()
+
+file(GLOB rank_dumps ${OUTPUT}_TESTED.dat.*)
+if(rank_dumps)
+  file(STRINGS ${OUTPUT}_REFERENCE.dat reference_lines REGEX "^[^#]")
+  set(tested_lines)
+  foreach(dump IN LISTS rank_dumps)
+    file(STRINGS ${dump} dump_lines REGEX "^[^#]")
+    list(APPEND tested_lines ${dump_lines})
+  endforeach()
+  list(SORT reference_lines)
+  list(SORT tested_lines)
+  if(reference_lines STREQUAL tested_lines)
+    set(result 0)
+  else()
+    set(result 1)
+  endif()
+else()
+  execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+                          ${OUTPUT}_REFERENCE.dat ${OUTPUT}_TESTED.dat
+                  RESULT_VARIABLE result)
+endif()
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "The fields of \"${TESTED_ARGS}\" differ from the ones "
+                      "of \"${REFERENCE_ARGS}\"")
+endif()
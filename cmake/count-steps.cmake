@@ -0,0 +1,18 @@
+# Runs the solver with the options of ARGS (semicolon separated list) and fails
+# when its progress lines do not report STEPS time steps. Every step prints a
+# line as long as the run takes less than 20 steps.
+#   cmake -DFDTD=<solver> -DARGS=<...> -DSTEPS=<count> -P count-steps.cmake
+
+execute_process(COMMAND ${FDTD} ${ARGS}
+                RESULT_VARIABLE result
+                OUTPUT_VARIABLE output)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "The run failed: ${FDTD} ${ARGS}")
+endif()
+
+string(REGEX MATCHALL "[0-9]+% -- t=" progress "${output}")
+list(LENGTH progress num_steps)
+if(NOT num_steps EQUAL STEPS)
+  message(FATAL_ERROR "\"${ARGS}\" took ${num_steps} time steps instead of "
+                      "${STEPS}")
+endif()
@@ -52,16 +52,16 @@ struct fdtd {
   };
 };
 
-inline void run_fdtd(struct fdtd *fdtd, float_type end_time, bool verbose) {
+inline void run_fdtd(struct fdtd *fdtd, size_t num_steps, bool verbose) {
   switch (fdtd->type) {
   case fdtd_one_dim:
-    run_1D_fdtd(&fdtd->oneDim, end_time, verbose);
+    run_1D_fdtd(&fdtd->oneDim, num_steps, verbose);
     break;
   case fdtd_two_dims:
-    run_2D_fdtd(&fdtd->twoDims, end_time, verbose);
+    run_2D_fdtd(&fdtd->twoDims, num_steps, verbose);
     break;
   case fdtd_three_dims:
-    run_3D_fdtd(&fdtd->threeDims, end_time, verbose);
+    run_3D_fdtd(&fdtd->threeDims, num_steps, verbose);
     break;
   }
 }
@@ -81,6 +81,21 @@ inline void dump_fdtd(const struct fdtd *fdtd, const char *fileName,
   }
 }
 
+inline void snapshot_fdtd(const struct fdtd *fdtd,
+                          struct fdtd_field_snapshot *snapshot) {
+  switch (fdtd->type) {
+  case fdtd_one_dim:
+    snapshot_1D_fdtd(&fdtd->oneDim, snapshot);
+    break;
+  case fdtd_two_dims:
+    snapshot_2D_fdtd(&fdtd->twoDims, snapshot);
+    break;
+  case fdtd_three_dims:
+    snapshot_3D_fdtd(&fdtd->threeDims, snapshot);
+    break;
+  }
+}
+
 inline void free_fdtd(struct fdtd *fdtd) {
   switch (fdtd->type) {
   case fdtd_one_dim:
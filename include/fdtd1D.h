@@ -32,7 +32,9 @@
 #define FDTD1D_H_
 
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 enum border_position1D { border_oneside = 0, border_otherside, num_borders_1D };
@@ -40,10 +42,12 @@ enum border_position1D { border_oneside = 0, border_otherside, num_borders_1D };
 struct fdtd1D {
   const float_type dx;                   // Space step
   const float_type dt;                   // Time step
-  float_type *restrict ez;               // Electric Field
-  float_type *restrict hy;               // Magnetic field
-  float_type *restrict permittivity_inv; // 1 / Permittivity
-  float_type *restrict permeability_inv; // 1 / Permeability
+  field_type *restrict ez;               // Electric Field
+  field_type *restrict hy;               // Magnetic field
+  float_type *restrict ca;               // E = ca * E + cb * curl H, with
+  float_type *restrict cb;               // dt and the conductivity folded in
+  float_type *restrict da;               // H = da * H + db * curl E, with
+  float_type *restrict db;               // dt and the conductivity folded in
   const enum border_condition
       border_condition[num_borders_1D]; // Border condition
   const float_type domain_size;         // Physical domain size
@@ -56,6 +60,7 @@ struct fdtd1D {
   struct fdtd_source *Msources;         // Magnetic Sources
   uintmax_t *MsourceLocations;          // Location of the Magnetic sources
   float_type time;                      // Sipermeability_revlation time
+  struct fdtd_arena arena;              // Storage of the fields and media
 };
 
 struct fdtd1D init_fdtd_1D(float_type domain_size, float_type Sc,
@@ -67,11 +72,27 @@ typedef float_type (*init_medium_fun)(float_type, void *);
 void init_fdtd_1D_medium(struct fdtd1D *fdtd, init_medium_fun permeability_revR,
                          init_medium_fun permittivity_invR, void *user);
 
-void run_1D_fdtd(struct fdtd1D *fdtd, float_type end, bool verbose);
+// Medium with magnetic and electric conductivities (S/m), a NULL conductivity
+// is lossless
+void init_fdtd_1D_lossy_medium(struct fdtd1D *fdtd,
+                               init_medium_fun permeability_invR,
+                               init_medium_fun permittivity_invR,
+                               init_medium_fun magnetic_conductivityR,
+                               init_medium_fun electric_conductivityR,
+                               void *user);
+
+// Bytes of the arrays allocated by init_fdtd_1D
+size_t memory_footprint_1D_fdtd(float_type domain_size,
+                                float_type smallest_wavelength);
+
+void run_1D_fdtd(struct fdtd1D *fdtd, size_t num_steps, bool verbose);
 
 void dump_1D_fdtd(const struct fdtd1D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump);
 
+void snapshot_1D_fdtd(const struct fdtd1D *fdtd,
+                      struct fdtd_field_snapshot *snapshot);
+
 void free_1D_fdtd(struct fdtd1D *fdtd);
 
 void add_source_fdtd_1D(enum source_type sType, struct fdtd1D *fdtd,
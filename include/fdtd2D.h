@@ -32,8 +32,10 @@
 #define FDTD2D_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
 
 #define arrayOffset2D(sizex, sizey, x, y) ((sizey * x) + y)
 #define VLA_2D_definition(type, size1, size2, name, ptr)                       \
@@ -49,6 +51,15 @@ enum border_position2D {
   num_borders_2D
 };
 
+// Execution strategy of the time loop
+enum fdtd2D_engine {
+  engine2D_serial = 0,      // Sequential kernels
+  engine2D_persistent_team, // One thread team for the whole time loop
+  num_engines2D,
+};
+
+extern const char *fdtd2D_engine_name[num_engines2D];
+
 struct fdtd2D {
   const float_type dx;    // Space step
   const float_type dy;    // Space step
@@ -56,8 +67,10 @@ struct fdtd2D {
   void *ez;               // Electric Field
   void *hx;               // Magnetic field
   void *hy;               // Magnetic field
-  void *permittivity_inv; // 1 / Permittivity
-  void *permeability_inv; // 1 / Permeability
+  void *ca;               // E = ca * E + cb * curl H, with the time step and
+  void *cb;               // the electric conductivity folded in
+  void *da;               // H = da * H + db * curl E, with the time step and
+  void *db;               // the magnetic conductivity folded in
   // The psi are discrete unknowns used to update the fields e and h with CPML
   // absorbing boundaries
   void *psi_hx_y[2];            // hx psi boundary normal to y (east & west)
@@ -73,6 +86,8 @@ struct fdtd2D {
   const float_type domain_size[2];      // Physical domain size
   const uintmax_t sizeX;                // Domain size
   const uintmax_t sizeY;                // Domain size
+  const uintmax_t field_pitch;          // Cells between two field rows
+  const uintmax_t coefficient_pitch;    // Cells between two coefficient rows
   const float_type Sc;                  // Courrant number
   unsigned num_Jsources;                // Count of sources
   struct fdtd_source *Jsources;         // Electric Sources
@@ -81,6 +96,8 @@ struct fdtd2D {
   struct fdtd_source *Msources;         // Magnetic Sources
   void *MsourceLocations;               // Location of the Magnetic sources
   float_type time;                      // Simulation current time
+  enum fdtd2D_engine engine;            // Time loop execution strategy
+  struct fdtd_arena arena;              // Storage of the arrays above
 };
 
 struct fdtd2D init_fdtd_2D(float_type domain_size[2], float_type Sc,
@@ -98,11 +115,29 @@ void init_fdtd_2D_medium(struct fdtd2D *fdtd,
                          init_medium_fun_2D permeability_revR,
                          init_medium_fun_2D permittivity_invR, void *user);
 
-void run_2D_fdtd(struct fdtd2D *fdtd, float_type end, bool verbose);
+// Medium with magnetic and electric conductivities (S/m), a NULL conductivity
+// is lossless
+void init_fdtd_2D_lossy_medium(struct fdtd2D *fdtd,
+                               init_medium_fun_2D permeability_invR,
+                               init_medium_fun_2D permittivity_invR,
+                               init_medium_fun_2D magnetic_conductivityR,
+                               init_medium_fun_2D electric_conductivityR,
+                               void *user);
+
+// Upper bound of the bytes allocated by init_fdtd_2D_cpml, with CPML on every
+// border
+size_t memory_footprint_2D_fdtd(float_type domain_size[2],
+                                float_type smallest_wavelength,
+                                uintmax_t cpml_thickness);
+
+void run_2D_fdtd(struct fdtd2D *fdtd, size_t num_steps, bool verbose);
 
 void dump_2D_fdtd(const struct fdtd2D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump);
 
+void snapshot_2D_fdtd(const struct fdtd2D *fdtd,
+                      struct fdtd_field_snapshot *snapshot);
+
 struct fdtd_source gaussian_source(float_type delay, float_type peak_time,
                                    float_type peak_val);
 
@@ -32,8 +32,10 @@
 #define FDTD3D_H_
 
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 float_type gaussian_pulse_val(float_type time, struct fdtd_source *src);
 
@@ -51,6 +53,92 @@ enum border_position3D {
   num_borders_3D,
 };
 
+// Parallel execution strategy of the time loop
+enum fdtd3D_engine {
+  engine3D_fork_join = 0,     // One thread team per kernel
+  engine3D_persistent_team,   // One thread team for the whole time loop
+  engine3D_split_phase,       // Persistent team overlapping the halo exchanges
+  engine3D_work_stealing,     // Tiles balanced over per-thread queues
+  engine3D_temporal_blocking, // Tiles advanced by several steps at once
+  num_engines3D,
+};
+
+extern const char *fdtd3D_engine_name[num_engines3D];
+
+// Sweeps of the E and H bulk updates
+enum fdtd3D_kernel {
+  kernel3D_per_component = 0, // One pass over the volume per component
+  kernel3D_fused,             // One pass updating the three components
+  kernel3D_fused_cpml,        // Fused pass also applying the CPML rows
+  num_kernels3D,
+};
+
+extern const char *fdtd3D_kernel_name[num_kernels3D];
+
+// Storage of the update coefficients ca, cb, da and db
+enum fdtd3D_medium_storage {
+  medium3D_per_cell = 0, // Four coefficient volumes
+  medium3D_uint8_ids,    // One byte material id per cell, up to 256 media
+  medium3D_uint16_ids,   // Two bytes material id per cell, up to 65536 media
+  num_medium_storages3D,
+};
+
+extern const char *fdtd3D_medium_storage_name[num_medium_storages3D];
+
+// Storage of the grids initialized afterwards, per-cell by default
+void fdtd3D_set_medium_storage(enum fdtd3D_medium_storage storage);
+
+enum fdtd3D_medium_storage fdtd3D_get_medium_storage(void);
+
+// Layout of the six field volumes
+enum fdtd3D_field_layout {
+  field3D_separate = 0, // One volume per component
+  field3D_interleaved,  // The rows of the six components of a cell row
+                        // stored next to each other
+  field3D_bricked,      // Bricks of cells stored contiguously, the medium
+                        // volumes as well
+  num_field_layouts3D,
+};
+
+// Cells along each axis of the bricks of the bricked layout, the volumes
+// being padded to whole bricks
+#define fdtd3D_brick_edge 8
+
+extern const char *fdtd3D_field_layout_name[num_field_layouts3D];
+
+// Layout of the grids initialized afterwards, separate by default
+void fdtd3D_set_field_layout(enum fdtd3D_field_layout layout);
+
+enum fdtd3D_field_layout fdtd3D_get_field_layout(void);
+
+// Update coefficients of the distinct media, indexed by the material ids
+struct fdtd3D_material_table {
+  unsigned count;
+  float_type *ca, *cb, *da, *db;
+};
+
+// Tiles of the grid classified once the medium is initialized: the uniform
+// ones, whose cells share their E (or H) coefficients, are updated with the
+// coefficients kept in registers
+struct fdtd3D_medium_tiles {
+  uintmax_t shape[3];             // Cells per tile
+  uintmax_t count[3];             // Tiles per axis
+  bool *e_uniform, *h_uniform;    // Class of each tile, NULL if unclassified
+  float_type *ca, *cb, *da, *db;  // Coefficients of the uniform tiles
+  size_t e_tiles, h_tiles;        // Uniform tiles of each field
+  uintmax_t e_cells, h_cells;     // Cells of these tiles
+};
+
+// Shape of the medium tiles of the grids initialized afterwards, 0 for a whole
+// axis, NULL to disable the classification (default: 8x8x16)
+void fdtd3D_set_medium_tile_shape(const uintmax_t shape[3]);
+
+// Whether the verbose runs also time the row updates of the uniform and mixed
+// medium tiles, in an extra sweep over the grid (default: false)
+void fdtd3D_set_medium_tile_rates(bool measure);
+
+struct fdtd3D_decomposition;
+
 struct fdtd3D {
   const float_type dx;    // Space step
   const float_type dy;    // Space step
@@ -62,8 +150,22 @@ struct fdtd3D {
   void *ex;               // Electric Field
   void *ey;               // Electric Field
   void *ez;               // Electric Field
-  void *permittivity_inv; // 1 / Permittivity
-  void *permeability_inv; // 1 / Permeability
+  enum fdtd3D_field_layout field_layout;
+  const uintmax_t field_rows;   // Rows between two planes of a field
+  const uintmax_t field_pitch;  // Cells between two rows of a field
+  const uintmax_t bricks[3];    // Bricks per axis of the bricked layout
+  const uintmax_t medium_rows;  // Rows between two planes of the medium
+  const uintmax_t medium_pitch; // Cells between two rows of the medium
+  void *ca;               // E = ca * E + cb * curl H, with the time step and
+  void *cb;               // the electric conductivity folded in
+  void *da;               // H = da * H + db * curl E, with the time step and
+  void *db;               // the magnetic conductivity folded in
+  // Material id of each cell indexing the table, instead of the four
+  // coefficient volumes above which are then NULL
+  void *material_ids;
+  enum fdtd3D_medium_storage medium_storage;
+  struct fdtd3D_material_table materials;
+  struct fdtd3D_medium_tiles medium_tiles;
   // The psi are discrete unknowns used to update the fields e and h with CPML
   // absorbing boundaries
   void *psi_hx_y[2]; // hx psi boundary normal to y (left & right)
@@ -89,6 +191,9 @@ struct fdtd3D {
   const uintmax_t sizeX;                // Domain size
   const uintmax_t sizeY;                // Domain size
   const uintmax_t sizeZ;                // Domain size
+  const uintmax_t global_size[3];       // Whole domain size (all processes)
+  const uintmax_t offset[3];            // Global index of the local cell 0
+  struct fdtd3D_decomposition *decomposition; // Process grid (NULL if alone)
   const float_type Sc;                  // Courrant number
   unsigned num_Jsources;                // Count of sources
   struct fdtd_source *Jsources;         // Electric Sources
@@ -96,7 +201,16 @@ struct fdtd3D {
   unsigned num_Msources;                // Count of sources
   struct fdtd_source *Msources;         // Magnetic Sources
   void *MsourceLocations;               // Location of the Magnetic sources
+  uintmax_t *JsourceRows;               // Sorted rows i * sizeY + j of the
+  unsigned num_JsourceRows;             // electric sources
+  uintmax_t *MsourceRows;               // Sorted rows i * sizeY + j of the
+  unsigned num_MsourceRows;             // magnetic sources
   float_type time;                      // Simulation current time
+  enum fdtd3D_engine engine;            // Time loop execution strategy
+  enum fdtd3D_kernel kernel;            // Bulk update sweeps
+  unsigned time_tile_depth;             // Steps per temporal blocking tile
+  uintmax_t tile_shape[3]; // Cells per cache tile, 0 for the whole axis
+  struct fdtd_arena arena; // Storage of the fields, media and CPML arrays
 };
 
 struct fdtd3D init_fdtd_3D(float_type domain_size[3], float_type Sc,
@@ -108,6 +222,10 @@ struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
                                 enum border_condition borders[num_borders_3D],
                                 uintmax_t cpml_thickness);
 
+// Grid with the same cells, media and sources as fdtd, its time step set by
+// the Courant number Sc. The fields and the CPML unknowns are zero.
+struct fdtd3D clone_fdtd_3D(const struct fdtd3D *fdtd, float_type Sc);
+
 typedef float_type (*init_medium_fun_3D)(float_type, float_type, float_type,
                                          void *);
 
@@ -115,13 +233,37 @@ void init_fdtd_3D_medium(struct fdtd3D *fdtd,
                          init_medium_fun_3D permeability_invR,
                          init_medium_fun_3D permittivity_invR, void *user);
 
-void run_3D_fdtd(struct fdtd3D *fdtd, float_type end, bool verbose);
+// Medium with magnetic and electric conductivities (S/m), a NULL conductivity
+// is lossless. The losses are folded in the update coefficients and cost
+// nothing per step.
+void init_fdtd_3D_lossy_medium(struct fdtd3D *fdtd,
+                               init_medium_fun_3D permeability_invR,
+                               init_medium_fun_3D permittivity_invR,
+                               init_medium_fun_3D magnetic_conductivityR,
+                               init_medium_fun_3D electric_conductivityR,
+                               void *user);
+
+// Upper bound of the bytes allocated by init_fdtd_3D_cpml on a single
+// process, with CPML on every border and the current medium storage
+size_t memory_footprint_3D_fdtd(float_type domain_size[3],
+                                float_type smallest_wavelength,
+                                uintmax_t cpml_thickness);
+
+void run_3D_fdtd(struct fdtd3D *fdtd, size_t num_steps, bool verbose);
 
 void dump_3D_fdtd(const struct fdtd3D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump);
 
+// Single process grids only, the halos would be taken for owned cells
+void snapshot_3D_fdtd(const struct fdtd3D *fdtd,
+                      struct fdtd_field_snapshot *snapshot);
+
 void free_3D_fdtd(struct fdtd3D *fdtd);
 
+// Nodes holding the pages of the arrays, meaningful once the kernels have
+// touched them
+void print_memory_placement_3D(const struct fdtd3D *fdtd, FILE *out);
+
 void add_source_fdtd_3D(enum source_type sType, struct fdtd3D *fdtd,
                         struct fdtd_source src, float_type positionX,
                         float_type positionY, float_type positionZ);
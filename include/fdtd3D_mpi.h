@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD3D_MPI_H_
+#define FDTD3D_MPI_H_
+
+#include "fdtd3D.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum fdtd3D_halo {
+  halo_electric,
+  halo_magnetic,
+};
+
+// Time spent around the halo exchanges, accumulated over num_steps steps
+struct fdtd3D_halo_timings {
+  bool overlapped;  // Split-phase schedule, otherwise blocking exchanges
+  size_t num_steps; // Steps accounted in the accumulated times
+  double boundary;  // Update of the cells sent to the neighbours
+  double interior;  // Update of the other cells while the transfers run
+  double wait;      // Time spent waiting for the transfers to complete
+  double reference; // Non overlapped exchanges of the first step
+};
+
+#ifdef FDTD_USE_MPI
+
+#include <mpi.h>
+
+#ifdef FDTD_USE_DOUBLE
+#define MPI_FLOAT_TYPE MPI_DOUBLE
+#else
+#define MPI_FLOAT_TYPE MPI_FLOAT
+#endif
+
+// The 16-bit fields are exchanged as their raw bits
+#if defined(FDTD_FIELD_FP16) || defined(FDTD_FIELD_BF16)
+#define MPI_FIELD_TYPE MPI_UINT16_T
+#else
+#define MPI_FIELD_TYPE MPI_FLOAT_TYPE
+#endif
+
+// Cartesian splitting of the 3D grid over the MPI processes. Every local
+// block carries a one cell halo on the sides shared with a neighbour.
+struct fdtd3D_decomposition {
+  MPI_Comm comm;            // Cartesian communicator
+  int rank;                 // Rank inside comm
+  int dims[3];              // Number of processes along each axis
+  int coords[3];            // Coordinates of this process in the grid
+  int neighbour[3][2];      // Lower and upper neighbours or MPI_PROC_NULL
+  uintmax_t owned_begin[3]; // First owned global cell along each axis
+  uintmax_t owned_end[3];   // One past the last owned global cell
+  MPI_Datatype plane[3];    // Owned part of a plane normal to each axis
+  MPI_Request requests[36]; // Transfers of the pending halo exchange
+  int num_requests;         // Count of pending transfers
+};
+
+// Requested process grid, zeros are filled by MPI_Dims_create
+void fdtd3D_set_process_grid(const int dims[3]);
+
+// Disabled, every grid stays whole and no MPI call is made, which lets
+// threads other than the master one initialize simulations
+void fdtd3D_enable_decomposition(bool enabled);
+
+// Returns NULL when running on a single process. Otherwise the local block
+// of this process is returned through offset and local_size. The rows of
+// fields_per_row fields are interleaved in the exchanged volumes.
+struct fdtd3D_decomposition *
+fdtd3D_decompose(const uintmax_t global_size[3], uintmax_t offset[3],
+                 uintmax_t local_size[3], unsigned fields_per_row);
+
+bool fdtd3D_has_neighbour(const struct fdtd3D_decomposition *dec,
+                          unsigned axis, unsigned side);
+
+// Blocking halo exchange
+void fdtd3D_exchange_halos(struct fdtd3D *fdtd, enum fdtd3D_halo which);
+
+// Split-phase halo exchange, the owned planes adjacent to the neighbours must
+// not be written and the halo not accessed until the exchange is finished
+void fdtd3D_start_halo_exchange(struct fdtd3D *fdtd, enum fdtd3D_halo which);
+void fdtd3D_finish_halo_exchange(struct fdtd3D *fdtd);
+
+// Prints the slowest process timings on rank 0, collective over all ranks
+void fdtd3D_print_halo_timings(const struct fdtd3D *fdtd,
+                               const struct fdtd3D_halo_timings *timings,
+                               FILE *out);
+
+void fdtd3D_decomposition_free(struct fdtd3D_decomposition *dec);
+
+#else // FDTD_USE_MPI
+
+static inline struct fdtd3D_decomposition *
+fdtd3D_decompose(const uintmax_t global_size[3], uintmax_t offset[3],
+                 uintmax_t local_size[3], unsigned fields_per_row) {
+  (void)fields_per_row;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    offset[axis] = 0;
+    local_size[axis] = global_size[axis];
+  }
+  return NULL;
+}
+
+static inline bool
+fdtd3D_has_neighbour(const struct fdtd3D_decomposition *dec, unsigned axis,
+                     unsigned side) {
+  (void)dec;
+  (void)axis;
+  (void)side;
+  return false;
+}
+
+static inline void fdtd3D_exchange_halos(struct fdtd3D *fdtd,
+                                         enum fdtd3D_halo which) {
+  (void)fdtd;
+  (void)which;
+}
+
+static inline void fdtd3D_start_halo_exchange(struct fdtd3D *fdtd,
+                                              enum fdtd3D_halo which) {
+  (void)fdtd;
+  (void)which;
+}
+
+static inline void fdtd3D_finish_halo_exchange(struct fdtd3D *fdtd) {
+  (void)fdtd;
+}
+
+static inline void
+fdtd3D_print_halo_timings(const struct fdtd3D *fdtd,
+                          const struct fdtd3D_halo_timings *timings,
+                          FILE *out) {
+  (void)fdtd;
+  (void)timings;
+  (void)out;
+}
+
+static inline void
+fdtd3D_decomposition_free(struct fdtd3D_decomposition *dec) {
+  (void)dec;
+}
+
+#endif // FDTD_USE_MPI
+
+#endif // FDTD3D_MPI_H_
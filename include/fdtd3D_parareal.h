@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD3D_PARAREAL_H_
+#define FDTD3D_PARAREAL_H_
+
+#include "fdtd3D.h"
+#include <stdbool.h>
+
+// Parallel in time integration: the time range is split into slices, a coarse
+// propagator taking larger time steps predicts the state at the slice
+// boundaries and the fine propagators correct all the slices concurrently
+// until the boundary states stop changing.
+struct fdtd3D_parareal {
+  unsigned num_slices; // Time slices, 0 disables the parareal mode
+  unsigned coarsening; // Coarse time step in fine time steps
+  double tolerance;    // Relative correction ending the iterations
+};
+
+// Advances fdtd by num_steps time steps like run_3D_fdtd and reports the
+// iterations and the error against a serial run of the fine propagator
+void run_3D_parareal(struct fdtd3D *fdtd, size_t num_steps,
+                     const struct fdtd3D_parareal *config, bool verbose);
+
+#endif // FDTD3D_PARAREAL_H_
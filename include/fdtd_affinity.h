@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD_AFFINITY_H_
+#define FDTD_AFFINITY_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Placement of the OpenMP threads on the CPUs the process may run on
+enum fdtd_affinity_policy {
+  affinity_none = 0, // Threads left to the operating system scheduler
+  affinity_compact,  // Consecutive threads on sibling hardware threads
+  affinity_scatter,  // Consecutive threads spread over packages then cores
+  affinity_cores,    // One thread per physical core, siblings left idle
+  affinity_list,     // Explicit CPU list, thread i on the i-th CPU
+  num_affinity_policies,
+};
+
+extern const char *fdtd_affinity_policy_name[num_affinity_policies];
+
+void fdtd_set_affinity_policy(enum fdtd_affinity_policy policy);
+
+// Selects the affinity_list policy with a list such as "0-3,8,10", returns
+// false when the list is malformed
+bool fdtd_set_affinity_cpu_list(const char *list);
+
+// Pins every thread of the OpenMP pool, and the master thread doing the I/O,
+// following the policy. The threads of the process are placed as the threads
+// first_thread onwards of the policy, so that the processes sharing a node
+// take distinct CPUs. The mapping is printed when out is not NULL.
+void fdtd_apply_affinity(FILE *out, unsigned first_thread);
+
+#endif // FDTD_AFFINITY_H_
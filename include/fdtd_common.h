@@ -31,15 +31,41 @@
 #ifndef FDTD_COMMON_H_
 #define FDTD_COMMON_H_
 
+#include "fdtd_precision.h"
+
 #ifdef FDTD_USE_DOUBLE
 typedef double float_type;
 #define float_cst(a) a
+#define float_type_precision precision_double
 #else
 typedef float float_type;
 #define float_cst(a) a##f
+#define float_type_precision precision_float
+#endif
+
+// Storage of the fields, the fp16 and bf16 values being widened to float_type
+// by the arithmetic and rounded when stored
+#if defined(FDTD_FIELD_FP16)
+typedef _Float16 field_type;
+#define field_type_precision precision_fp16
+#elif defined(FDTD_FIELD_BF16)
+typedef __bf16 field_type;
+#define field_type_precision precision_bf16
+#else
+typedef float_type field_type;
+#define field_type_precision float_type_precision
+#endif
+
+// Storage of the CPML unknowns, which hold curls scaled by the inverse of the
+// cell size: beyond the fp16 range, they stay in float_type with fp16 fields
+#if defined(FDTD_FIELD_BF16)
+typedef field_type psi_type;
+#else
+typedef float_type psi_type;
 #endif
 
 #include <inttypes.h>
+#include <stdio.h>
 #include <tgmath.h>
 
 #undef M_PI
@@ -48,7 +74,7 @@ typedef float float_type;
 #define mu0 (float_cst(4.) * M_PI * float_cst(1e-7))
 #define eps0 (float_cst(625000.) / (float_cst(22468879468420441.) * M_PI))
 
-#define c_light 299792458
+#define c_light float_cst(299792458.)
 #define c_lightf float_cst(c_light.)
 
 // CPML constant 1 <= kappa <= 20
@@ -100,13 +126,20 @@ enum dumpable_data {
   dump_hx,           // Hx
   dump_hy,           // Hy
   dump_hz,           // Hy
-  dump_permittivity, // 1 / permittivity
-  dump_permeability, // 1 / Permeability
+  dump_permittivity, // Cb, dt / permittivity in lossless media
+  dump_permeability, // Db, dt / permeability in lossless media
   num_dumpable_data
 };
 
 extern const char *dumpable_data_name[num_dumpable_data];
 
+// Comment line opening the dump files, naming the data and the precision of
+// the solver that wrote them
+void fdtd_dump_header(FILE *out, enum dumpable_data what_to_dump);
+
+// Copy of the cells of a field widened to double, for the snapshots
+double *fdtd_widen_field(const field_type *field, size_t cells);
+
 // Distance 0            = interface CPML / simulation medium
 // Distance region_width = simulation border
 inline float_type Kappa(uintmax_t dist_from_border,
@@ -152,4 +185,20 @@ inline float_type c(uintmax_t dist_from_border, uintmax_t CPML_region_width,
           float_cst(1.));
 }
 
+// Update F = a * F + b * curl of a field in a medium of inverse permittivity
+// (or permeability) inv and electric (or magnetic) conductivity sigma, with
+// the semi-implicit loss term averaged over the time step dt. A lossless
+// medium gives a = 1 and b = dt * inv.
+inline float_type update_coefficient_a(float_type dt, float_type inv,
+                                       float_type sigma) {
+  float_type loss = sigma * dt * inv / float_cst(2.);
+  return (float_cst(1.) - loss) / (float_cst(1.) + loss);
+}
+
+inline float_type update_coefficient_b(float_type dt, float_type inv,
+                                       float_type sigma) {
+  float_type loss = sigma * dt * inv / float_cst(2.);
+  return dt * inv / (float_cst(1.) + loss);
+}
+
 #endif // FDTD_COMMON_H_
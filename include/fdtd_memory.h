@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD_MEMORY_H_
+#define FDTD_MEMORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Physical page placement of the large solver arrays
+enum fdtd_memory_placement {
+  placement_default = 0,  // Fresh zero pages, owned by the first toucher
+  placement_first_touch,  // Zeroed in parallel with the kernel decomposition
+  placement_interleave,   // Pages interleaved round-robin over the NUMA nodes
+  num_memory_placements,
+};
+
+extern const char *fdtd_memory_placement_name[num_memory_placements];
+
+void fdtd_set_memory_placement(enum fdtd_memory_placement placement);
+
+enum fdtd_memory_placement fdtd_get_memory_placement(void);
+
+// Padding of the rows and planes of the field and medium volumes
+enum fdtd_volume_padding {
+  padding_none = 0,  // Rows and planes stored back to back
+  padding_aligned,   // Rows rounded up to whole cache lines
+  padding_staggered, // Aligned rows, and rows and planes whose strides are
+                     // not multiples of fdtd_critical_stride
+  num_volume_paddings,
+};
+
+extern const char *fdtd_volume_padding_name[num_volume_paddings];
+
+void fdtd_set_volume_padding(enum fdtd_volume_padding padding);
+
+enum fdtd_volume_padding fdtd_get_volume_padding(void);
+
+// Pages backing the simulation arenas
+enum fdtd_huge_pages {
+  huge_pages_none = 0,    // Base pages of the system
+  huge_pages_transparent, // Transparent huge pages requested with madvise
+  huge_pages_hugetlb,     // Reserved hugetlbfs pages, else transparent ones
+  num_huge_page_modes,
+};
+
+extern const char *fdtd_huge_pages_name[num_huge_page_modes];
+
+void fdtd_set_huge_pages(enum fdtd_huge_pages mode);
+
+enum fdtd_huge_pages fdtd_get_huge_pages(void);
+
+// Size of the huge pages, the arenas smaller than one keep the base pages
+#define fdtd_huge_page_size ((size_t)2 * 1024 * 1024)
+
+// Alignment of every volume and of the padded rows, a cache line holding
+// a full AVX-512 vector
+#define fdtd_cache_line 64
+
+// Strides multiple of this many bytes map the neighbouring rows or planes of
+// a stencil onto at most 8 sets of the L1 cache
+#define fdtd_critical_stride 512
+
+// Rows per plane and elements per row of a padded volume
+struct fdtd_volume_shape {
+  uintmax_t rows;
+  uintmax_t pitch;
+};
+
+// Padded shape of a [size1][size2][size3] array of elem_size bytes elements.
+// The rows are padded only when the array has more than one plane.
+struct fdtd_volume_shape fdtd_volume_shape(uintmax_t size1, uintmax_t size2,
+                                           uintmax_t size3, size_t elem_size);
+
+// Array of an arena, placed when the arena is mapped
+struct fdtd_arena_array {
+  void **ptr;       // Set to the first element of the array once mapped
+  size_t offset;    // Bytes from the start of the mapping
+  uintmax_t planes; // Planes of the array
+  uintmax_t rows;   // Rows per plane
+  size_t row_size;  // Bytes per row, padding included
+};
+
+// Single mapping holding all the arrays of a simulation. The arrays are first
+// requested, then fdtd_arena_map() lays them out one after the other, each
+// aligned on a cache line, and maps them at once. Tearing the simulation
+// down is a single fdtd_arena_free().
+struct fdtd_arena {
+  unsigned char *base;             // Start of the mapping, NULL until mapped
+  size_t size;                     // Bytes spanned by the arrays
+  size_t capacity;                 // Bytes of the mapping
+  size_t padding;                  // Bytes of padding of the arrays
+  enum fdtd_huge_pages huge_pages; // Pages backing the mapping
+  unsigned num_arrays;
+  unsigned allocated;
+  struct fdtd_arena_array *arrays; // Requested arrays, released once mapped
+};
+
+struct fdtd_arena fdtd_arena_init(void);
+
+// Requests a zero initialized [size1][size2][size3] array of elem_size bytes
+// elements, *ptr being set when the arena is mapped
+void fdtd_arena_request(struct fdtd_arena *arena, void **ptr, uintmax_t size1,
+                        uintmax_t size2, uintmax_t size3, size_t elem_size);
+
+// Requests a [size1][shape.rows][shape.pitch] array holding a
+// [size1][size2][size3] one, the padding being added to the padding report
+void fdtd_arena_request_padded(struct fdtd_arena *arena, void **ptr,
+                               uintmax_t size1, uintmax_t size2,
+                               uintmax_t size3, struct fdtd_volume_shape shape,
+                               size_t elem_size);
+
+// Upper bound of the mapping of an arena of at most num_arrays arrays
+// spanning array_bytes bytes, with the alignment of the arrays and the
+// rounding of the mapping to its pages
+size_t fdtd_arena_footprint(size_t array_bytes, unsigned num_arrays);
+
+// Maps the requested arrays following the memory placement and sets their
+// pointers
+void fdtd_arena_map(struct fdtd_arena *arena);
+
+// Resets every array of the arena to zero
+void fdtd_arena_zero(struct fdtd_arena *arena);
+
+// Copies every array of src to dst, both arenas holding the same requests
+void fdtd_arena_copy(struct fdtd_arena *dst, const struct fdtd_arena *src);
+
+void fdtd_arena_free(struct fdtd_arena *arena);
+
+// Huge pages currently backing the arena
+size_t fdtd_arena_huge_pages(const struct fdtd_arena *arena);
+
+void fdtd_print_huge_pages(FILE *out, const struct fdtd_arena *arena);
+
+// When enabled, the mappings of the freed arenas are cached and handed out
+// again to the next arenas of at most their size instead of going back to the
+// system. Must be set before any arena is mapped.
+void fdtd_set_buffer_recycling(bool enable);
+
+// Cached mappings larger than max_bytes are not handed out to the arenas
+// mapped afterwards by the calling thread, which map fresh pages instead.
+// Unlimited by default.
+void fdtd_set_buffer_reuse_limit(size_t max_bytes);
+
+struct fdtd_buffer_cache_stats {
+  size_t allocations;  // Arenas mapped since recycling was enabled
+  size_t reused;       // Arenas served by a cached mapping
+  size_t cached_bytes; // Bytes currently held by the cache
+};
+
+struct fdtd_buffer_cache_stats fdtd_get_buffer_cache_stats(void);
+
+// Releases the largest cached mappings until at most max_bytes remain cached,
+// returns the cached bytes left
+size_t fdtd_trim_buffer_cache(size_t max_bytes);
+
+struct fdtd_padding_stats {
+  size_t volumes; // Arrays of the live arenas
+  size_t bytes;   // Bytes of the live arenas, their padding included
+  size_t padding; // Bytes of padding of the live arenas
+};
+
+struct fdtd_padding_stats fdtd_get_padding_stats(void);
+
+void fdtd_print_padding_stats(FILE *out);
+
+// Per NUMA node accounting of the resident pages of a set of arrays
+struct fdtd_memory_usage {
+  unsigned num_nodes;
+  size_t *node_bytes;    // Bytes resident on each node
+  size_t non_resident;   // Bytes never touched or swapped out
+  size_t unknown;        // Bytes for which the placement could not be queried
+};
+
+struct fdtd_memory_usage fdtd_memory_usage_init(void);
+
+void fdtd_memory_usage_add(struct fdtd_memory_usage *usage, const void *ptr,
+                           size_t size);
+
+void fdtd_memory_usage_print(FILE *out, const struct fdtd_memory_usage *usage);
+
+void fdtd_memory_usage_free(struct fdtd_memory_usage *usage);
+
+#endif // FDTD_MEMORY_H_
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD_PRECISION_H_
+#define FDTD_PRECISION_H_
+
+// The precisions live in the same executable: the files depending on
+// float_type are compiled once per precision, their external symbols being
+// suffixed with the precision by the macros below, and main picks the
+// precision at run time. The fp16 and bf16 precisions compute in float and
+// store the fields in 16 bits floats.
+
+#include <stddef.h>
+#include <stdio.h>
+
+enum fdtd_precision {
+  precision_float = 0,
+  precision_double,
+  precision_fp16, // IEEE half precision fields, float arithmetic
+  precision_bf16, // bfloat16 fields, float arithmetic
+  num_precisions,
+};
+
+extern const char *fdtd_precision_name[num_precisions];
+
+// Entry points of each precision, taking the command line of main
+int fdtd_main_float(int argc, char **argv);
+int fdtd_main_double(int argc, char **argv);
+int fdtd_main_fp16(int argc, char **argv);
+int fdtd_main_bf16(int argc, char **argv);
+
+// Final fields of a run widened to double, compared by the precision report
+#define max_snapshot_components 6
+struct fdtd_field_snapshot {
+  unsigned num_components;
+  const char *name[max_snapshot_components];
+  size_t cells;     // Cells per component
+  size_t num_steps; // Time steps run before the snapshot
+  double *component[max_snapshot_components];
+};
+
+void fdtd_free_field_snapshot(struct fdtd_field_snapshot *snapshot);
+
+// Errors of the fields of a run in the given precision against the fields
+// of the same run in double precision
+void fdtd_print_precision_report(FILE *out, enum fdtd_precision precision,
+                                 const struct fdtd_field_snapshot *fields,
+                                 const struct fdtd_field_snapshot *reference);
+
+// Runs the command line on the double precision solvers for num_steps time
+// steps, without any output, and takes the snapshot of the final fields
+void fdtd_reference_fields_double(int argc, char **argv, size_t num_steps,
+                                  struct fdtd_field_snapshot *reference);
+
+#if defined(FDTD_FIELD_FP16)
+#define fdtd_precision_symbol(name) name##_fp16
+#elif defined(FDTD_FIELD_BF16)
+#define fdtd_precision_symbol(name) name##_bf16
+#elif defined(FDTD_USE_DOUBLE)
+#define fdtd_precision_symbol(name) name##_double
+#else
+#define fdtd_precision_symbol(name) name##_float
+#endif
+
+#define fdtd_main fdtd_precision_symbol(fdtd_main)
+#define fdtd_reference_fields fdtd_precision_symbol(fdtd_reference_fields)
+
+// fdtd.h
+#define dump_fdtd fdtd_precision_symbol(dump_fdtd)
+#define snapshot_fdtd fdtd_precision_symbol(snapshot_fdtd)
+#define free_fdtd fdtd_precision_symbol(free_fdtd)
+#define get_time_step_fdtd fdtd_precision_symbol(get_time_step_fdtd)
+#define run_fdtd fdtd_precision_symbol(run_fdtd)
+
+// fdtd1D.h
+#define add_source_fdtd_1D fdtd_precision_symbol(add_source_fdtd_1D)
+#define dump_1D_fdtd fdtd_precision_symbol(dump_1D_fdtd)
+#define free_1D_fdtd fdtd_precision_symbol(free_1D_fdtd)
+#define init_fdtd_1D fdtd_precision_symbol(init_fdtd_1D)
+#define init_fdtd_1D_lossy_medium                                              \
+  fdtd_precision_symbol(init_fdtd_1D_lossy_medium)
+#define init_fdtd_1D_medium fdtd_precision_symbol(init_fdtd_1D_medium)
+#define memory_footprint_1D_fdtd fdtd_precision_symbol(memory_footprint_1D_fdtd)
+#define run_1D_fdtd fdtd_precision_symbol(run_1D_fdtd)
+#define snapshot_1D_fdtd fdtd_precision_symbol(snapshot_1D_fdtd)
+
+// fdtd2D.h
+#define add_source_fdtd_2D fdtd_precision_symbol(add_source_fdtd_2D)
+#define dump_2D_fdtd fdtd_precision_symbol(dump_2D_fdtd)
+#define fdtd2D_engine_name fdtd_precision_symbol(fdtd2D_engine_name)
+#define free_2D_fdtd fdtd_precision_symbol(free_2D_fdtd)
+#define init_fdtd_2D fdtd_precision_symbol(init_fdtd_2D)
+#define init_fdtd_2D_cpml fdtd_precision_symbol(init_fdtd_2D_cpml)
+#define init_fdtd_2D_lossy_medium                                              \
+  fdtd_precision_symbol(init_fdtd_2D_lossy_medium)
+#define init_fdtd_2D_medium fdtd_precision_symbol(init_fdtd_2D_medium)
+#define memory_footprint_2D_fdtd fdtd_precision_symbol(memory_footprint_2D_fdtd)
+#define run_2D_fdtd fdtd_precision_symbol(run_2D_fdtd)
+#define snapshot_2D_fdtd fdtd_precision_symbol(snapshot_2D_fdtd)
+
+// fdtd3D.h
+#define add_source_fdtd_3D fdtd_precision_symbol(add_source_fdtd_3D)
+#define clone_fdtd_3D fdtd_precision_symbol(clone_fdtd_3D)
+#define dump_3D_fdtd fdtd_precision_symbol(dump_3D_fdtd)
+#define fdtd3D_engine_name fdtd_precision_symbol(fdtd3D_engine_name)
+#define fdtd3D_get_medium_storage                                              \
+  fdtd_precision_symbol(fdtd3D_get_medium_storage)
+#define fdtd3D_field_layout_name fdtd_precision_symbol(fdtd3D_field_layout_name)
+#define fdtd3D_get_field_layout fdtd_precision_symbol(fdtd3D_get_field_layout)
+#define fdtd3D_kernel_name fdtd_precision_symbol(fdtd3D_kernel_name)
+#define fdtd3D_medium_storage_name                                             \
+  fdtd_precision_symbol(fdtd3D_medium_storage_name)
+#define fdtd3D_set_field_layout fdtd_precision_symbol(fdtd3D_set_field_layout)
+#define fdtd3D_set_medium_storage                                              \
+  fdtd_precision_symbol(fdtd3D_set_medium_storage)
+#define fdtd3D_set_medium_tile_shape                                           \
+  fdtd_precision_symbol(fdtd3D_set_medium_tile_shape)
+#define fdtd3D_set_medium_tile_rates                                           \
+  fdtd_precision_symbol(fdtd3D_set_medium_tile_rates)
+#define free_3D_fdtd fdtd_precision_symbol(free_3D_fdtd)
+#define init_fdtd_3D fdtd_precision_symbol(init_fdtd_3D)
+#define init_fdtd_3D_cpml fdtd_precision_symbol(init_fdtd_3D_cpml)
+#define init_fdtd_3D_lossy_medium                                              \
+  fdtd_precision_symbol(init_fdtd_3D_lossy_medium)
+#define init_fdtd_3D_medium fdtd_precision_symbol(init_fdtd_3D_medium)
+#define memory_footprint_3D_fdtd fdtd_precision_symbol(memory_footprint_3D_fdtd)
+#define print_memory_placement_3D                                              \
+  fdtd_precision_symbol(print_memory_placement_3D)
+#define run_3D_fdtd fdtd_precision_symbol(run_3D_fdtd)
+#define snapshot_3D_fdtd fdtd_precision_symbol(snapshot_3D_fdtd)
+
+// fdtd3D_mpi.h
+#define fdtd3D_decompose fdtd_precision_symbol(fdtd3D_decompose)
+#define fdtd3D_decomposition_free                                              \
+  fdtd_precision_symbol(fdtd3D_decomposition_free)
+#define fdtd3D_enable_decomposition                                            \
+  fdtd_precision_symbol(fdtd3D_enable_decomposition)
+#define fdtd3D_exchange_halos fdtd_precision_symbol(fdtd3D_exchange_halos)
+#define fdtd3D_finish_halo_exchange                                            \
+  fdtd_precision_symbol(fdtd3D_finish_halo_exchange)
+#define fdtd3D_has_neighbour fdtd_precision_symbol(fdtd3D_has_neighbour)
+#define fdtd3D_print_halo_timings                                              \
+  fdtd_precision_symbol(fdtd3D_print_halo_timings)
+#define fdtd3D_set_process_grid fdtd_precision_symbol(fdtd3D_set_process_grid)
+#define fdtd3D_start_halo_exchange                                             \
+  fdtd_precision_symbol(fdtd3D_start_halo_exchange)
+
+// fdtd3D_parareal.h
+#define run_3D_parareal fdtd_precision_symbol(run_3D_parareal)
+
+// fdtd_common.h, the short names also used for variables are only renamed
+// when called
+#define Kappa(...) fdtd_precision_symbol(Kappa)(__VA_ARGS__)
+#define alpha(...) fdtd_precision_symbol(alpha)(__VA_ARGS__)
+#define b(...) fdtd_precision_symbol(b)(__VA_ARGS__)
+#define c(...) fdtd_precision_symbol(c)(__VA_ARGS__)
+#define sigma(...) fdtd_precision_symbol(sigma)(__VA_ARGS__)
+#define dumpable_data_name fdtd_precision_symbol(dumpable_data_name)
+#define fdtd_dump_header fdtd_precision_symbol(fdtd_dump_header)
+#define fdtd_widen_field fdtd_precision_symbol(fdtd_widen_field)
+#define gaussian_pulse_val fdtd_precision_symbol(gaussian_pulse_val)
+#define gaussian_source fdtd_precision_symbol(gaussian_source)
+#define update_coefficient_a fdtd_precision_symbol(update_coefficient_a)
+#define update_coefficient_b fdtd_precision_symbol(update_coefficient_b)
+
+// fdtd_simd.h
+#define fdtd_detect_kernel_isa fdtd_precision_symbol(fdtd_detect_kernel_isa)
+#define fdtd_get_kernel_isa fdtd_precision_symbol(fdtd_get_kernel_isa)
+#define fdtd_get_row_kernels fdtd_precision_symbol(fdtd_get_row_kernels)
+#define fdtd_kernel_isa_name fdtd_precision_symbol(fdtd_kernel_isa_name)
+#define fdtd_set_kernel_isa fdtd_precision_symbol(fdtd_set_kernel_isa)
+#define fdtd_row_kernels_sse2 fdtd_precision_symbol(fdtd_row_kernels_sse2)
+#define fdtd_row_kernels_avx2 fdtd_precision_symbol(fdtd_row_kernels_avx2)
+#define fdtd_row_kernels_avx512 fdtd_precision_symbol(fdtd_row_kernels_avx512)
+
+// initialize.h
+#define fdtd_memory_footprint fdtd_precision_symbol(fdtd_memory_footprint)
+#define initializeFdtd fdtd_precision_symbol(initializeFdtd)
+#define initializeFdtd_cmpl fdtd_precision_symbol(initializeFdtd_cmpl)
+
+#endif // FDTD_PRECISION_H_
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD_SIMD_H_
+#define FDTD_SIMD_H_
+
+#include "fdtd_common.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Instruction sets of the row kernels of the E and H updates
+enum fdtd_kernel_isa {
+  kernel_isa_scalar = 0, // Plain C loops, vectorised by the compiler
+  kernel_isa_sse2,       // 128 bits vectors
+  kernel_isa_avx2,       // 256 bits vectors
+  kernel_isa_avx512,     // 512 bits vectors
+  num_kernel_isas,
+};
+
+extern const char *fdtd_kernel_isa_name[num_kernel_isas];
+
+// out[k] = ca[k] * out[k] + (a[k] - b[k]) * c1 * cb[k] for k in [0, n)
+typedef void (*fdtd_curl1_row_fun)(uintmax_t n, field_type *out,
+                                   const field_type *a, const field_type *b,
+                                   float_type c1, const float_type *ca,
+                                   const float_type *cb);
+
+// out[k] = ca[k] * out[k] + ((a[k] - b[k]) * c1 - (c[k] - d[k]) * c2) * cb[k]
+// for k in [0, n)
+typedef void (*fdtd_curl2_row_fun)(uintmax_t n, field_type *out,
+                                   const field_type *a, const field_type *b,
+                                   const field_type *c, const field_type *d,
+                                   float_type c1, float_type c2,
+                                   const float_type *ca, const float_type *cb);
+
+// curl2 with the coefficients ca and cb shared by the n cells, kept in
+// registers instead of being loaded per cell
+typedef void (*fdtd_curl2_uniform_row_fun)(uintmax_t n, field_type *out,
+                                           const field_type *a,
+                                           const field_type *b,
+                                           const field_type *c,
+                                           const field_type *d, float_type c1,
+                                           float_type c2, float_type ca,
+                                           float_type cb);
+
+// Row kernels of one instruction set. Every set performs the operations of
+// the scalar expressions in the same order, without contraction, so that
+// they all give the same fields. The fields are widened to float_type when
+// loaded and rounded to field_type when stored.
+struct fdtd_row_kernels {
+  fdtd_curl1_row_fun curl1;
+  fdtd_curl2_row_fun curl2;
+  fdtd_curl2_uniform_row_fun curl2_uniform;
+};
+
+extern const struct fdtd_row_kernels fdtd_row_kernels_sse2;
+extern const struct fdtd_row_kernels fdtd_row_kernels_avx2;
+extern const struct fdtd_row_kernels fdtd_row_kernels_avx512;
+
+// Widest instruction set supported by both the build and the CPU
+enum fdtd_kernel_isa fdtd_detect_kernel_isa(void);
+
+// Selects the row kernels, returns false when the build or the CPU lacks the
+// instruction set
+bool fdtd_set_kernel_isa(enum fdtd_kernel_isa isa);
+
+enum fdtd_kernel_isa fdtd_get_kernel_isa(void);
+
+// Row kernels of the selected instruction set (scalar until one is set)
+const struct fdtd_row_kernels *fdtd_get_row_kernels(void);
+
+#endif // FDTD_SIMD_H_
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Row kernels written once for every instruction set. The including
+// fdtd_simd_<isa>.c file defines the vector type and operations:
+//   vec_t, vec_width, vec_load, vec_store, vec_set1, vec_add, vec_sub,
+//   vec_mul
+// the loads and stores of field_type widening and rounding the values:
+//   vec_load_field, vec_store_field
+// and row_kernel(name), which suffixes the function names with the set.
+// The vector part of the row and its scalar remainder perform the same
+// operations in the same order as the scalar kernels.
+
+#ifndef FDTD_SIMD_ROWS_H_
+#define FDTD_SIMD_ROWS_H_
+
+#include "fdtd_simd.h"
+
+static void row_kernel(curl1)(uintmax_t n, field_type *restrict out,
+                              const field_type *restrict a,
+                              const field_type *restrict b, float_type c1,
+                              const float_type *restrict ca,
+                              const float_type *restrict cb) {
+  const vec_t vc1 = vec_set1(c1);
+  uintmax_t k = 0;
+  for (; k + vec_width <= n; k += vec_width) {
+    const vec_t diff = vec_sub(vec_load_field(a + k), vec_load_field(b + k));
+    const vec_t update = vec_mul(vec_mul(diff, vc1), vec_load(cb + k));
+    vec_store_field(out + k, vec_add(vec_mul(vec_load(ca + k),
+                                             vec_load_field(out + k)),
+                                     update));
+  }
+  for (; k < n; ++k)
+    out[k] = ca[k] * out[k] + (a[k] - b[k]) * c1 * cb[k];
+}
+
+static void row_kernel(curl2)(uintmax_t n, field_type *restrict out,
+                              const field_type *restrict a,
+                              const field_type *restrict b,
+                              const field_type *restrict c,
+                              const field_type *restrict d, float_type c1,
+                              float_type c2, const float_type *restrict ca,
+                              const float_type *restrict cb) {
+  const vec_t vc1 = vec_set1(c1);
+  const vec_t vc2 = vec_set1(c2);
+  uintmax_t k = 0;
+  for (; k + vec_width <= n; k += vec_width) {
+    const vec_t curl = vec_sub(
+        vec_mul(vec_sub(vec_load_field(a + k), vec_load_field(b + k)), vc1),
+        vec_mul(vec_sub(vec_load_field(c + k), vec_load_field(d + k)), vc2));
+    const vec_t update = vec_mul(curl, vec_load(cb + k));
+    vec_store_field(out + k, vec_add(vec_mul(vec_load(ca + k),
+                                             vec_load_field(out + k)),
+                                     update));
+  }
+  for (; k < n; ++k)
+    out[k] =
+        ca[k] * out[k] + ((a[k] - b[k]) * c1 - (c[k] - d[k]) * c2) * cb[k];
+}
+
+static void row_kernel(curl2_uniform)(uintmax_t n, field_type *restrict out,
+                                      const field_type *restrict a,
+                                      const field_type *restrict b,
+                                      const field_type *restrict c,
+                                      const field_type *restrict d,
+                                      float_type c1, float_type c2,
+                                      float_type ca, float_type cb) {
+  const vec_t vc1 = vec_set1(c1);
+  const vec_t vc2 = vec_set1(c2);
+  const vec_t vca = vec_set1(ca);
+  const vec_t vcb = vec_set1(cb);
+  uintmax_t k = 0;
+  for (; k + vec_width <= n; k += vec_width) {
+    const vec_t curl = vec_sub(
+        vec_mul(vec_sub(vec_load_field(a + k), vec_load_field(b + k)), vc1),
+        vec_mul(vec_sub(vec_load_field(c + k), vec_load_field(d + k)), vc2));
+    vec_store_field(out + k, vec_add(vec_mul(vca, vec_load_field(out + k)),
+                                     vec_mul(curl, vcb)));
+  }
+  for (; k < n; ++k)
+    out[k] = ca * out[k] + ((a[k] - b[k]) * c1 - (c[k] - d[k]) * c2) * cb;
+}
+
+#endif // FDTD_SIMD_ROWS_H_
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FDTD_TILES_H_
+#define FDTD_TILES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Pool of independent tiles shared by a thread team. Every thread owns a
+// double ended queue filled with a contiguous block of tiles, it pops its own
+// tiles from the back and steals from the front of the other queues once its
+// queue is empty.
+struct fdtd_tile_pool;
+
+struct fdtd_tile_pool *fdtd_tile_pool_alloc(unsigned max_threads,
+                                            size_t num_tiles);
+
+// Refills the queues with all the tiles, called by one thread of the team
+// while the others wait
+void fdtd_tile_pool_fill(struct fdtd_tile_pool *pool, unsigned num_threads);
+
+// Next tile for the thread, false once every queue is empty
+bool fdtd_tile_pool_next(struct fdtd_tile_pool *pool, unsigned thread,
+                         size_t *tile);
+
+// Accounts the time spent by the thread on the tile it got from the pool
+void fdtd_tile_pool_account(struct fdtd_tile_pool *pool, unsigned thread,
+                            size_t tile, double seconds);
+
+// Per thread busy time, compared with the one of a static split of the tiles
+void fdtd_tile_pool_print_stats(const struct fdtd_tile_pool *pool, FILE *out);
+
+void fdtd_tile_pool_free(struct fdtd_tile_pool *pool);
+
+#endif // FDTD_TILES_H_
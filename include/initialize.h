@@ -40,6 +40,7 @@
 
 enum setup1D {
   half_air_half_water_1D = 0,
+  half_air_half_sea_water_1D,
   last_1D_setup,
 };
 
@@ -47,12 +48,14 @@ enum setup2D {
   west_air_east_water_west_gaussian_pulse_centered_2D = last_1D_setup + 1,
   object_high_permitivity_in_air_west_gaussian_pulse_centered_2D,
   free_space_gaussian_exitation_centered_absorbing_border_2D,
+  lossy_object_in_free_space_gaussian_exitation_absorbing_border_2D,
   last_2D_setup,
 };
 
 enum setup3D {
   half_air_half_water_3D = last_2D_setup + 1,
   air_with_object_of_high_permitivity_half_height_centered_3D,
+  half_air_half_sea_water_3D,
   last_3D_setup,
 };
 
@@ -60,6 +63,11 @@ struct fdtd initializeFdtd_cmpl(unsigned setupID, float_type *domain_size,
                                 float_type Sc, float_type smallest_wavelength,
                                 uintmax_t cmpl_thickness);
 
+// Upper bound of the bytes allocated by initializeFdtd_cmpl
+size_t fdtd_memory_footprint(unsigned setupID, float_type *domain_size,
+                             float_type smallest_wavelength,
+                             uintmax_t cpml_thickness);
+
 struct fdtd initializeFdtd(unsigned setupID, float_type *domain_size,
                            float_type Sc, float_type smallest_wavelength);
 
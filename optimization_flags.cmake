@@ -39,7 +39,7 @@ set(ADDITIONAL_DEBUG_COMPILE_OPTIONS
 
 set(ADDITIONAL_RELEASE_COMPILE_OPTIONS
   "-O3"
-  "-march=native"
+  "-ffp-contract=off"
   CACHE INTERNAL "String"
   )
 
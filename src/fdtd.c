@@ -30,9 +30,10 @@
 
 #include "fdtd.h"
 
-extern inline void run_fdtd(struct fdtd *fdtd, float_type end_time,
-                            bool verbose);
+extern inline void run_fdtd(struct fdtd *fdtd, size_t num_steps, bool verbose);
 extern inline void dump_fdtd(const struct fdtd *fdtd, const char *fileName,
                              enum dumpable_data dd);
+extern inline void snapshot_fdtd(const struct fdtd *fdtd,
+                                 struct fdtd_field_snapshot *snapshot);
 extern inline void free_fdtd(struct fdtd *fdtd);
 extern inline float_type get_time_step_fdtd(const struct fdtd *fdtd);
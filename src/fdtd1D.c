@@ -31,6 +31,8 @@
 #include "fdtd1D.h"
 #include "fdtd.h"
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
+#include "fdtd_simd.h"
 #include "time_measurement.h"
 #include <inttypes.h>
 #include <stdio.h>
@@ -39,12 +41,11 @@
 #include <time.h>
 
 static void update_electric_field(struct fdtd1D *fdtd) {
-  float_type dtdx = fdtd->dt / fdtd->dx;
+  float_type _dx = float_cst(1.) / fdtd->dx;
 
-  for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
-    fdtd->ez[i] = fdtd->ez[i] + (fdtd->hy[i] - fdtd->hy[i - 1]) * dtdx *
-                                    fdtd->permittivity_inv[i];
-  }
+  fdtd_get_row_kernels()->curl1(fdtd->sizeX - 1, &fdtd->ez[1], &fdtd->hy[1],
+                                &fdtd->hy[0], _dx, &fdtd->ca[1],
+                                &fdtd->cb[1]);
 }
 
 static void border_condition_electric(struct fdtd1D *fdtd) {
@@ -57,12 +58,11 @@ static void border_condition_electric(struct fdtd1D *fdtd) {
 }
 
 static void update_magnetic_field(struct fdtd1D *fdtd) {
-  float_type dtdx = fdtd->dt / fdtd->dx;
+  float_type _dx = float_cst(1.) / fdtd->dx;
 
-  for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    fdtd->hy[i] = fdtd->hy[i] + (fdtd->ez[i + 1] - fdtd->ez[i]) * dtdx *
-                                    fdtd->permeability_inv[i];
-  }
+  fdtd_get_row_kernels()->curl1(fdtd->sizeX - 1, &fdtd->hy[0], &fdtd->ez[1],
+                                &fdtd->ez[0], _dx, &fdtd->da[0],
+                                &fdtd->db[0]);
 }
 
 static void border_condition_magnetic(struct fdtd1D *fdtd) {
@@ -100,17 +100,37 @@ static void apply_J_sources(struct fdtd1D *fdtd) {
   }
 }
 
-void init_fdtd_1D_medium(struct fdtd1D *fdtd, init_medium_fun permeability_invR,
-                         init_medium_fun permittivity_invR, void *user) {
+void init_fdtd_1D_lossy_medium(struct fdtd1D *fdtd,
+                               init_medium_fun permeability_invR,
+                               init_medium_fun permittivity_invR,
+                               init_medium_fun magnetic_conductivityR,
+                               init_medium_fun electric_conductivityR,
+                               void *user) {
   float_type pos = float_cst(0.);
   for (uintmax_t i = 0; i < fdtd->sizeX; ++i, pos += fdtd->dx) {
-    fdtd->permeability_inv[i] =
+    const float_type permeability_inv =
         float_cst(1.) / (permeability_invR(pos, user) * mu0);
-    fdtd->permittivity_inv[i] =
+    const float_type permittivity_inv =
         float_cst(1.) / (permittivity_invR(pos, user) * eps0);
+    const float_type sigma_m = magnetic_conductivityR == NULL
+                                   ? float_cst(0.)
+                                   : magnetic_conductivityR(pos, user);
+    const float_type sigma_e = electric_conductivityR == NULL
+                                   ? float_cst(0.)
+                                   : electric_conductivityR(pos, user);
+    fdtd->da[i] = update_coefficient_a(fdtd->dt, permeability_inv, sigma_m);
+    fdtd->db[i] = update_coefficient_b(fdtd->dt, permeability_inv, sigma_m);
+    fdtd->ca[i] = update_coefficient_a(fdtd->dt, permittivity_inv, sigma_e);
+    fdtd->cb[i] = update_coefficient_b(fdtd->dt, permittivity_inv, sigma_e);
   }
 }
 
+void init_fdtd_1D_medium(struct fdtd1D *fdtd, init_medium_fun permeability_invR,
+                         init_medium_fun permittivity_invR, void *user) {
+  init_fdtd_1D_lossy_medium(fdtd, permeability_invR, permittivity_invR, NULL,
+                            NULL, user);
+}
+
 // Permittivity of metal as free space
 struct fdtd1D init_fdtd_1D(float_type domain_size, float_type Sc,
                            float_type smallest_wavelength,
@@ -120,13 +140,24 @@ struct fdtd1D init_fdtd_1D(float_type domain_size, float_type Sc,
   float_type dt = dx * Sc / c_light;
   float_type sizeXf = ceil(domain_size / dx);
   uintmax_t sizeX = (uintmax_t)sizeXf;
+  struct fdtd_arena arena = fdtd_arena_init();
+  void *ez, *hy, *ca, *cb, *da, *db;
+  fdtd_arena_request(&arena, &ez, 1, 1, sizeX, sizeof(field_type));
+  fdtd_arena_request(&arena, &hy, 1, 1, sizeX, sizeof(field_type));
+  fdtd_arena_request(&arena, &ca, 1, 1, sizeX, sizeof(float_type));
+  fdtd_arena_request(&arena, &cb, 1, 1, sizeX, sizeof(float_type));
+  fdtd_arena_request(&arena, &da, 1, 1, sizeX, sizeof(float_type));
+  fdtd_arena_request(&arena, &db, 1, 1, sizeX, sizeof(float_type));
+  fdtd_arena_map(&arena);
   struct fdtd1D fdtd = {
       .dx = dx,
       .dt = dt,
-      .ez = calloc(sizeX, sizeof(float_type)),
-      .hy = calloc(sizeX, sizeof(float_type)),
-      .permittivity_inv = calloc(sizeX, sizeof(float_type)),
-      .permeability_inv = calloc(sizeX, sizeof(float_type)),
+      .ez = ez,
+      .hy = hy,
+      .ca = ca,
+      .cb = cb,
+      .da = da,
+      .db = db,
       .border_condition = {[border_oneside] = borders[border_oneside],
                            [border_otherside] = borders[border_otherside]},
       .domain_size = domain_size,
@@ -139,14 +170,27 @@ struct fdtd1D init_fdtd_1D(float_type domain_size, float_type Sc,
       .Msources = NULL,
       .MsourceLocations = NULL,
       .time = 0,
+      .arena = arena,
   };
   fprintf(stderr, "Dt %e Dx %e (%.0f)\n", dt, dx, sizeXf);
 
   return fdtd;
 }
 
-void run_1D_fdtd(struct fdtd1D *fdtd, float_type end_time, bool verbose) {
-  const double num_iter_d = ceil((end_time - fdtd->time) / fdtd->dt);
+size_t memory_footprint_1D_fdtd(float_type domain_size,
+                                float_type smallest_wavelength) {
+  float_type dx = smallest_wavelength / float_cst(20.);
+  float_type sizeXf = ceil(domain_size / dx);
+  uintmax_t sizeX = (uintmax_t)sizeXf;
+  // 2 fields and their 4 coefficients
+  return fdtd_arena_footprint(
+      sizeX * (2 * sizeof(field_type) + 4 * sizeof(float_type)), 6);
+}
+
+void run_1D_fdtd(struct fdtd1D *fdtd, size_t num_steps, bool verbose) {
+  const double num_iter_d = (double)num_steps;
+  // Only reported by the progress lines
+  const float_type end_time = fdtd->time + (float_type)num_steps * fdtd->dt;
   double print_interval_d;
   if (num_iter_d >= 10.) {
     double divide = 1.;
@@ -164,7 +208,7 @@ void run_1D_fdtd(struct fdtd1D *fdtd, float_type end_time, bool verbose) {
   double percentage = percent_increment;
   time_measure tstart_chunk, tend_chunk;
   get_current_time(&tstart_chunk);
-  for (; fdtd->time < end_time; fdtd->time += fdtd->dt) {
+  for (size_t step = 0; step < num_steps; ++step, fdtd->time += fdtd->dt) {
     update_magnetic_field(fdtd);
     apply_M_sources(fdtd);
     border_condition_magnetic(fdtd);
@@ -188,36 +232,47 @@ void run_1D_fdtd(struct fdtd1D *fdtd, float_type end_time, bool verbose) {
 void dump_1D_fdtd(const struct fdtd1D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump) {
   FILE *out = fopen(fileName, "w");
-  float_type *array;
+  const field_type *field = NULL;
+  const float_type *coefficients = NULL;
   switch (what_to_dump) {
   case dump_ez:
-    array = fdtd->ez;
+    field = fdtd->ez;
     break;
   case dump_hy:
-    array = fdtd->hy;
+    field = fdtd->hy;
     break;
   case dump_permeability:
-    array = fdtd->permeability_inv;
+    coefficients = fdtd->db;
     break;
   case dump_permittivity:
-    array = fdtd->permittivity_inv;
+    coefficients = fdtd->cb;
     break;
   default:
     fprintf(stderr, "Dump of \"%s\" not available for 1D fdtd\n",
             dumpable_data_name[what_to_dump]);
     exit(EXIT_FAILURE);
   }
+  fdtd_dump_header(out, what_to_dump);
   for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-    fprintf(out, "%e %e\n", (float_type)i * fdtd->dx, array[i]);
+    fprintf(out, "%e %e\n", (float_type)i * fdtd->dx,
+            field != NULL ? (float_type)field[i] : coefficients[i]);
   }
   fclose(out);
 }
 
+void snapshot_1D_fdtd(const struct fdtd1D *fdtd,
+                      struct fdtd_field_snapshot *snapshot) {
+  *snapshot = (struct fdtd_field_snapshot){
+      .num_components = 2,
+      .name = {"ez", "hy"},
+      .cells = fdtd->sizeX,
+      .component = {fdtd_widen_field(fdtd->ez, fdtd->sizeX),
+                    fdtd_widen_field(fdtd->hy, fdtd->sizeX)},
+  };
+}
+
 void free_1D_fdtd(struct fdtd1D *fdtd) {
-  free(fdtd->ez);
-  free(fdtd->hy);
-  free(fdtd->permittivity_inv);
-  free(fdtd->permeability_inv);
+  fdtd_arena_free(&fdtd->arena);
   free(fdtd->JsourceLocations);
   free(fdtd->Jsources);
   free(fdtd->MsourceLocations);
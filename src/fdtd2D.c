@@ -31,6 +31,8 @@
 #include "fdtd2D.h"
 #include "fdtd.h"
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
+#include "fdtd_simd.h"
 #include "time_measurement.h"
 #include <inttypes.h>
 #include <stdint.h>
@@ -39,54 +41,58 @@
 #include <tgmath.h>
 
 static void update_electric_field(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permittivity_inv,
-                    fdtd->permittivity_inv);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, ca,
+                    fdtd->ca);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, cb,
+                    fdtd->cb);
 
   float_type _dx = float_cst(1.) / fdtd->dx;
   float_type _dy = float_cst(1.) / fdtd->dy;
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
 
+#pragma omp for
   for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
-    for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
-      ez[i][j] = ez[i][j] + ((hy[i][j] - hy[i - 1][j]) * _dx -
-                             (hx[i][j] - hx[i][j - 1]) * _dy) *
-                                fdtd->dt * permittivity_inv[i][j];
-    }
+    rows->curl2(fdtd->sizeY - 1, &ez[i][1], &hy[i][1], &hy[i - 1][1],
+                &hx[i][1], &hx[i][0], _dx, _dy, &ca[i][1], &cb[i][1]);
   }
 }
 
 static void update_electric_cpml(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, psi_ez_south,
+  VLA_2D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, psi_ez_south,
                     fdtd->psi_ez[border_south]);
-  VLA_2D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, psi_ez_north,
+  VLA_2D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, psi_ez_north,
                     fdtd->psi_ez[border_north]);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, psi_ez_east,
+  VLA_2D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, psi_ez_east,
                     fdtd->psi_ez[border_east]);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, psi_ez_west,
+  VLA_2D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, psi_ez_west,
                     fdtd->psi_ez[border_west]);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permittivity_inv,
-                    fdtd->permittivity_inv);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, cb,
+                    fdtd->cb);
 
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dx = float_cst(1.) / fdtd->dx;
 
   if (fdtd->border_condition[border_south] & border_cpml) { // ez_x
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
         psi_ez_south[i][j] = fdtd->bx[i] * psi_ez_south[i][j] +
                              fdtd->cx[i] * (hy[1 + i][j] - hy[i][j]) * _dx;
-        ez[1 + i][j] = ez[1 + i][j] + fdtd->dt * permittivity_inv[1 + i][j] *
-                                          psi_ez_south[i][j];
+        ez[1 + i][j] = ez[1 + i][j] + cb[1 + i][j] * psi_ez_south[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_north] & border_cpml) { // ez_x
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
         psi_ez_north[i][j] =
             fdtd->bx[i] * psi_ez_north[i][j] +
@@ -94,23 +100,25 @@ static void update_electric_cpml(struct fdtd2D *fdtd) {
                 (hy[fdtd->sizeX - 1 - i][j] - hy[fdtd->sizeX - 2 - i][j]) * _dx;
         ez[fdtd->sizeX - 1 - i][j] =
             ez[fdtd->sizeX - 1 - i][j] +
-            fdtd->dt * permittivity_inv[fdtd->sizeX - 1 - i][j] *
-                psi_ez_north[i][j];
+            cb[fdtd->sizeX - 1 - i][j] * psi_ez_north[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_west] & border_cpml) { // ez_y
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
         psi_ez_west[i][j] = fdtd->by[j] * psi_ez_west[i][j] +
                             fdtd->cy[j] * (hx[i][1 + j] - hx[i][j]) * _dy;
-        ez[i][1 + j] = ez[i][1 + j] - fdtd->dt * permittivity_inv[i][1 + j] *
-                                          psi_ez_west[i][j];
+        ez[i][1 + j] = ez[i][1 + j] - cb[i][1 + j] * psi_ez_west[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_east] & border_cpml) { // ez_y
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
         psi_ez_east[i][j] =
             fdtd->by[j] * psi_ez_east[i][j] +
@@ -118,15 +126,14 @@ static void update_electric_cpml(struct fdtd2D *fdtd) {
                 (hx[i][fdtd->sizeY - 1 - j] - hx[i][fdtd->sizeY - 2 - j]) * _dy;
         ez[i][fdtd->sizeY - 1 - j] =
             ez[i][fdtd->sizeY - 1 - j] -
-            fdtd->dt * permittivity_inv[i][fdtd->sizeY - 1 - j] *
-                psi_ez_east[i][j];
+            cb[i][fdtd->sizeY - 1 - j] * psi_ez_east[i][j];
       }
     }
   }
 }
 
 static void border_condition_electric(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
   for (enum border_position2D i = border_south; i < num_borders_2D; ++i) {
     if (fdtd->border_condition[i] & border_perfect_electric_conductor) {
       switch (i) {
@@ -156,59 +163,63 @@ static void border_condition_electric(struct fdtd2D *fdtd) {
 }
 
 static void update_magnetic_field(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permeability_inv,
-                    fdtd->permeability_inv);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, da,
+                    fdtd->da);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, db,
+                    fdtd->db);
 
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dx = float_cst(1.) / fdtd->dx;
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
 
+#pragma omp for nowait
   for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    for (uintmax_t j = 0; j < fdtd->sizeY - 1; ++j) {
-      hx[i][j] = hx[i][j] + (ez[i][j] - ez[i][j + 1]) * _dy * fdtd->dt *
-                                permeability_inv[i][j];
-    }
+    rows->curl1(fdtd->sizeY - 1, &hx[i][0], &ez[i][0], &ez[i][1], _dy,
+                &da[i][0], &db[i][0]);
   }
+#pragma omp for
   for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    for (uintmax_t j = 0; j < fdtd->sizeY - 1; ++j) {
-      hy[i][j] = hy[i][j] + (ez[i + 1][j] - ez[i][j]) * _dx * fdtd->dt *
-                                permeability_inv[i][j];
-    }
+    rows->curl1(fdtd->sizeY - 1, &hy[i][0], &ez[i + 1][0], &ez[i][0], _dx,
+                &da[i][0], &db[i][0]);
   }
 }
 
 static void update_magnetic_cpml(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, psi_hx_west,
+  VLA_2D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, psi_hx_west,
                     fdtd->psi_hx_y[0]);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, psi_hx_east,
+  VLA_2D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, psi_hx_east,
                     fdtd->psi_hx_y[1]);
-  VLA_2D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, psi_hy_south,
+  VLA_2D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, psi_hy_south,
                     fdtd->psi_hy_x[0]);
-  VLA_2D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, psi_hy_north,
+  VLA_2D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, psi_hy_north,
                     fdtd->psi_hy_x[1]);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permeability_inv,
-                    fdtd->permeability_inv);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, db,
+                    fdtd->db);
 
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dx = float_cst(1.) / fdtd->dx;
 
   if (fdtd->border_condition[border_west] & border_cpml) { // hx_y
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
         psi_hx_west[i][j] = fdtd->by[j] * psi_hx_west[i][j] +
                             fdtd->cy[j] * (ez[i][j] - ez[i][j + 1]) * _dy;
-        hx[i][j] =
-            hx[i][j] + fdtd->dt * permeability_inv[i][j] * psi_hx_west[i][j];
+        hx[i][j] = hx[i][j] + db[i][j] * psi_hx_west[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_east] & border_cpml) { // hx_y
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
         psi_hx_east[i][j] =
             fdtd->by[j] * psi_hx_east[i][j] +
@@ -216,23 +227,25 @@ static void update_magnetic_cpml(struct fdtd2D *fdtd) {
                 (ez[i][fdtd->sizeY - 2 - j] - ez[i][fdtd->sizeY - 1 - j]) * _dy;
         hx[i][fdtd->sizeY - 2 - j] =
             hx[i][fdtd->sizeY - 2 - j] +
-            fdtd->dt * permeability_inv[i][fdtd->sizeY - 2 - j] *
-                psi_hx_east[i][j];
+            db[i][fdtd->sizeY - 2 - j] * psi_hx_east[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_south] & border_cpml) { // hy_x
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
         psi_hy_south[i][j] = fdtd->bx[i] * psi_hy_south[i][j] +
                              fdtd->cx[i] * (ez[i + 1][j] - ez[i][j]) * _dx;
-        hy[i][j] =
-            hy[i][j] + fdtd->dt * permeability_inv[i][j] * psi_hy_south[i][j];
+        hy[i][j] = hy[i][j] + db[i][j] * psi_hy_south[i][j];
       }
     }
   }
   if (fdtd->border_condition[border_north] & border_cpml) { // hy_x
+#pragma omp for
     for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
+#pragma omp simd
       for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
         psi_hy_north[i][j] =
             fdtd->bx[i] * psi_hy_north[i][j] +
@@ -240,16 +253,15 @@ static void update_magnetic_cpml(struct fdtd2D *fdtd) {
                 (ez[fdtd->sizeX - 1 - i][j] - ez[fdtd->sizeX - 2 - i][j]) * _dx;
         hy[fdtd->sizeX - 2 - i][j] =
             hy[fdtd->sizeX - 2 - i][j] +
-            fdtd->dt * permeability_inv[fdtd->sizeX - 2 - i][j] *
-                psi_hy_north[i][j];
+            db[fdtd->sizeX - 2 - i][j] * psi_hy_north[i][j];
       }
     }
   }
 }
 
 static void border_condition_magnetic(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
   for (enum border_position2D i = border_south; i < num_borders_2D; ++i) {
     if (fdtd->border_condition[i] & border_perfect_electric_conductor) {
       switch (i) {
@@ -291,8 +303,8 @@ static void border_condition_magnetic(struct fdtd2D *fdtd) {
 }
 
 static void apply_M_sources(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hx, fdtd->hx);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, hy, fdtd->hy);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hx, fdtd->hx);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, hy, fdtd->hy);
   VLA_2D_definition(uintmax_t, fdtd->num_Msources, 2, MsourceLocations,
                     fdtd->MsourceLocations);
   for (uintmax_t i = 0; i < fdtd->num_Msources; ++i) {
@@ -310,7 +322,7 @@ static void apply_M_sources(struct fdtd2D *fdtd) {
 }
 
 static void apply_J_sources(struct fdtd2D *fdtd) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, ez, fdtd->ez);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, ez, fdtd->ez);
   VLA_2D_definition(uintmax_t, fdtd->num_Jsources, 2, JsourceLocations,
                     fdtd->JsourceLocations);
   for (uintmax_t i = 0; i < fdtd->num_Jsources; ++i) {
@@ -325,25 +337,49 @@ static void apply_J_sources(struct fdtd2D *fdtd) {
   }
 }
 
-void init_fdtd_2D_medium(struct fdtd2D *fdtd,
-                         init_medium_fun_2D permeability_invR,
-                         init_medium_fun_2D permittivity_invR, void *user) {
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permittivity_inv,
-                    fdtd->permittivity_inv);
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, permeability_inv,
-                    fdtd->permeability_inv);
+void init_fdtd_2D_lossy_medium(struct fdtd2D *fdtd,
+                               init_medium_fun_2D permeability_invR,
+                               init_medium_fun_2D permittivity_invR,
+                               init_medium_fun_2D magnetic_conductivityR,
+                               init_medium_fun_2D electric_conductivityR,
+                               void *user) {
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, ca,
+                    fdtd->ca);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, cb,
+                    fdtd->cb);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, da,
+                    fdtd->da);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch, db,
+                    fdtd->db);
   float_type posX = float_cst(0.);
   for (uintmax_t i = 0; i < fdtd->sizeX; ++i, posX += fdtd->dx) {
     float_type posY = float_cst(0.);
     for (uintmax_t j = 0; j < fdtd->sizeY; ++j, posY += fdtd->dy) {
-      permeability_inv[i][j] =
+      const float_type permeability_inv =
           float_cst(1.) / (permeability_invR(posX, posY, user) * mu0);
-      permittivity_inv[i][j] =
+      const float_type permittivity_inv =
           float_cst(1.) / (permittivity_invR(posX, posY, user) * eps0);
+      const float_type sigma_m = magnetic_conductivityR == NULL
+                                     ? float_cst(0.)
+                                     : magnetic_conductivityR(posX, posY, user);
+      const float_type sigma_e = electric_conductivityR == NULL
+                                     ? float_cst(0.)
+                                     : electric_conductivityR(posX, posY, user);
+      da[i][j] = update_coefficient_a(fdtd->dt, permeability_inv, sigma_m);
+      db[i][j] = update_coefficient_b(fdtd->dt, permeability_inv, sigma_m);
+      ca[i][j] = update_coefficient_a(fdtd->dt, permittivity_inv, sigma_e);
+      cb[i][j] = update_coefficient_b(fdtd->dt, permittivity_inv, sigma_e);
     }
   }
 }
 
+void init_fdtd_2D_medium(struct fdtd2D *fdtd,
+                         init_medium_fun_2D permeability_invR,
+                         init_medium_fun_2D permittivity_invR, void *user) {
+  init_fdtd_2D_lossy_medium(fdtd, permeability_invR, permittivity_invR, NULL,
+                            NULL, user);
+}
+
 struct fdtd2D init_fdtd_2D(float_type domain_size[2], float_type Sc,
                            float_type smallest_wavelength,
                            enum border_condition borders[num_borders_2D]) {
@@ -369,15 +405,21 @@ struct fdtd2D init_fdtd_2D_cpml(float_type domain_size[2], float_type Sc,
             "Please use a value lesser or equal to %.5f\n",
             Sc_max);
 
+  const struct fdtd_volume_shape field_shape =
+      fdtd_volume_shape(1, sizeX, sizeY, sizeof(field_type));
+  const struct fdtd_volume_shape coefficient_shape =
+      fdtd_volume_shape(1, sizeX, sizeY, sizeof(float_type));
   struct fdtd2D fdtd = {
       .dx = dx,
       .dy = dy,
       .dt = dt,
-      .ez = calloc(1, VLA_2D_size(float_type, sizeX, sizeY)),
-      .hx = calloc(1, VLA_2D_size(float_type, sizeX, sizeY)),
-      .hy = calloc(1, VLA_2D_size(float_type, sizeX, sizeY)),
-      .permeability_inv = calloc(1, VLA_2D_size(float_type, sizeX, sizeY)),
-      .permittivity_inv = calloc(1, VLA_2D_size(float_type, sizeX, sizeY)),
+      .ez = NULL,
+      .hx = NULL,
+      .hy = NULL,
+      .ca = NULL,
+      .cb = NULL,
+      .da = NULL,
+      .db = NULL,
       .psi_hx_y = {NULL, NULL},
       .psi_hy_x = {NULL, NULL},
       .psi_ez = {NULL, NULL, NULL, NULL},
@@ -393,6 +435,8 @@ struct fdtd2D init_fdtd_2D_cpml(float_type domain_size[2], float_type Sc,
       .domain_size = {domain_size[0], domain_size[1]},
       .sizeX = sizeX,
       .sizeY = sizeY,
+      .field_pitch = field_shape.pitch,
+      .coefficient_pitch = coefficient_shape.pitch,
       .Sc = Sc,
       .num_Jsources = 0,
       .Jsources = NULL,
@@ -401,34 +445,54 @@ struct fdtd2D init_fdtd_2D_cpml(float_type domain_size[2], float_type Sc,
       .Msources = NULL,
       .MsourceLocations = NULL,
       .time = float_cst(0.),
+      .engine = engine2D_serial,
+      .arena = fdtd_arena_init(),
   };
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.ez, 1, sizeX, sizeY,
+                            field_shape, sizeof(field_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.hx, 1, sizeX, sizeY,
+                            field_shape, sizeof(field_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.hy, 1, sizeX, sizeY,
+                            field_shape, sizeof(field_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.ca, 1, sizeX, sizeY,
+                            coefficient_shape, sizeof(float_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.cb, 1, sizeX, sizeY,
+                            coefficient_shape, sizeof(float_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.da, 1, sizeX, sizeY,
+                            coefficient_shape, sizeof(float_type));
+  fdtd_arena_request_padded(&fdtd.arena, &fdtd.db, 1, sizeX, sizeY,
+                            coefficient_shape, sizeof(float_type));
   if (cpml_thickness > 0 && fdtd.border_condition[border_south] & border_cpml) {
-    fdtd.psi_hy_x[0] =
-        calloc(1, VLA_2D_size(float_type, cpml_thickness, sizeY));
-    fdtd.psi_ez[border_south] =
-        calloc(1, VLA_2D_size(float_type, cpml_thickness, sizeY));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_x[0], 1, cpml_thickness,
+                       sizeY, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez[border_south], 1,
+                       cpml_thickness, sizeY, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_north] & border_cpml) {
-    fdtd.psi_hy_x[1] =
-        calloc(1, VLA_2D_size(float_type, cpml_thickness, sizeY));
-    fdtd.psi_ez[border_north] =
-        calloc(1, VLA_2D_size(float_type, cpml_thickness, sizeY));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_x[1], 1, cpml_thickness,
+                       sizeY, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez[border_north], 1,
+                       cpml_thickness, sizeY, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_west] & border_cpml) {
-    fdtd.psi_hx_y[0] =
-        calloc(1, VLA_2D_size(float_type, sizeX, cpml_thickness));
-    fdtd.psi_ez[border_west] =
-        calloc(1, VLA_2D_size(float_type, sizeX, cpml_thickness));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_y[0], 1, sizeX,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez[border_west], 1, sizeX,
+                       cpml_thickness, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_east] & border_cpml) {
-    fdtd.psi_hx_y[1] =
-        calloc(1, VLA_2D_size(float_type, sizeX, cpml_thickness));
-    fdtd.psi_ez[border_east] =
-        calloc(1, VLA_2D_size(float_type, sizeX, cpml_thickness));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_y[1], 1, sizeX,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez[border_east], 1, sizeX,
+                       cpml_thickness, sizeof(psi_type));
   }
-  fdtd.bx = calloc(cpml_thickness, sizeof(*fdtd.bx));
+  void *bx, *cx;
+  fdtd_arena_request(&fdtd.arena, &bx, 1, 1, cpml_thickness, sizeof(*fdtd.bx));
+  fdtd_arena_request(&fdtd.arena, &cx, 1, 1, cpml_thickness, sizeof(*fdtd.cx));
+  fdtd_arena_map(&fdtd.arena);
+  fdtd.bx = bx;
   fdtd.by = fdtd.bx;
-  fdtd.cx = calloc(cpml_thickness, sizeof(*fdtd.bx));
+  fdtd.cx = cx;
   fdtd.cy = fdtd.cx;
   float_type alpha_max = float_cst(2.) * M_PI * eps0 * fdtd.dx * float_cst(0.1);
   float_type sigma_max = float_cst(0.8) * (polynomial_taper_order + 1) /
@@ -446,8 +510,32 @@ struct fdtd2D init_fdtd_2D_cpml(float_type domain_size[2], float_type Sc,
   return fdtd;
 }
 
-void run_2D_fdtd(struct fdtd2D *fdtd, float_type end_time, bool verbose) {
-  const double num_iter_d = ceil((end_time - fdtd->time) / fdtd->dt);
+size_t memory_footprint_2D_fdtd(float_type domain_size[2],
+                                float_type smallest_wavelength,
+                                uintmax_t cpml_thickness) {
+  float_type dx = smallest_wavelength / float_cst(20.);
+  float_type sizeXf = floor(domain_size[0] / dx);
+  float_type sizeYf = floor(domain_size[1] / dx);
+  uintmax_t sizeX = (uintmax_t)sizeXf;
+  uintmax_t sizeY = (uintmax_t)sizeYf;
+  // The rows are padded as allocated
+  uintmax_t field_cells =
+      3 * sizeX * fdtd_volume_shape(1, sizeX, sizeY, sizeof(field_type)).pitch;
+  uintmax_t psi_cells = 4 * cpml_thickness * (sizeX + sizeY);
+  uintmax_t coefficient_cells =
+      4 * sizeX * fdtd_volume_shape(1, sizeX, sizeY, sizeof(float_type)).pitch +
+      2 * cpml_thickness;
+  // 3 fields, 4 coefficients, 8 CPML volumes and 2 CPML profiles
+  return fdtd_arena_footprint(field_cells * sizeof(field_type) +
+                                  psi_cells * sizeof(psi_type) +
+                                  coefficient_cells * sizeof(float_type),
+                              17);
+}
+
+void run_2D_fdtd(struct fdtd2D *fdtd, size_t num_steps, bool verbose) {
+  const double num_iter_d = (double)num_steps;
+  // Only reported by the progress lines
+  const float_type end_time = fdtd->time + (float_type)num_steps * fdtd->dt;
   double print_interval_d;
   if (num_iter_d >= 10.) {
     double divide = 1.;
@@ -463,83 +551,154 @@ void run_2D_fdtd(struct fdtd2D *fdtd, float_type end_time, bool verbose) {
   const size_t inter_print = print_interval - 1;
   size_t iter_count = 0;
   double percentage = percent_increment;
-  time_measure tstart_chunk, tend_chunk;
+  time_measure tstart_chunk, tend_chunk, tstart_run, tend_run;
   get_current_time(&tstart_chunk);
-  for (; fdtd->time < end_time; fdtd->time += fdtd->dt) {
-    update_magnetic_field(fdtd);
-    apply_M_sources(fdtd);
-    update_magnetic_cpml(fdtd);
-    border_condition_magnetic(fdtd);
-
-    update_electric_field(fdtd);
-    apply_J_sources(fdtd);
-    update_electric_cpml(fdtd);
-    border_condition_electric(fdtd);
-
-    iter_count = iter_count == inter_print ? 0 : iter_count + 1;
-    if (verbose && iter_count == 0) {
-      get_current_time(&tend_chunk);
-      double difference = measuring_difftime(tstart_chunk, tend_chunk);
-      printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n", percentage,
-             fdtd->time, fdtd->dt, end_time, print_interval, difference);
-      percentage += percent_increment;
-      tstart_chunk = tend_chunk;
+  tstart_run = tstart_chunk;
+  switch (fdtd->engine) {
+  case engine2D_serial:
+    for (size_t step = 0; step < num_steps; ++step, fdtd->time += fdtd->dt) {
+      update_magnetic_field(fdtd);
+      apply_M_sources(fdtd);
+      update_magnetic_cpml(fdtd);
+      border_condition_magnetic(fdtd);
+
+      update_electric_field(fdtd);
+      apply_J_sources(fdtd);
+      update_electric_cpml(fdtd);
+      border_condition_electric(fdtd);
+
+      iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+      if (verbose && iter_count == 0) {
+        get_current_time(&tend_chunk);
+        double difference = measuring_difftime(tstart_chunk, tend_chunk);
+        printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+               percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+               difference);
+        percentage += percent_increment;
+        tstart_chunk = tend_chunk;
+      }
+    }
+    break;
+  case engine2D_persistent_team:
+    // Same scheme as the 3D persistent engine: the kernels share the work of
+    // their rows among the team and the master thread advances the time
+#pragma omp parallel
+    for (size_t step = 0; step < num_steps; ++step) {
+      update_magnetic_field(fdtd);
+#pragma omp single
+      apply_M_sources(fdtd);
+      update_magnetic_cpml(fdtd);
+#pragma omp single
+      border_condition_magnetic(fdtd);
+
+      update_electric_field(fdtd);
+#pragma omp single
+      apply_J_sources(fdtd);
+      update_electric_cpml(fdtd);
+#pragma omp single
+      border_condition_electric(fdtd);
+
+#pragma omp master
+      {
+        iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+        if (verbose && iter_count == 0) {
+          get_current_time(&tend_chunk);
+          double difference = measuring_difftime(tstart_chunk, tend_chunk);
+          printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+                 percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+                 difference);
+          percentage += percent_increment;
+          tstart_chunk = tend_chunk;
+        }
+        fdtd->time += fdtd->dt;
+      }
     }
+    break;
+  default:
+    fprintf(stderr, "run_2D_fdtd: unknown engine\n");
+    exit(EXIT_FAILURE);
+  }
+  get_current_time(&tend_run);
+  double run_time = measuring_difftime(tstart_run, tend_run);
+  if (verbose && num_steps > 0 && run_time > 0.) {
+    printf("2D %s engine: %.2f Mcells/s\n", fdtd2D_engine_name[fdtd->engine],
+           (double)fdtd->sizeX * (double)fdtd->sizeY * (double)num_steps /
+               (run_time * 1e6));
   }
 }
 
+const char *fdtd2D_engine_name[num_engines2D] = {
+    [engine2D_serial] = "serial",
+    [engine2D_persistent_team] = "persistent",
+};
+
 void dump_2D_fdtd(const struct fdtd2D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump) {
   FILE *out = fopen(fileName, "w");
-  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->sizeY, data, fdtd->ez);
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, field, NULL);
+  VLA_2D_definition(float_type, fdtd->sizeX, fdtd->coefficient_pitch,
+                    coefficients, NULL);
   switch (what_to_dump) {
   case dump_ez:
+    field = fdtd->ez;
     break;
   case dump_hx:
-    data = fdtd->hx;
+    field = fdtd->hx;
     break;
   case dump_hy:
-    data = fdtd->hy;
+    field = fdtd->hy;
     break;
   case dump_permeability:
-    data = fdtd->permeability_inv;
+    coefficients = fdtd->db;
     break;
   case dump_permittivity:
-    data = fdtd->permittivity_inv;
+    coefficients = fdtd->cb;
     break;
   default:
     fprintf(stderr, "Dump of \"%s\" not available for 2D fdtd\n",
             dumpable_data_name[what_to_dump]);
     exit(EXIT_FAILURE);
   }
+  fdtd_dump_header(out, what_to_dump);
   for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
     for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
       fprintf(out, "%e %e %e\n", (float_type)i * fdtd->dx,
-              (float_type)j * fdtd->dy, data[i][j]);
+              (float_type)j * fdtd->dy,
+              field != NULL ? (float_type)field[i][j] : coefficients[i][j]);
     }
   }
   fclose(out);
 }
 
+// Row by row, skipping the padding
+static double *widen_field_2D(const struct fdtd2D *fdtd, void *field) {
+  VLA_2D_definition(field_type, fdtd->sizeX, fdtd->field_pitch, data, field);
+  double *widened = malloc(fdtd->sizeX * fdtd->sizeY * sizeof(*widened));
+  double *cell = widened;
+  for (uintmax_t i = 0; i < fdtd->sizeX; ++i)
+    for (uintmax_t j = 0; j < fdtd->sizeY; ++j)
+      *cell++ = (double)data[i][j];
+  return widened;
+}
+
+void snapshot_2D_fdtd(const struct fdtd2D *fdtd,
+                      struct fdtd_field_snapshot *snapshot) {
+  *snapshot = (struct fdtd_field_snapshot){
+      .num_components = 3,
+      .name = {"ez", "hx", "hy"},
+      .cells = fdtd->sizeX * fdtd->sizeY,
+      .component = {widen_field_2D(fdtd, fdtd->ez),
+                    widen_field_2D(fdtd, fdtd->hx),
+                    widen_field_2D(fdtd, fdtd->hy)},
+  };
+}
+
 void free_2D_fdtd(struct fdtd2D *fdtd) {
-  free(fdtd->ez);
-  free(fdtd->hx);
-  free(fdtd->hy);
-  free(fdtd->permittivity_inv);
-  free(fdtd->permeability_inv);
+  fdtd_arena_free(&fdtd->arena);
   free(fdtd->JsourceLocations);
   free(fdtd->Jsources);
   free(fdtd->MsourceLocations);
   free(fdtd->Msources);
-  free(fdtd->psi_hx_y[0]);
-  free(fdtd->psi_hx_y[1]);
-  free(fdtd->psi_hy_x[0]);
-  free(fdtd->psi_hy_x[1]);
-  for (enum border_position2D bd = 0; bd < num_borders_2D; ++bd) {
-    free(fdtd->psi_ez[bd]);
-  }
-  free(fdtd->bx);
-  free(fdtd->cx);
 }
 
 void add_source_fdtd_2D(enum source_type sType, struct fdtd2D *fdtd,
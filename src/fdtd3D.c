@@ -29,311 +29,1054 @@
  */
 
 #include "fdtd3D.h"
+#include "fdtd3D_mpi.h"
 #include "fdtd.h"
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
+#include "fdtd_simd.h"
+#include "fdtd_tiles.h"
 #include "time_measurement.h"
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tgmath.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-static void update_electric_field(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permittivity_inv, fdtd->permittivity_inv);
+// Half-open box [begin, end) of cells of the local grid
+struct box3D {
+  uintmax_t begin[3];
+  uintmax_t end[3];
+};
+
+static inline uintmax_t max_index(uintmax_t a, uintmax_t b) {
+  return a > b ? a : b;
+}
+
+static inline uintmax_t min_index(uintmax_t a, uintmax_t b) {
+  return a < b ? a : b;
+}
+
+static inline bool box_contains(const struct box3D *box, unsigned axis,
+                                uintmax_t index) {
+  return box->begin[axis] <= index && index < box->end[axis];
+}
+
+#define brick_edge fdtd3D_brick_edge
+#define brick_cells (brick_edge * brick_edge * brick_edge)
+
+// Offset of the cell (i, j, k) in a bricked volume, the bricks and the cells
+// inside a brick both following the row-major order
+static inline uintmax_t brick_offset(const struct fdtd3D *fdtd, uintmax_t i,
+                                     uintmax_t j, uintmax_t k) {
+  const uintmax_t brick =
+      ((i / brick_edge) * fdtd->bricks[1] + j / brick_edge) * fdtd->bricks[2] +
+      k / brick_edge;
+  const uintmax_t cell =
+      ((i % brick_edge) * brick_edge + j % brick_edge) * brick_edge +
+      k % brick_edge;
+  return brick * brick_cells + cell;
+}
+
+// Offset of the cell (i, j, k) in the field volumes
+static inline uintmax_t field_offset(const struct fdtd3D *fdtd, uintmax_t i,
+                                     uintmax_t j, uintmax_t k) {
+  if (fdtd->field_layout == field3D_bricked)
+    return brick_offset(fdtd, i, j, k);
+  return (i * fdtd->field_rows + j) * fdtd->field_pitch + k;
+}
+
+// Offset of the cell (i, j, k) in the coefficient and material id volumes
+static inline uintmax_t medium_offset(const struct fdtd3D *fdtd, uintmax_t i,
+                                      uintmax_t j, uintmax_t k) {
+  if (fdtd->field_layout == field3D_bricked)
+    return brick_offset(fdtd, i, j, k);
+  return (i * fdtd->medium_rows + j) * fdtd->medium_pitch + k;
+}
+
+// Range [d_begin, d_end) of the CPML depths d such that the cell first + d
+// lies in [begin, end)
+static inline void cpml_range_from_first(uintmax_t first, uintmax_t thickness,
+                                         uintmax_t begin, uintmax_t end,
+                                         uintmax_t *d_begin, uintmax_t *d_end) {
+  *d_begin = begin > first ? begin - first : 0;
+  *d_end = end > first ? min_index(end - first, thickness) : 0;
+}
+
+// Range [d_begin, d_end) of the CPML depths d such that the cell last - d
+// lies in [begin, end)
+static inline void cpml_range_from_last(uintmax_t last, uintmax_t thickness,
+                                        uintmax_t begin, uintmax_t end,
+                                        uintmax_t *d_begin, uintmax_t *d_end) {
+  *d_begin = end <= last ? last + 1 - end : 0;
+  *d_end = begin <= last ? min_index(last + 1 - begin, thickness) : 0;
+}
+
+// Threads sharing the loops of an update: the team of the enclosing parallel
+// region, or a lone thread updating a tile by itself. The updates split their
+// loops explicitly instead of using worksharing constructs, which would bind
+// to the whole team when a tile is updated by one of its threads.
+struct team3D {
+  unsigned thread, num_threads;
+};
+
+static const struct team3D lone_thread = {0, 1};
+
+// Team of the enclosing parallel region, called by each of its threads
+static struct team3D whole_team(void) {
+#ifdef _OPENMP
+  return (struct team3D){(unsigned)omp_get_thread_num(),
+                         (unsigned)omp_get_num_threads()};
+#else
+  return lone_thread;
+#endif
+}
+
+static void team_barrier(struct team3D team) {
+  if (team.num_threads > 1) {
+#pragma omp barrier
+  }
+}
+
+// Part [*first, *last) of the count iterations given to the thread, split as
+// by the static schedule: equal chunks, the first threads taking one more
+// iteration each for the remainder
+static void team_share(struct team3D team, uintmax_t count, uintmax_t *first,
+                       uintmax_t *last) {
+  const uintmax_t chunk = count / team.num_threads;
+  const uintmax_t extra = count % team.num_threads;
+  *first = team.thread * chunk + min_index(team.thread, extra);
+  *last = *first + chunk + (team.thread < extra ? 1 : 0);
+}
+
+// Part [*first, *last) of the indices [begin, end) given to the thread
+static void team_range(struct team3D team, uintmax_t begin, uintmax_t end,
+                       uintmax_t *first, uintmax_t *last) {
+  team_share(team, end - begin, first, last);
+  *first += begin;
+  *last += begin;
+}
+
+// Rows (i, j) of [i_begin, i_end) x [j_begin, j_end) given to a thread, split
+// in the order of a collapse(2) loop. The thread updates the rows j in
+// [first_row(i), end_row(i)) of each plane i in [i_begin, i_end).
+struct row_share {
+  uintmax_t i_begin, i_end;
+  uintmax_t j_begin, j_end;
+  uintmax_t first_j, last_j;
+};
+
+static struct row_share team_rows(struct team3D team, uintmax_t i_begin,
+                                  uintmax_t i_end, uintmax_t j_begin,
+                                  uintmax_t j_end) {
+  struct row_share share = {i_begin, i_begin, j_begin, j_end, 0, 0};
+  if (i_begin >= i_end || j_begin >= j_end)
+    return share;
+  const uintmax_t num_j = j_end - j_begin;
+  uintmax_t first, last;
+  team_share(team, (i_end - i_begin) * num_j, &first, &last);
+  if (first == last)
+    return share;
+  share.i_begin = i_begin + first / num_j;
+  share.i_end = i_begin + (last - 1) / num_j + 1;
+  share.first_j = j_begin + first % num_j;
+  share.last_j = j_begin + (last - 1) % num_j + 1;
+  return share;
+}
+
+static inline uintmax_t first_row(const struct row_share *share,
+                                  uintmax_t i) {
+  return i == share->i_begin ? share->first_j : share->j_begin;
+}
+
+static inline uintmax_t end_row(const struct row_share *share, uintmax_t i) {
+  return i + 1 == share->i_end ? share->last_j : share->j_end;
+}
+
+// Whether the row belongs to the sorted set of rows
+static bool is_source_row(const uintmax_t *rows, unsigned num_rows,
+                          uintmax_t row) {
+  unsigned low = 0, high = num_rows;
+  while (low < high) {
+    const unsigned mid = low + (high - low) / 2;
+    if (rows[mid] < row)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low < num_rows && rows[low] == row;
+}
+
+// Coefficients of the cells k_begin .. k_begin + k_count of the row (i, j),
+// either the row of the per-cell volume or its material ids looked up in
+// the table and gathered into buffer. The cells of a bricked medium must lie
+// in a single brick.
+static const float_type *coefficient_row(const struct fdtd3D *fdtd,
+                                         const float_type *cells,
+                                         const float_type *table, uintmax_t i,
+                                         uintmax_t j, uintmax_t k_begin,
+                                         uintmax_t k_count,
+                                         float_type *restrict buffer) {
+  const uintmax_t first = medium_offset(fdtd, i, j, k_begin);
+  switch (fdtd->medium_storage) {
+  case medium3D_uint8_ids: {
+    const uint8_t *ids = (const uint8_t *)fdtd->material_ids + first;
+    for (uintmax_t k = 0; k < k_count; ++k)
+      buffer[k] = table[ids[k]];
+    return buffer;
+  }
+  case medium3D_uint16_ids: {
+    const uint16_t *ids = (const uint16_t *)fdtd->material_ids + first;
+    for (uintmax_t k = 0; k < k_count; ++k)
+      buffer[k] = table[ids[k]];
+    return buffer;
+  }
+  default:
+    return cells + first;
+  }
+}
+
+static inline float_type coefficient_at(const struct fdtd3D *fdtd,
+                                        const float_type *cells,
+                                        const float_type *table, uintmax_t i,
+                                        uintmax_t j, uintmax_t k) {
+  const uintmax_t cell = medium_offset(fdtd, i, j, k);
+  switch (fdtd->medium_storage) {
+  case medium3D_uint8_ids:
+    return table[((const uint8_t *)fdtd->material_ids)[cell]];
+  case medium3D_uint16_ids:
+    return table[((const uint16_t *)fdtd->material_ids)[cell]];
+  default:
+    return cells[cell];
+  }
+}
+
+static inline float_type ca_at(const struct fdtd3D *fdtd, uintmax_t i,
+                               uintmax_t j, uintmax_t k) {
+  return coefficient_at(fdtd, fdtd->ca, fdtd->materials.ca, i, j, k);
+}
+
+static inline float_type cb_at(const struct fdtd3D *fdtd, uintmax_t i,
+                               uintmax_t j, uintmax_t k) {
+  return coefficient_at(fdtd, fdtd->cb, fdtd->materials.cb, i, j, k);
+}
+
+static inline float_type da_at(const struct fdtd3D *fdtd, uintmax_t i,
+                               uintmax_t j, uintmax_t k) {
+  return coefficient_at(fdtd, fdtd->da, fdtd->materials.da, i, j, k);
+}
+
+static inline float_type db_at(const struct fdtd3D *fdtd, uintmax_t i,
+                               uintmax_t j, uintmax_t k) {
+  return coefficient_at(fdtd, fdtd->db, fdtd->materials.db, i, j, k);
+}
+
+// Coefficients are told apart bitwise
+static inline bool same_coefficient(float_type a, float_type b) {
+  return memcmp(&a, &b, sizeof(float_type)) == 0;
+}
+
+// Update coefficients of the cells [k, k + n) of a row: a single pair held in
+// registers over uniform medium tiles, else the rows of coefficients
+struct coefficient_segment {
+  bool uniform;
+  float_type a, b;
+  const float_type *a_row, *b_row;
+};
+
+// Longest run of cells of the row (i, j) from k to at most k_end spanning
+// medium tiles of the same class, and of the same coefficients when uniform.
+// The E coefficients ca and cb are returned if electric, else da and db.
+static struct coefficient_segment
+coefficient_segment(const struct fdtd3D *fdtd, bool electric, uintmax_t i,
+                    uintmax_t j, uintmax_t k, uintmax_t k_end,
+                    float_type *restrict a_buffer,
+                    float_type *restrict b_buffer, uintmax_t *n) {
+  const struct fdtd3D_medium_tiles *tiles = &fdtd->medium_tiles;
+  const bool *uniform = electric ? tiles->e_uniform : tiles->h_uniform;
+  struct coefficient_segment segment = {false, float_cst(0.), float_cst(0.),
+                                        NULL, NULL};
+  uintmax_t end = k_end;
+  if (uniform != NULL) {
+    const float_type *tile_a = electric ? tiles->ca : tiles->da;
+    const float_type *tile_b = electric ? tiles->cb : tiles->db;
+    const uintmax_t first =
+        ((i / tiles->shape[0]) * tiles->count[1] + j / tiles->shape[1]) *
+            tiles->count[2] +
+        k / tiles->shape[2];
+    segment.uniform = uniform[first];
+    end = min_index((k / tiles->shape[2] + 1) * tiles->shape[2], k_end);
+    for (uintmax_t tile = first + 1;
+         end < k_end && uniform[tile] == segment.uniform; ++tile) {
+      if (segment.uniform && (!same_coefficient(tile_a[tile], tile_a[first]) ||
+                              !same_coefficient(tile_b[tile], tile_b[first])))
+        break;
+      end = min_index(end + tiles->shape[2], k_end);
+    }
+    if (segment.uniform) {
+      segment.a = tile_a[first];
+      segment.b = tile_b[first];
+      *n = end - k;
+      return segment;
+    }
+  }
+  *n = end - k;
+  if (electric) {
+    segment.a_row = coefficient_row(fdtd, fdtd->ca, fdtd->materials.ca, i, j,
+                                    k, *n, a_buffer);
+    segment.b_row = coefficient_row(fdtd, fdtd->cb, fdtd->materials.cb, i, j,
+                                    k, *n, b_buffer);
+  } else {
+    segment.a_row = coefficient_row(fdtd, fdtd->da, fdtd->materials.da, i, j,
+                                    k, *n, a_buffer);
+    segment.b_row = coefficient_row(fdtd, fdtd->db, fdtd->materials.db, i, j,
+                                    k, *n, b_buffer);
+  }
+  return segment;
+}
+
+static inline void curl2_segment(const struct fdtd_row_kernels *rows,
+                                 const struct coefficient_segment *segment,
+                                 uintmax_t n, field_type *out,
+                                 const field_type *a, const field_type *b,
+                                 const field_type *c, const field_type *d,
+                                 float_type c1, float_type c2) {
+  if (segment->uniform)
+    rows->curl2_uniform(n, out, a, b, c, d, c1, c2, segment->a, segment->b);
+  else
+    rows->curl2(n, out, a, b, c, d, c1, c2, segment->a_row, segment->b_row);
+}
+
+// Sweeps run by the time loop, the bricked layout having its own fused sweeps
+// which leave the CPML corrections to the slab passes
+static enum fdtd3D_kernel sweep_kernel(const struct fdtd3D *fdtd) {
+  return fdtd->field_layout == field3D_bricked ? kernel3D_fused : fdtd->kernel;
+}
+
+static void update_electric_field_per_component(struct fdtd3D *fdtd,
+                                                const struct box3D *box,
+                                                struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
+
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t i_begin = max_index(box->begin[0], 1), i_end = box->end[0];
+  const uintmax_t j_begin = max_index(box->begin[1], 1), j_end = box->end[1];
+  const uintmax_t k_begin = max_index(box->begin[2], 1), k_end = box->end[2];
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type ca_row[fdtd->sizeZ], cb_row[fdtd->sizeZ];
+
+  const struct row_share share =
+      team_rows(team, i_begin, i_end, j_begin, j_end);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+        curl2_segment(rows, &segment, n, &ex[i][j][k], &hz[i][j][k],
+                      &hz[i][j - 1][k], &hy[i][j][k], &hy[i][j][k - 1], _dy,
+                      _dz);
+      }
+    }
+  }
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+        curl2_segment(rows, &segment, n, &ey[i][j][k], &hx[i][j][k],
+                      &hx[i][j][k - 1], &hz[i][j][k], &hz[i - 1][j][k], _dz,
+                      _dx);
+      }
+    }
+  }
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+        curl2_segment(rows, &segment, n, &ez[i][j][k], &hy[i][j][k],
+                      &hy[i - 1][j][k], &hx[i][j][k], &hx[i][j - 1][k], _dx,
+                      _dy);
+      }
+    }
+  }
+  team_barrier(team);
+}
+
+// Single sweep reading the H components and the E coefficients once per cell
+// to write the three E components
+static void update_electric_field_fused(struct fdtd3D *fdtd,
+                                        const struct box3D *box,
+                                        struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
 
   float_type _dx = float_cst(1.) / fdtd->dx;
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t i_begin = max_index(box->begin[0], 1), i_end = box->end[0];
+  const uintmax_t j_begin = max_index(box->begin[1], 1), j_end = box->end[1];
+  const uintmax_t k_begin = max_index(box->begin[2], 1), k_end = box->end[2];
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type ca_row[fdtd->sizeZ], cb_row[fdtd->sizeZ];
 
-  for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
-    for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
-      for (uintmax_t k = 1; k < fdtd->sizeZ; ++k) {
-        ex[i][j][k] = ex[i][j][k] + ((hz[i][j][k] - hz[i][j - 1][k]) * _dy -
-                                     (hy[i][j][k] - hy[i][j][k - 1]) * _dz) *
-                                        fdtd->dt * permittivity_inv[i][j][k];
+  const struct row_share share =
+      team_rows(team, i_begin, i_end, j_begin, j_end);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+        curl2_segment(rows, &segment, n, &ex[i][j][k], &hz[i][j][k],
+                      &hz[i][j - 1][k], &hy[i][j][k], &hy[i][j][k - 1], _dy,
+                      _dz);
+        curl2_segment(rows, &segment, n, &ey[i][j][k], &hx[i][j][k],
+                      &hx[i][j][k - 1], &hz[i][j][k], &hz[i - 1][j][k], _dz,
+                      _dx);
+        curl2_segment(rows, &segment, n, &ez[i][j][k], &hy[i][j][k],
+                      &hy[i - 1][j][k], &hx[i][j][k], &hx[i][j - 1][k], _dx,
+                      _dy);
       }
     }
   }
-  for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
-    for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
-      for (uintmax_t k = 1; k < fdtd->sizeZ; ++k) {
-        ey[i][j][k] = ey[i][j][k] + ((hx[i][j][k] - hx[i][j][k - 1]) * _dz -
-                                     (hz[i][j][k] - hz[i - 1][j][k]) * _dx) *
-                                        fdtd->dt * permittivity_inv[i][j][k];
+  team_barrier(team);
+}
+
+// CPML corrections of the E components of the row (i, j) of the box, in the
+// order of update_electric_cpml_slabs
+static void electric_cpml_row(struct fdtd3D *fdtd, const struct box3D *box,
+                              uintmax_t i, uintmax_t j) {
+  // Ex
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_ex_left, fdtd->psi_ex_y[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_ex_right, fdtd->psi_ex_y[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_ex_front, fdtd->psi_ex_z[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_ex_back, fdtd->psi_ex_z[1]);
+  // Ey
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_ey_bottom, fdtd->psi_ey_x[0]);
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_ey_top, fdtd->psi_ey_x[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_ey_front, fdtd->psi_ey_z[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_ey_back, fdtd->psi_ey_z[1]);
+
+  // Ez
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_ez_bottom, fdtd->psi_ez_x[0]);
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_ez_top, fdtd->psi_ez_x[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_ez_left, fdtd->psi_ez_y[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_ez_right, fdtd->psi_ez_y[1]);
+  // Sim data
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
+  // Useful constants
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+
+  const uintmax_t thickness = fdtd->cpml_thickness;
+
+  if (fdtd->border_condition[border_left] & border_cpml && j >= 1 &&
+      j - 1 < thickness) { // ex_y & ez_y
+    const uintmax_t d = j - 1;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, 1 + d, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, d, k);
+      psi_ex_left[i][d][k] =
+          fdtd->by[d] * psi_ex_left[i][d][k] +
+          fdtd->cy[d] * (hz[cell] - hz[neighbour]) * _dy;
+      ex[cell] = ex[cell] + cb_at(fdtd, i, 1 + d, k) * psi_ex_left[i][d][k];
+      psi_ez_left[i][d][k] =
+          fdtd->by[d] * psi_ez_left[i][d][k] +
+          fdtd->cy[d] * (hx[cell] - hx[neighbour]) * _dy;
+      ez[cell] = ez[cell] - cb_at(fdtd, i, 1 + d, k) * psi_ez_left[i][d][k];
+    }
+  }
+  if (fdtd->border_condition[border_right] & border_cpml &&
+      fdtd->sizeY - 1 - j < thickness) { // ex_y & ez_y
+    const uintmax_t d = fdtd->sizeY - 1 - j;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j - 1, k);
+      psi_ex_right[i][d][k] =
+          fdtd->by[d] * psi_ex_right[i][d][k] +
+          fdtd->cy[d] * (hz[cell] - hz[neighbour]) * _dy;
+      ex[cell] = ex[cell] + cb_at(fdtd, i, j, k) * psi_ex_right[i][d][k];
+      psi_ez_right[i][d][k] =
+          fdtd->by[d] * psi_ez_right[i][d][k] +
+          fdtd->cy[d] * (hx[cell] - hx[neighbour]) * _dy;
+      ez[cell] = ez[cell] - cb_at(fdtd, i, j, k) * psi_ez_right[i][d][k];
+    }
+  }
+  if (fdtd->border_condition[border_front] & border_cpml) { // ex_z & ey_z
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(1, thickness, box->begin[2], box->end[2], &d_begin,
+                          &d_end);
+    for (uintmax_t d = d_begin; d < d_end; ++d) {
+      const uintmax_t cell = field_offset(fdtd, i, j, 1 + d);
+      const uintmax_t neighbour = field_offset(fdtd, i, j, d);
+      psi_ex_front[i][j][d] =
+          fdtd->bz[d] * psi_ex_front[i][j][d] +
+          fdtd->cz[d] * (hy[cell] - hy[neighbour]) * _dz;
+      ex[cell] = ex[cell] - cb_at(fdtd, i, j, 1 + d) * psi_ex_front[i][j][d];
+      psi_ey_front[i][j][d] =
+          fdtd->bz[d] * psi_ey_front[i][j][d] +
+          fdtd->cz[d] * (hx[cell] - hx[neighbour]) * _dz;
+      ey[cell] = ey[cell] + cb_at(fdtd, i, j, 1 + d) * psi_ey_front[i][j][d];
+    }
+  }
+  if (fdtd->border_condition[border_back] & border_cpml) { // ex_z & ey_z
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeZ - 1, thickness, box->begin[2],
+                         box->end[2], &d_begin, &d_end);
+    for (uintmax_t d = d_begin; d < d_end; ++d) {
+      const uintmax_t k = fdtd->sizeZ - 1 - d;
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j, k - 1);
+      psi_ex_back[i][j][d] =
+          fdtd->bz[d] * psi_ex_back[i][j][d] +
+          fdtd->cz[d] * (hy[cell] - hy[neighbour]) * _dz;
+      ex[cell] = ex[cell] - cb_at(fdtd, i, j, k) * psi_ex_back[i][j][d];
+      psi_ey_back[i][j][d] =
+          fdtd->bz[d] * psi_ey_back[i][j][d] +
+          fdtd->cz[d] * (hx[cell] - hx[neighbour]) * _dz;
+      ey[cell] = ey[cell] + cb_at(fdtd, i, j, k) * psi_ey_back[i][j][d];
+    }
+  }
+  if (fdtd->border_condition[border_bottom] & border_cpml && i >= 1 &&
+      i - 1 < thickness) { // ey_x & ez_x
+    const uintmax_t d = i - 1;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, 1 + d, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, d, j, k);
+      psi_ey_bottom[d][j][k] =
+          fdtd->bx[d] * psi_ey_bottom[d][j][k] +
+          fdtd->cx[d] * (hz[cell] - hz[neighbour]) * _dx;
+      ey[cell] = ey[cell] - cb_at(fdtd, 1 + d, j, k) * psi_ey_bottom[d][j][k];
+      psi_ez_bottom[d][j][k] =
+          fdtd->bx[d] * psi_ez_bottom[d][j][k] +
+          fdtd->cx[d] * (hy[cell] - hy[neighbour]) * _dx;
+      ez[cell] = ez[cell] + cb_at(fdtd, 1 + d, j, k) * psi_ez_bottom[d][j][k];
+    }
+  }
+  if (fdtd->border_condition[border_top] & border_cpml &&
+      fdtd->sizeX - 1 - i < thickness) { // ey_x & ez_x
+    const uintmax_t d = fdtd->sizeX - 1 - i;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i - 1, j, k);
+      psi_ey_top[d][j][k] =
+          fdtd->bx[d] * psi_ey_top[d][j][k] +
+          fdtd->cx[d] * (hz[cell] - hz[neighbour]) * _dx;
+      ey[cell] = ey[cell] - cb_at(fdtd, i, j, k) * psi_ey_top[d][j][k];
+      psi_ez_top[d][j][k] =
+          fdtd->bx[d] * psi_ez_top[d][j][k] +
+          fdtd->cx[d] * (hy[cell] - hy[neighbour]) * _dx;
+      ez[cell] = ez[cell] + cb_at(fdtd, i, j, k) * psi_ez_top[d][j][k];
+    }
+  }
+}
+
+// Fused sweep applying the CPML corrections of each row right after its bulk
+// update, while the row is in cache. The rows holding sources are corrected
+// after the sources, as in the per-slab order.
+static void update_electric_field_fused_cpml(struct fdtd3D *fdtd,
+                                             const struct box3D *box,
+                                             struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
+
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t k_begin = max_index(box->begin[2], 1), k_end = box->end[2];
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type ca_row[fdtd->sizeZ], cb_row[fdtd->sizeZ];
+
+  const struct row_share share =
+      team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      if (i >= 1 && j >= 1) {
+        for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+          const struct coefficient_segment segment = coefficient_segment(
+              fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+          curl2_segment(rows, &segment, n, &ex[i][j][k], &hz[i][j][k],
+                        &hz[i][j - 1][k], &hy[i][j][k], &hy[i][j][k - 1], _dy,
+                        _dz);
+          curl2_segment(rows, &segment, n, &ey[i][j][k], &hx[i][j][k],
+                        &hx[i][j][k - 1], &hz[i][j][k], &hz[i - 1][j][k], _dz,
+                        _dx);
+          curl2_segment(rows, &segment, n, &ez[i][j][k], &hy[i][j][k],
+                        &hy[i - 1][j][k], &hx[i][j][k], &hx[i][j - 1][k], _dx,
+                        _dy);
+        }
       }
+      if (!is_source_row(fdtd->JsourceRows, fdtd->num_JsourceRows,
+                         i * fdtd->sizeY + j))
+        electric_cpml_row(fdtd, box, i, j);
     }
   }
-  for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
-    for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
-      for (uintmax_t k = 1; k < fdtd->sizeZ; ++k) {
-        ez[i][j][k] = ez[i][j][k] + ((hy[i][j][k] - hy[i - 1][j][k]) * _dx -
-                                     (hx[i][j][k] - hx[i][j - 1][k]) * _dy) *
-                                        fdtd->dt * permittivity_inv[i][j][k];
+  team_barrier(team);
+}
+
+// Sweep over the bricks of the bricked layout, the three E components of each
+// brick row being updated in turn. The rows starting a brick find their k - 1
+// neighbours in the previous brick, which are gathered first.
+static void update_electric_field_bricked(struct fdtd3D *fdtd,
+                                          const struct box3D *box,
+                                          struct team3D team) {
+  field_type *hx = fdtd->hx, *hy = fdtd->hy, *hz = fdtd->hz;
+  field_type *ex = fdtd->ex, *ey = fdtd->ey, *ez = fdtd->ez;
+
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  uintmax_t begin[3], brick_begin[3], brick_end[3];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    begin[axis] = max_index(box->begin[axis], 1);
+    brick_begin[axis] = begin[axis] / brick_edge;
+    brick_end[axis] = (box->end[axis] + brick_edge - 1) / brick_edge;
+  }
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type ca_row[brick_edge], cb_row[brick_edge];
+  field_type hx_row[brick_edge], hy_row[brick_edge];
+
+  const struct row_share share =
+      team_rows(team, brick_begin[0], brick_end[0], brick_begin[1],
+                brick_end[1]);
+  for (uintmax_t bi = share.i_begin; bi < share.i_end; ++bi) {
+    for (uintmax_t bj = first_row(&share, bi); bj < end_row(&share, bi); ++bj) {
+      for (uintmax_t bk = brick_begin[2]; bk < brick_end[2]; ++bk) {
+        const uintmax_t i_begin = max_index(bi * brick_edge, begin[0]);
+        const uintmax_t i_end = min_index((bi + 1) * brick_edge, box->end[0]);
+        const uintmax_t j_begin = max_index(bj * brick_edge, begin[1]);
+        const uintmax_t j_end = min_index((bj + 1) * brick_edge, box->end[1]);
+        const uintmax_t k_begin = max_index(bk * brick_edge, begin[2]);
+        const uintmax_t k_end = min_index((bk + 1) * brick_edge, box->end[2]);
+        if (k_begin >= k_end)
+          continue;
+        for (uintmax_t i = i_begin; i < i_end; ++i) {
+          for (uintmax_t j = j_begin; j < j_end; ++j) {
+            const uintmax_t row = brick_offset(fdtd, i, j, k_begin);
+            const uintmax_t row_i = brick_offset(fdtd, i - 1, j, k_begin);
+            const uintmax_t row_j = brick_offset(fdtd, i, j - 1, k_begin);
+            const field_type *hx_k = &hx[row - 1], *hy_k = &hy[row - 1];
+            if (k_begin % brick_edge == 0) {
+              const uintmax_t last = brick_offset(fdtd, i, j, k_begin - 1);
+              hx_row[0] = hx[last];
+              hy_row[0] = hy[last];
+              for (uintmax_t k = 1; k < k_end - k_begin; ++k) {
+                hx_row[k] = hx[row + k - 1];
+                hy_row[k] = hy[row + k - 1];
+              }
+              hx_k = hx_row;
+              hy_k = hy_row;
+            }
+            for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+              const struct coefficient_segment segment = coefficient_segment(
+                  fdtd, true, i, j, k, k_end, ca_row, cb_row, &n);
+              const uintmax_t r = k - k_begin;
+              curl2_segment(rows, &segment, n, &ex[row + r], &hz[row + r],
+                            &hz[row_j + r], &hy[row + r], &hy_k[r], _dy, _dz);
+              curl2_segment(rows, &segment, n, &ey[row + r], &hx[row + r],
+                            &hx_k[r], &hz[row + r], &hz[row_i + r], _dz, _dx);
+              curl2_segment(rows, &segment, n, &ez[row + r], &hy[row + r],
+                            &hy[row_i + r], &hx[row + r], &hx[row_j + r], _dx,
+                            _dy);
+            }
+          }
+        }
       }
     }
   }
+  team_barrier(team);
 }
 
-static void update_electric_cpml(struct fdtd3D *fdtd) {
+static void update_electric_field(struct fdtd3D *fdtd,
+                                  const struct box3D *box,
+                                  struct team3D team) {
+  if (fdtd->field_layout == field3D_bricked) {
+    update_electric_field_bricked(fdtd, box, team);
+    return;
+  }
+  switch (fdtd->kernel) {
+  case kernel3D_fused:
+    update_electric_field_fused(fdtd, box, team);
+    break;
+  case kernel3D_fused_cpml:
+    update_electric_field_fused_cpml(fdtd, box, team);
+    break;
+  default:
+    update_electric_field_per_component(fdtd, box, team);
+    break;
+  }
+}
+
+static void update_electric_cpml_slabs(struct fdtd3D *fdtd,
+                                       const struct box3D *box,
+                                       struct team3D team) {
   // Ex
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_ex_left, fdtd->psi_ex_y[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_ex_right, fdtd->psi_ex_y[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_ex_front, fdtd->psi_ex_z[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_ex_back, fdtd->psi_ex_z[1]);
   // Ey
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_ey_bottom, fdtd->psi_ey_x[0]);
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_ey_top, fdtd->psi_ey_x[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_ey_front, fdtd->psi_ey_z[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_ey_back, fdtd->psi_ey_z[1]);
 
   // Ez
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_ez_bottom, fdtd->psi_ez_x[0]);
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_ez_top, fdtd->psi_ez_x[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_ez_left, fdtd->psi_ez_y[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_ez_right, fdtd->psi_ez_y[1]);
   // Sim data
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permittivity_inv, fdtd->permittivity_inv);
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
   // Useful constants
   float_type _dx = float_cst(1.) / fdtd->dx;
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dz = float_cst(1.) / fdtd->dz;
 
   if (fdtd->border_condition[border_left] & border_cpml) { // ex_y & ez_y
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(1, fdtd->cpml_thickness, box->begin[1],
+                          box->end[1], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], d_begin, d_end);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, 1 + j, k);
+          const uintmax_t neighbour = field_offset(fdtd, i, j, k);
           psi_ex_left[i][j][k] =
               fdtd->by[j] * psi_ex_left[i][j][k] +
-              fdtd->cy[j] * (hz[i][1 + j][k] - hz[i][j][k]) * _dy;
-          ex[i][1 + j][k] =
-              ex[i][1 + j][k] +
-              fdtd->dt * permittivity_inv[i][1 + j][k] * psi_ex_left[i][j][k];
+              fdtd->cy[j] * (hz[cell] - hz[neighbour]) * _dy;
+          ex[cell] = ex[cell] + cb_at(fdtd, i, 1 + j, k) * psi_ex_left[i][j][k];
           psi_ez_left[i][j][k] =
               fdtd->by[j] * psi_ez_left[i][j][k] +
-              fdtd->cy[j] * (hx[i][1 + j][k] - hx[i][j][k]) * _dy;
-          ez[i][1 + j][k] =
-              ez[i][1 + j][k] -
-              fdtd->dt * permittivity_inv[i][1 + j][k] * psi_ez_left[i][j][k];
+              fdtd->cy[j] * (hx[cell] - hx[neighbour]) * _dy;
+          ez[cell] = ez[cell] - cb_at(fdtd, i, 1 + j, k) * psi_ez_left[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_right] & border_cpml) { // ex_y & ez_y
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-          psi_ex_right[i][j][k] = fdtd->by[j] * psi_ex_right[i][j][k] +
-                                  fdtd->cy[j] *
-                                      (hz[i][fdtd->sizeY - 1 - j][k] -
-                                       hz[i][fdtd->sizeY - 2 - j][k]) *
-                                      _dy;
-          ex[i][fdtd->sizeY - 1 - j][k] =
-              ex[i][fdtd->sizeY - 1 - j][k] +
-              fdtd->dt * permittivity_inv[i][fdtd->sizeY - 1 - j][k] *
-                  psi_ex_right[i][j][k];
-          psi_ez_right[i][j][k] = fdtd->by[j] * psi_ez_right[i][j][k] +
-                                  fdtd->cy[j] *
-                                      (hx[i][fdtd->sizeY - 1 - j][k] -
-                                       hx[i][fdtd->sizeY - 2 - j][k]) *
-                                      _dy;
-          ez[i][fdtd->sizeY - 1 - j][k] =
-              ez[i][fdtd->sizeY - 1 - j][k] -
-              fdtd->dt * permittivity_inv[i][fdtd->sizeY - 1 - j][k] *
-                  psi_ez_right[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeY - 1, fdtd->cpml_thickness, box->begin[1],
+                         box->end[1], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], d_begin, d_end);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, fdtd->sizeY - 1 - j, k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, i, fdtd->sizeY - 2 - j, k);
+          psi_ex_right[i][j][k] =
+              fdtd->by[j] * psi_ex_right[i][j][k] +
+              fdtd->cy[j] * (hz[cell] - hz[neighbour]) * _dy;
+          ex[cell] =
+              ex[cell] +
+              cb_at(fdtd, i, fdtd->sizeY - 1 - j, k) * psi_ex_right[i][j][k];
+          psi_ez_right[i][j][k] =
+              fdtd->by[j] * psi_ez_right[i][j][k] +
+              fdtd->cy[j] * (hx[cell] - hx[neighbour]) * _dy;
+          ez[cell] =
+              ez[cell] -
+              cb_at(fdtd, i, fdtd->sizeY - 1 - j, k) * psi_ez_right[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_front] & border_cpml) { // ex_z & ey_z
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->cpml_thickness; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(1, fdtd->cpml_thickness, box->begin[2],
+                          box->end[2], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = d_begin; k < d_end; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, 1 + k);
+          const uintmax_t neighbour = field_offset(fdtd, i, j, k);
           psi_ex_front[i][j][k] =
               fdtd->bz[k] * psi_ex_front[i][j][k] +
-              fdtd->cz[k] * (hy[i][j][1 + k] - hy[i][j][k]) * _dz;
-          ex[i][j][1 + k] =
-              ex[i][j][1 + k] -
-              fdtd->dt * permittivity_inv[i][j][1 + k] * psi_ex_front[i][j][k];
+              fdtd->cz[k] * (hy[cell] - hy[neighbour]) * _dz;
+          ex[cell] =
+              ex[cell] - cb_at(fdtd, i, j, 1 + k) * psi_ex_front[i][j][k];
           psi_ey_front[i][j][k] =
               fdtd->bz[k] * psi_ey_front[i][j][k] +
-              fdtd->cz[k] * (hx[i][j][1 + k] - hx[i][j][k]) * _dz;
-          ey[i][j][1 + k] =
-              ey[i][j][1 + k] +
-              fdtd->dt * permittivity_inv[i][j][1 + k] * psi_ey_front[i][j][k];
+              fdtd->cz[k] * (hx[cell] - hx[neighbour]) * _dz;
+          ey[cell] =
+              ey[cell] + cb_at(fdtd, i, j, 1 + k) * psi_ey_front[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_back] & border_cpml) { // ex_z & ey_z
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->cpml_thickness; ++k) {
-          psi_ex_back[i][j][k] = fdtd->bz[k] * psi_ex_back[i][j][k] +
-                                 fdtd->cz[k] *
-                                     (hy[i][j][fdtd->sizeZ - 1 - k] -
-                                      hy[i][j][fdtd->sizeZ - 2 - k]) *
-                                     _dz;
-          ex[i][j][fdtd->sizeZ - 1 - k] =
-              ex[i][j][fdtd->sizeZ - 1 - k] -
-              fdtd->dt * permittivity_inv[i][j][fdtd->sizeZ - 1 - k] *
-                  psi_ex_back[i][j][k];
-          psi_ey_back[i][j][k] = fdtd->bz[k] * psi_ey_back[i][j][k] +
-                                 fdtd->cz[k] *
-                                     (hx[i][j][fdtd->sizeZ - 1 - k] -
-                                      hx[i][j][fdtd->sizeZ - 2 - k]) *
-                                     _dz;
-          ey[i][j][fdtd->sizeZ - 1 - k] =
-              ey[i][j][fdtd->sizeZ - 1 - k] +
-              fdtd->dt * permittivity_inv[i][j][fdtd->sizeZ - 1 - k] *
-                  psi_ey_back[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeZ - 1, fdtd->cpml_thickness, box->begin[2],
+                         box->end[2], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = d_begin; k < d_end; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, fdtd->sizeZ - 1 - k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, i, j, fdtd->sizeZ - 2 - k);
+          psi_ex_back[i][j][k] =
+              fdtd->bz[k] * psi_ex_back[i][j][k] +
+              fdtd->cz[k] * (hy[cell] - hy[neighbour]) * _dz;
+          ex[cell] =
+              ex[cell] -
+              cb_at(fdtd, i, j, fdtd->sizeZ - 1 - k) * psi_ex_back[i][j][k];
+          psi_ey_back[i][j][k] =
+              fdtd->bz[k] * psi_ey_back[i][j][k] +
+              fdtd->cz[k] * (hx[cell] - hx[neighbour]) * _dz;
+          ey[cell] =
+              ey[cell] +
+              cb_at(fdtd, i, j, fdtd->sizeZ - 1 - k) * psi_ey_back[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_bottom] & border_cpml) { // ey_x & ez_x
-    for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(1, fdtd->cpml_thickness, box->begin[0],
+                          box->end[0], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, d_begin, d_end, box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, 1 + i, j, k);
+          const uintmax_t neighbour = field_offset(fdtd, i, j, k);
           psi_ey_bottom[i][j][k] =
               fdtd->bx[i] * psi_ey_bottom[i][j][k] +
-              fdtd->cx[i] * (hz[1 + i][j][k] - hz[i][j][k]) * _dx;
-          ey[1 + i][j][k] =
-              ey[1 + i][j][k] -
-              fdtd->dt * permittivity_inv[1 + i][j][k] * psi_ey_bottom[i][j][k];
+              fdtd->cx[i] * (hz[cell] - hz[neighbour]) * _dx;
+          ey[cell] =
+              ey[cell] - cb_at(fdtd, 1 + i, j, k) * psi_ey_bottom[i][j][k];
           psi_ez_bottom[i][j][k] =
               fdtd->bx[i] * psi_ez_bottom[i][j][k] +
-              fdtd->cx[i] * (hy[1 + i][j][k] - hy[i][j][k]) * _dx;
-          ez[1 + i][j][k] =
-              ez[1 + i][j][k] +
-              fdtd->dt * permittivity_inv[1 + i][j][k] * psi_ez_bottom[i][j][k];
+              fdtd->cx[i] * (hy[cell] - hy[neighbour]) * _dx;
+          ez[cell] =
+              ez[cell] + cb_at(fdtd, 1 + i, j, k) * psi_ez_bottom[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_top] & border_cpml) { // ey_x & ez_x
-    for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-          psi_ey_top[i][j][k] = fdtd->bx[i] * psi_ey_top[i][j][k] +
-                                fdtd->cx[i] *
-                                    (hz[fdtd->sizeX - 1 - i][j][k] -
-                                     hz[fdtd->sizeX - 2 - i][j][k]) *
-                                    _dx;
-          ey[fdtd->sizeX - 1 - i][j][k] =
-              ey[fdtd->sizeX - 1 - i][j][k] -
-              fdtd->dt * permittivity_inv[fdtd->sizeX - 1 - i][j][k] *
-                  psi_ey_top[i][j][k];
-          psi_ez_top[i][j][k] = fdtd->bx[i] * psi_ez_top[i][j][k] +
-                                fdtd->cx[i] *
-                                    (hy[fdtd->sizeX - 1 - i][j][k] -
-                                     hy[fdtd->sizeX - 2 - i][j][k]) *
-                                    _dx;
-          ez[fdtd->sizeX - 1 - i][j][k] =
-              ez[fdtd->sizeX - 1 - i][j][k] +
-              fdtd->dt * permittivity_inv[fdtd->sizeX - 1 - i][j][k] *
-                  psi_ez_top[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeX - 1, fdtd->cpml_thickness, box->begin[0],
+                         box->end[0], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, d_begin, d_end, box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, fdtd->sizeX - 1 - i, j, k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, fdtd->sizeX - 2 - i, j, k);
+          psi_ey_top[i][j][k] =
+              fdtd->bx[i] * psi_ey_top[i][j][k] +
+              fdtd->cx[i] * (hz[cell] - hz[neighbour]) * _dx;
+          ey[cell] =
+              ey[cell] -
+              cb_at(fdtd, fdtd->sizeX - 1 - i, j, k) * psi_ey_top[i][j][k];
+          psi_ez_top[i][j][k] =
+              fdtd->bx[i] * psi_ez_top[i][j][k] +
+              fdtd->cx[i] * (hy[cell] - hy[neighbour]) * _dx;
+          ez[cell] =
+              ez[cell] +
+              cb_at(fdtd, fdtd->sizeX - 1 - i, j, k) * psi_ez_top[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
 }
 
-static void border_condition_electric(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
+// CPML corrections left after the bulk update: every slab, or with the
+// fused-cpml kernel only the rows holding sources
+static void update_electric_cpml(struct fdtd3D *fdtd,
+                                 const struct box3D *box,
+                                 struct team3D team) {
+  if (sweep_kernel(fdtd) != kernel3D_fused_cpml) {
+    update_electric_cpml_slabs(fdtd, box, team);
+    return;
+  }
+  uintmax_t first, last;
+  team_share(team, fdtd->num_JsourceRows, &first, &last);
+  for (uintmax_t r = first; r < last; ++r) {
+    const uintmax_t i = fdtd->JsourceRows[r] / fdtd->sizeY;
+    const uintmax_t j = fdtd->JsourceRows[r] % fdtd->sizeY;
+    if (box_contains(box, 0, i) && box_contains(box, 1, j))
+      electric_cpml_row(fdtd, box, i, j);
+  }
+  team_barrier(team);
+}
+
+static void border_condition_electric(struct fdtd3D *fdtd,
+                                      const struct box3D *box,
+                                      struct team3D team) {
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
+  uintmax_t first, last;
 
   for (enum border_position3D i = border_front; i < num_borders_3D; ++i) {
     if (fdtd->border_condition[i] == border_perfect_electric_conductor) {
       switch (i) {
       case border_front:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeY; ++k) {
-            ex[j][k][0] = float_cst(0.);
-            ey[j][k][0] = float_cst(0.);
-            ez[j][k][0] = float_cst(0.);
+        if (!box_contains(box, 2, 0))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[1]; k < box->end[1]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, k, 0);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_back:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeY; ++k) {
-            ex[j][k][fdtd->sizeZ - 1] = float_cst(0.);
-            ey[j][k][fdtd->sizeZ - 1] = float_cst(0.);
-            ez[j][k][fdtd->sizeZ - 1] = float_cst(0.);
+        if (!box_contains(box, 2, fdtd->sizeZ - 1))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[1]; k < box->end[1]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, k, fdtd->sizeZ - 1);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_top:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            ex[fdtd->sizeX - 1][j][k] = float_cst(0.);
-            ey[fdtd->sizeX - 1][j][k] = float_cst(0.);
-            ez[fdtd->sizeX - 1][j][k] = float_cst(0.);
+        if (!box_contains(box, 0, fdtd->sizeX - 1))
+          break;
+        team_range(team, box->begin[1], box->end[1], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, fdtd->sizeX - 1, j, k);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_bottom:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            ex[0][j][k] = float_cst(0.);
-            ey[0][j][k] = float_cst(0.);
-            ez[0][j][k] = float_cst(0.);
+        if (!box_contains(box, 0, 0))
+          break;
+        team_range(team, box->begin[1], box->end[1], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, 0, j, k);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_right:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            ex[j][fdtd->sizeY - 1][k] = float_cst(0.);
-            ey[j][fdtd->sizeY - 1][k] = float_cst(0.);
-            ez[j][fdtd->sizeY - 1][k] = float_cst(0.);
+        if (!box_contains(box, 1, fdtd->sizeY - 1))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, fdtd->sizeY - 1, k);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_left:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            ex[j][0][k] = float_cst(0.);
-            ey[j][0][k] = float_cst(0.);
-            ez[j][0][k] = float_cst(0.);
+        if (!box_contains(box, 1, 0))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, 0, k);
+            ex[cell] = float_cst(0.);
+            ey[cell] = float_cst(0.);
+            ez[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       default:
         fprintf(stderr, "Error while processing the electric border "
@@ -344,295 +1087,720 @@ static void border_condition_electric(struct fdtd3D *fdtd) {
   }
 }
 
-static void update_magnetic_field(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permeability_inv, fdtd->permeability_inv);
+static void update_magnetic_field_per_component(struct fdtd3D *fdtd,
+                                                const struct box3D *box,
+                                                struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
 
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dx = float_cst(1.) / fdtd->dx;
   float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t i_begin = box->begin[0];
+  const uintmax_t i_end = min_index(box->end[0], fdtd->sizeX - 1);
+  const uintmax_t j_begin = box->begin[1];
+  const uintmax_t j_end = min_index(box->end[1], fdtd->sizeY - 1);
+  const uintmax_t k_begin = box->begin[2];
+  const uintmax_t k_end = min_index(box->end[2], fdtd->sizeZ - 1);
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type da_row[fdtd->sizeZ], db_row[fdtd->sizeZ];
 
-  for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    for (uintmax_t j = 0; j < fdtd->sizeY - 1; ++j) {
-      for (uintmax_t k = 0; k < fdtd->sizeZ - 1; ++k) {
-        hx[i][j][k] = hx[i][j][k] + ((ey[i][j][k + 1] - ey[i][j][k]) * _dz -
-                                     (ez[i][j + 1][k] - ez[i][j][k]) * _dy) *
-                                        fdtd->dt * permeability_inv[i][j][k];
+  const struct row_share share =
+      team_rows(team, i_begin, i_end, j_begin, j_end);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+        curl2_segment(rows, &segment, n, &hx[i][j][k], &ey[i][j][k + 1],
+                      &ey[i][j][k], &ez[i][j + 1][k], &ez[i][j][k], _dz, _dy);
       }
     }
   }
-  for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    for (uintmax_t j = 0; j < fdtd->sizeY - 1; ++j) {
-      for (uintmax_t k = 0; k < fdtd->sizeZ - 1; ++k) {
-        hy[i][j][k] = hy[i][j][k] + ((ez[i + 1][j][k] - ez[i][j][k]) * _dx -
-                                     (ex[i][j][k + 1] - ex[i][j][k]) * _dz) *
-                                        fdtd->dt * permeability_inv[i][j][k];
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+        curl2_segment(rows, &segment, n, &hy[i][j][k], &ez[i + 1][j][k],
+                      &ez[i][j][k], &ex[i][j][k + 1], &ex[i][j][k], _dx, _dz);
       }
     }
   }
-  for (uintmax_t i = 0; i < fdtd->sizeX - 1; ++i) {
-    for (uintmax_t j = 0; j < fdtd->sizeY - 1; ++j) {
-      for (uintmax_t k = 0; k < fdtd->sizeZ - 1; ++k) {
-        hz[i][j][k] = hz[i][j][k] + ((ex[i][j + 1][k] - ex[i][j][k]) * _dy -
-                                     (ey[i + 1][j][k] - ey[i][j][k]) * _dx) *
-                                        fdtd->dt * permeability_inv[i][j][k];
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+        curl2_segment(rows, &segment, n, &hz[i][j][k], &ex[i][j + 1][k],
+                      &ex[i][j][k], &ey[i + 1][j][k], &ey[i][j][k], _dy, _dx);
       }
     }
   }
+  team_barrier(team);
 }
 
-static void update_magnetic_cpml(struct fdtd3D *fdtd) {
+// Single sweep reading the E components and the H coefficients once per cell
+// to write the three H components
+static void update_magnetic_field_fused(struct fdtd3D *fdtd,
+                                        const struct box3D *box,
+                                        struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
+
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t i_begin = box->begin[0];
+  const uintmax_t i_end = min_index(box->end[0], fdtd->sizeX - 1);
+  const uintmax_t j_begin = box->begin[1];
+  const uintmax_t j_end = min_index(box->end[1], fdtd->sizeY - 1);
+  const uintmax_t k_begin = box->begin[2];
+  const uintmax_t k_end = min_index(box->end[2], fdtd->sizeZ - 1);
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type da_row[fdtd->sizeZ], db_row[fdtd->sizeZ];
+
+  const struct row_share share =
+      team_rows(team, i_begin, i_end, j_begin, j_end);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+        const struct coefficient_segment segment = coefficient_segment(
+            fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+        curl2_segment(rows, &segment, n, &hx[i][j][k], &ey[i][j][k + 1],
+                      &ey[i][j][k], &ez[i][j + 1][k], &ez[i][j][k], _dz, _dy);
+        curl2_segment(rows, &segment, n, &hy[i][j][k], &ez[i + 1][j][k],
+                      &ez[i][j][k], &ex[i][j][k + 1], &ex[i][j][k], _dx, _dz);
+        curl2_segment(rows, &segment, n, &hz[i][j][k], &ex[i][j + 1][k],
+                      &ex[i][j][k], &ey[i + 1][j][k], &ey[i][j][k], _dy, _dx);
+      }
+    }
+  }
+  team_barrier(team);
+}
+
+// CPML corrections of the H components of the row (i, j) of the box, in the
+// order of update_magnetic_cpml_slabs
+static void magnetic_cpml_row(struct fdtd3D *fdtd, const struct box3D *box,
+                              uintmax_t i, uintmax_t j) {
   // Hx
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_hx_left, fdtd->psi_hx_y[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_hx_right, fdtd->psi_hx_y[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_hx_front, fdtd->psi_hx_z[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_hx_back, fdtd->psi_hx_z[1]);
   // Hy
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_hy_bottom, fdtd->psi_hy_x[0]);
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_hy_top, fdtd->psi_hy_x[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_hy_front, fdtd->psi_hy_z[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
                     psi_hy_back, fdtd->psi_hy_z[1]);
 
   // Hz
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_hz_bottom, fdtd->psi_hz_x[0]);
-  VLA_3D_definition(float_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
                     psi_hz_top, fdtd->psi_hz_x[1]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_hz_left, fdtd->psi_hz_y[0]);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
                     psi_hz_right, fdtd->psi_hz_y[1]);
   // Sim data
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permeability_inv, fdtd->permeability_inv);
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
+  // Useful constants
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+
+  const uintmax_t thickness = fdtd->cpml_thickness;
+
+  if (fdtd->border_condition[border_left] & border_cpml &&
+      j < thickness) { // hx_y & hz_y
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j + 1, k);
+      psi_hx_left[i][j][k] =
+          fdtd->by[j] * psi_hx_left[i][j][k] +
+          fdtd->cy[j] * (ez[neighbour] - ez[cell]) * _dy;
+      hx[cell] = hx[cell] - db_at(fdtd, i, j, k) * psi_hx_left[i][j][k];
+      psi_hz_left[i][j][k] =
+          fdtd->by[j] * psi_hz_left[i][j][k] +
+          fdtd->cy[j] * (ex[neighbour] - ex[cell]) * _dy;
+      hz[cell] = hz[cell] + db_at(fdtd, i, j, k) * psi_hz_left[i][j][k];
+    }
+  }
+  if (fdtd->border_condition[border_right] & border_cpml &&
+      j <= fdtd->sizeY - 2 && fdtd->sizeY - 2 - j < thickness) { // hx_y & hz_y
+    const uintmax_t d = fdtd->sizeY - 2 - j;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j + 1, k);
+      psi_hx_right[i][d][k] =
+          fdtd->by[d] * psi_hx_right[i][d][k] +
+          fdtd->cy[d] * (ez[neighbour] - ez[cell]) * _dy;
+      hx[cell] = hx[cell] - db_at(fdtd, i, j, k) * psi_hx_right[i][d][k];
+      psi_hz_right[i][d][k] =
+          fdtd->by[d] * psi_hz_right[i][d][k] +
+          fdtd->cy[d] * (ex[neighbour] - ex[cell]) * _dy;
+      hz[cell] = hz[cell] + db_at(fdtd, i, j, k) * psi_hz_right[i][d][k];
+    }
+  }
+  if (fdtd->border_condition[border_front] & border_cpml) { // hx_z & hy_z
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(0, thickness, box->begin[2], box->end[2], &d_begin,
+                          &d_end);
+    for (uintmax_t k = d_begin; k < d_end; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j, k + 1);
+      psi_hx_front[i][j][k] =
+          fdtd->bz[k] * psi_hx_front[i][j][k] +
+          fdtd->cz[k] * (ey[neighbour] - ey[cell]) * _dz;
+      hx[cell] = hx[cell] + db_at(fdtd, i, j, k) * psi_hx_front[i][j][k];
+      psi_hy_front[i][j][k] =
+          fdtd->bz[k] * psi_hy_front[i][j][k] +
+          fdtd->cz[k] * (ex[neighbour] - ex[cell]) * _dz;
+      hy[cell] = hy[cell] - db_at(fdtd, i, j, k) * psi_hy_front[i][j][k];
+    }
+  }
+  if (fdtd->border_condition[border_back] & border_cpml) { // hx_z & hy_z
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeZ - 2, thickness, box->begin[2],
+                         box->end[2], &d_begin, &d_end);
+    for (uintmax_t d = d_begin; d < d_end; ++d) {
+      const uintmax_t k = fdtd->sizeZ - 2 - d;
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i, j, k + 1);
+      psi_hx_back[i][j][d] =
+          fdtd->bz[d] * psi_hx_back[i][j][d] +
+          fdtd->cz[d] * (ey[neighbour] - ey[cell]) * _dz;
+      hx[cell] = hx[cell] + db_at(fdtd, i, j, k) * psi_hx_back[i][j][d];
+      psi_hy_back[i][j][d] =
+          fdtd->bz[d] * psi_hy_back[i][j][d] +
+          fdtd->cz[d] * (ex[neighbour] - ex[cell]) * _dz;
+      hy[cell] = hy[cell] - db_at(fdtd, i, j, k) * psi_hy_back[i][j][d];
+    }
+  }
+  if (fdtd->border_condition[border_bottom] & border_cpml &&
+      i < thickness) { // hy_x & hz_x
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i + 1, j, k);
+      psi_hy_bottom[i][j][k] =
+          fdtd->bx[i] * psi_hy_bottom[i][j][k] +
+          fdtd->cx[i] * (ez[neighbour] - ez[cell]) * _dx;
+      hy[cell] = hy[cell] + db_at(fdtd, i, j, k) * psi_hy_bottom[i][j][k];
+      psi_hz_bottom[i][j][k] =
+          fdtd->bx[i] * psi_hz_bottom[i][j][k] +
+          fdtd->cx[i] * (ey[neighbour] - ey[cell]) * _dx;
+      hz[cell] = hz[cell] - db_at(fdtd, i, j, k) * psi_hz_bottom[i][j][k];
+    }
+  }
+  if (fdtd->border_condition[border_top] & border_cpml &&
+      i <= fdtd->sizeX - 2 && fdtd->sizeX - 2 - i < thickness) { // hy_x & hz_x
+    const uintmax_t d = fdtd->sizeX - 2 - i;
+    for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+      const uintmax_t cell = field_offset(fdtd, i, j, k);
+      const uintmax_t neighbour = field_offset(fdtd, i + 1, j, k);
+      psi_hy_top[d][j][k] =
+          fdtd->bx[d] * psi_hy_top[d][j][k] +
+          fdtd->cx[d] * (ez[neighbour] - ez[cell]) * _dx;
+      hy[cell] = hy[cell] + db_at(fdtd, i, j, k) * psi_hy_top[d][j][k];
+      psi_hz_top[d][j][k] =
+          fdtd->bx[d] * psi_hz_top[d][j][k] +
+          fdtd->cx[d] * (ey[neighbour] - ey[cell]) * _dx;
+      hz[cell] = hz[cell] - db_at(fdtd, i, j, k) * psi_hz_top[d][j][k];
+    }
+  }
+}
+
+// Fused sweep applying the CPML corrections of each row right after its bulk
+// update, the rows holding sources being corrected after the sources
+static void update_magnetic_field_fused_cpml(struct fdtd3D *fdtd,
+                                             const struct box3D *box,
+                                             struct team3D team) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hx, fdtd->hx);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ex, fdtd->ex);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ey, fdtd->ey);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, ez, fdtd->ez);
+
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t k_begin = box->begin[2];
+  const uintmax_t k_end = min_index(box->end[2], fdtd->sizeZ - 1);
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type da_row[fdtd->sizeZ], db_row[fdtd->sizeZ];
+
+  const struct row_share share =
+      team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+  for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+    for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+      if (i < fdtd->sizeX - 1 && j < fdtd->sizeY - 1) {
+        for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+          const struct coefficient_segment segment = coefficient_segment(
+              fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+          curl2_segment(rows, &segment, n, &hx[i][j][k], &ey[i][j][k + 1],
+                        &ey[i][j][k], &ez[i][j + 1][k], &ez[i][j][k], _dz, _dy);
+          curl2_segment(rows, &segment, n, &hy[i][j][k], &ez[i + 1][j][k],
+                        &ez[i][j][k], &ex[i][j][k + 1], &ex[i][j][k], _dx, _dz);
+          curl2_segment(rows, &segment, n, &hz[i][j][k], &ex[i][j + 1][k],
+                        &ex[i][j][k], &ey[i + 1][j][k], &ey[i][j][k], _dy, _dx);
+        }
+      }
+      if (!is_source_row(fdtd->MsourceRows, fdtd->num_MsourceRows,
+                         i * fdtd->sizeY + j))
+        magnetic_cpml_row(fdtd, box, i, j);
+    }
+  }
+  team_barrier(team);
+}
+
+// Sweep over the bricks of the bricked layout, the three H components of each
+// brick row being updated in turn. The rows ending a brick find their k + 1
+// neighbours in the next brick, which are gathered first.
+static void update_magnetic_field_bricked(struct fdtd3D *fdtd,
+                                          const struct box3D *box,
+                                          struct team3D team) {
+  field_type *hx = fdtd->hx, *hy = fdtd->hy, *hz = fdtd->hz;
+  field_type *ex = fdtd->ex, *ey = fdtd->ey, *ez = fdtd->ez;
+
+  float_type _dy = float_cst(1.) / fdtd->dy;
+  float_type _dx = float_cst(1.) / fdtd->dx;
+  float_type _dz = float_cst(1.) / fdtd->dz;
+  const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  uintmax_t end[3], brick_begin[3], brick_end[3];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    end[axis] = min_index(box->end[axis], size[axis] - 1);
+    brick_begin[axis] = box->begin[axis] / brick_edge;
+    brick_end[axis] = (end[axis] + brick_edge - 1) / brick_edge;
+  }
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  float_type da_row[brick_edge], db_row[brick_edge];
+  field_type ex_row[brick_edge], ey_row[brick_edge];
+
+  const struct row_share share =
+      team_rows(team, brick_begin[0], brick_end[0], brick_begin[1],
+                brick_end[1]);
+  for (uintmax_t bi = share.i_begin; bi < share.i_end; ++bi) {
+    for (uintmax_t bj = first_row(&share, bi); bj < end_row(&share, bi); ++bj) {
+      for (uintmax_t bk = brick_begin[2]; bk < brick_end[2]; ++bk) {
+        const uintmax_t i_begin = max_index(bi * brick_edge, box->begin[0]);
+        const uintmax_t i_end = min_index((bi + 1) * brick_edge, end[0]);
+        const uintmax_t j_begin = max_index(bj * brick_edge, box->begin[1]);
+        const uintmax_t j_end = min_index((bj + 1) * brick_edge, end[1]);
+        const uintmax_t k_begin = max_index(bk * brick_edge, box->begin[2]);
+        const uintmax_t k_end = min_index((bk + 1) * brick_edge, end[2]);
+        if (k_begin >= k_end)
+          continue;
+        for (uintmax_t i = i_begin; i < i_end; ++i) {
+          for (uintmax_t j = j_begin; j < j_end; ++j) {
+            const uintmax_t row = brick_offset(fdtd, i, j, k_begin);
+            const uintmax_t row_i = brick_offset(fdtd, i + 1, j, k_begin);
+            const uintmax_t row_j = brick_offset(fdtd, i, j + 1, k_begin);
+            const field_type *ex_k = &ex[row + 1], *ey_k = &ey[row + 1];
+            if (k_end % brick_edge == 0) {
+              const uintmax_t last = k_end - k_begin - 1;
+              for (uintmax_t k = 0; k < last; ++k) {
+                ex_row[k] = ex[row + k + 1];
+                ey_row[k] = ey[row + k + 1];
+              }
+              const uintmax_t next = brick_offset(fdtd, i, j, k_end);
+              ex_row[last] = ex[next];
+              ey_row[last] = ey[next];
+              ex_k = ex_row;
+              ey_k = ey_row;
+            }
+            for (uintmax_t k = k_begin, n; k < k_end; k += n) {
+              const struct coefficient_segment segment = coefficient_segment(
+                  fdtd, false, i, j, k, k_end, da_row, db_row, &n);
+              const uintmax_t r = k - k_begin;
+              curl2_segment(rows, &segment, n, &hx[row + r], &ey_k[r],
+                            &ey[row + r], &ez[row_j + r], &ez[row + r], _dz,
+                            _dy);
+              curl2_segment(rows, &segment, n, &hy[row + r], &ez[row_i + r],
+                            &ez[row + r], &ex_k[r], &ex[row + r], _dx, _dz);
+              curl2_segment(rows, &segment, n, &hz[row + r], &ex[row_j + r],
+                            &ex[row + r], &ey[row_i + r], &ey[row + r], _dy,
+                            _dx);
+            }
+          }
+        }
+      }
+    }
+  }
+  team_barrier(team);
+}
+
+static void update_magnetic_field(struct fdtd3D *fdtd,
+                                  const struct box3D *box,
+                                  struct team3D team) {
+  if (fdtd->field_layout == field3D_bricked) {
+    update_magnetic_field_bricked(fdtd, box, team);
+    return;
+  }
+  switch (fdtd->kernel) {
+  case kernel3D_fused:
+    update_magnetic_field_fused(fdtd, box, team);
+    break;
+  case kernel3D_fused_cpml:
+    update_magnetic_field_fused_cpml(fdtd, box, team);
+    break;
+  default:
+    update_magnetic_field_per_component(fdtd, box, team);
+    break;
+  }
+}
+
+static void update_magnetic_cpml_slabs(struct fdtd3D *fdtd,
+                                       const struct box3D *box,
+                                       struct team3D team) {
+  // Hx
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_hx_left, fdtd->psi_hx_y[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_hx_right, fdtd->psi_hx_y[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_hx_front, fdtd->psi_hx_z[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_hx_back, fdtd->psi_hx_z[1]);
+  // Hy
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_hy_bottom, fdtd->psi_hy_x[0]);
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_hy_top, fdtd->psi_hy_x[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_hy_front, fdtd->psi_hy_z[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness,
+                    psi_hy_back, fdtd->psi_hy_z[1]);
+
+  // Hz
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_hz_bottom, fdtd->psi_hz_x[0]);
+  VLA_3D_definition(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ,
+                    psi_hz_top, fdtd->psi_hz_x[1]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_hz_left, fdtd->psi_hz_y[0]);
+  VLA_3D_definition(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ,
+                    psi_hz_right, fdtd->psi_hz_y[1]);
+  // Sim data
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
   // Useful constants
   float_type _dx = float_cst(1.) / fdtd->dx;
   float_type _dy = float_cst(1.) / fdtd->dy;
   float_type _dz = float_cst(1.) / fdtd->dz;
 
   if (fdtd->border_condition[border_left] & border_cpml) { // hx_y & hz_y
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(0, fdtd->cpml_thickness, box->begin[1],
+                          box->end[1], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], d_begin, d_end);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, k);
+          const uintmax_t neighbour = field_offset(fdtd, i, j + 1, k);
           psi_hx_left[i][j][k] =
               fdtd->by[j] * psi_hx_left[i][j][k] +
-              fdtd->cy[j] * (ez[i][j + 1][k] - ez[i][j][k]) * _dy;
-          hx[i][j][k] = hx[i][j][k] - fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hx_left[i][j][k];
+              fdtd->cy[j] * (ez[neighbour] - ez[cell]) * _dy;
+          hx[cell] = hx[cell] - db_at(fdtd, i, j, k) * psi_hx_left[i][j][k];
           psi_hz_left[i][j][k] =
               fdtd->by[j] * psi_hz_left[i][j][k] +
-              fdtd->cy[j] * (ex[i][j + 1][k] - ex[i][j][k]) * _dy;
-          hz[i][j][k] = hz[i][j][k] + fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hz_left[i][j][k];
+              fdtd->cy[j] * (ex[neighbour] - ex[cell]) * _dy;
+          hz[cell] = hz[cell] + db_at(fdtd, i, j, k) * psi_hz_left[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_right] & border_cpml) { // hx_y & hz_y
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->cpml_thickness; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-          psi_hx_right[i][j][k] = fdtd->by[j] * psi_hx_right[i][j][k] +
-                                  fdtd->cy[j] *
-                                      (ez[i][fdtd->sizeY - 1 - j][k] -
-                                       ez[i][fdtd->sizeY - 2 - j][k]) *
-                                      _dy;
-          hx[i][fdtd->sizeY - 2 - j][k] =
-              hx[i][fdtd->sizeY - 2 - j][k] -
-              fdtd->dt * permeability_inv[i][fdtd->sizeY - 2 - j][k] *
-                  psi_hx_right[i][j][k];
-          psi_hz_right[i][j][k] = fdtd->by[j] * psi_hz_right[i][j][k] +
-                                  fdtd->cy[j] *
-                                      (ex[i][fdtd->sizeY - 1 - j][k] -
-                                       ex[i][fdtd->sizeY - 2 - j][k]) *
-                                      _dy;
-          hz[i][fdtd->sizeY - 2 - j][k] =
-              hz[i][fdtd->sizeY - 2 - j][k] +
-              fdtd->dt * permeability_inv[i][fdtd->sizeY - 2 - j][k] *
-                  psi_hz_right[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeY - 2, fdtd->cpml_thickness, box->begin[1],
+                         box->end[1], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], d_begin, d_end);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, fdtd->sizeY - 2 - j, k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, i, fdtd->sizeY - 1 - j, k);
+          psi_hx_right[i][j][k] =
+              fdtd->by[j] * psi_hx_right[i][j][k] +
+              fdtd->cy[j] * (ez[neighbour] - ez[cell]) * _dy;
+          hx[cell] =
+              hx[cell] -
+              db_at(fdtd, i, fdtd->sizeY - 2 - j, k) * psi_hx_right[i][j][k];
+          psi_hz_right[i][j][k] =
+              fdtd->by[j] * psi_hz_right[i][j][k] +
+              fdtd->cy[j] * (ex[neighbour] - ex[cell]) * _dy;
+          hz[cell] =
+              hz[cell] +
+              db_at(fdtd, i, fdtd->sizeY - 2 - j, k) * psi_hz_right[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_front] & border_cpml) { // hx_z & hy_z
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->cpml_thickness; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(0, fdtd->cpml_thickness, box->begin[2],
+                          box->end[2], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = d_begin; k < d_end; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, k);
+          const uintmax_t neighbour = field_offset(fdtd, i, j, k + 1);
           psi_hx_front[i][j][k] =
               fdtd->bz[k] * psi_hx_front[i][j][k] +
-              fdtd->cz[k] * (ey[i][j][k + 1] - ey[i][j][k]) * _dz;
-          hx[i][j][k] = hx[i][j][k] + fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hx_front[i][j][k];
+              fdtd->cz[k] * (ey[neighbour] - ey[cell]) * _dz;
+          hx[cell] = hx[cell] + db_at(fdtd, i, j, k) * psi_hx_front[i][j][k];
           psi_hy_front[i][j][k] =
               fdtd->bz[k] * psi_hy_front[i][j][k] +
-              fdtd->cz[k] * (ex[i][j][k + 1] - ex[i][j][k]) * _dz;
-          hy[i][j][k] = hy[i][j][k] - fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hy_front[i][j][k];
+              fdtd->cz[k] * (ex[neighbour] - ex[cell]) * _dz;
+          hy[cell] = hy[cell] - db_at(fdtd, i, j, k) * psi_hy_front[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_back] & border_cpml) { // hx_z & hy_z
-    for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->cpml_thickness; ++k) {
-          psi_hx_back[i][j][k] = fdtd->bz[k] * psi_hx_back[i][j][k] +
-                                 fdtd->cz[k] *
-                                     (ey[i][j][fdtd->sizeZ - 1 - k] -
-                                      ey[i][j][fdtd->sizeZ - 2 - k]) *
-                                     _dz;
-          hx[i][j][fdtd->sizeZ - 2 - k] =
-              hx[i][j][fdtd->sizeZ - 2 - k] +
-              fdtd->dt * permeability_inv[i][j][fdtd->sizeZ - 2 - k] *
-                  psi_hx_back[i][j][k];
-          psi_hy_back[i][j][k] = fdtd->bz[k] * psi_hy_back[i][j][k] +
-                                 fdtd->cz[k] *
-                                     (ex[i][j][fdtd->sizeZ - 1 - k] -
-                                      ex[i][j][fdtd->sizeZ - 2 - k]) *
-                                     _dz;
-          hy[i][j][fdtd->sizeZ - 2 - k] =
-              hy[i][j][fdtd->sizeZ - 2 - k] -
-              fdtd->dt * permeability_inv[i][j][fdtd->sizeZ - 2 - k] *
-                  psi_hy_back[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeZ - 2, fdtd->cpml_thickness, box->begin[2],
+                         box->end[2], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, box->begin[0], box->end[0], box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = d_begin; k < d_end; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, fdtd->sizeZ - 2 - k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, i, j, fdtd->sizeZ - 1 - k);
+          psi_hx_back[i][j][k] =
+              fdtd->bz[k] * psi_hx_back[i][j][k] +
+              fdtd->cz[k] * (ey[neighbour] - ey[cell]) * _dz;
+          hx[cell] =
+              hx[cell] +
+              db_at(fdtd, i, j, fdtd->sizeZ - 2 - k) * psi_hx_back[i][j][k];
+          psi_hy_back[i][j][k] =
+              fdtd->bz[k] * psi_hy_back[i][j][k] +
+              fdtd->cz[k] * (ex[neighbour] - ex[cell]) * _dz;
+          hy[cell] =
+              hy[cell] -
+              db_at(fdtd, i, j, fdtd->sizeZ - 2 - k) * psi_hy_back[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_bottom] & border_cpml) { // hy_x & hz_x
-    for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
+    uintmax_t d_begin, d_end;
+    cpml_range_from_first(0, fdtd->cpml_thickness, box->begin[0],
+                          box->end[0], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, d_begin, d_end, box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, i, j, k);
+          const uintmax_t neighbour = field_offset(fdtd, i + 1, j, k);
           psi_hy_bottom[i][j][k] =
               fdtd->bx[i] * psi_hy_bottom[i][j][k] +
-              fdtd->cx[i] * (ez[i + 1][j][k] - ez[i][j][k]) * _dx;
-          hy[i][j][k] = hy[i][j][k] + fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hy_bottom[i][j][k];
+              fdtd->cx[i] * (ez[neighbour] - ez[cell]) * _dx;
+          hy[cell] = hy[cell] + db_at(fdtd, i, j, k) * psi_hy_bottom[i][j][k];
           psi_hz_bottom[i][j][k] =
               fdtd->bx[i] * psi_hz_bottom[i][j][k] +
-              fdtd->cx[i] * (ey[i + 1][j][k] - ey[i][j][k]) * _dx;
-          hz[i][j][k] = hz[i][j][k] - fdtd->dt * permeability_inv[i][j][k] *
-                                          psi_hz_bottom[i][j][k];
+              fdtd->cx[i] * (ey[neighbour] - ey[cell]) * _dx;
+          hz[cell] = hz[cell] - db_at(fdtd, i, j, k) * psi_hz_bottom[i][j][k];
         }
       }
     }
+    team_barrier(team);
   }
   if (fdtd->border_condition[border_top] & border_cpml) { // hy_x & hz_x
-    for (uintmax_t i = 0; i < fdtd->cpml_thickness; ++i) {
-      for (uintmax_t j = 0; j < fdtd->sizeY; ++j) {
-        for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-          psi_hy_top[i][j][k] = fdtd->bx[i] * psi_hy_top[i][j][k] +
-                                fdtd->cx[i] *
-                                    (ez[fdtd->sizeX - 1 - i][j][k] -
-                                     ez[fdtd->sizeX - 2 - i][j][k]) *
-                                    _dx;
-          hy[fdtd->sizeX - 2 - i][j][k] =
-              hy[fdtd->sizeX - 2 - i][j][k] +
-              fdtd->dt * permeability_inv[fdtd->sizeX - 2 - i][j][k] *
-                  psi_hy_top[i][j][k];
-          psi_hz_top[i][j][k] = fdtd->bx[i] * psi_hz_top[i][j][k] +
-                                fdtd->cx[i] *
-                                    (ey[fdtd->sizeX - 1 - i][j][k] -
-                                     ey[fdtd->sizeX - 2 - i][j][k]) *
-                                    _dx;
-          hz[fdtd->sizeX - 2 - i][j][k] =
-              hz[fdtd->sizeX - 2 - i][j][k] -
-              fdtd->dt * permeability_inv[fdtd->sizeX - 2 - i][j][k] *
-                  psi_hz_top[i][j][k];
+    uintmax_t d_begin, d_end;
+    cpml_range_from_last(fdtd->sizeX - 2, fdtd->cpml_thickness, box->begin[0],
+                         box->end[0], &d_begin, &d_end);
+    const struct row_share share =
+        team_rows(team, d_begin, d_end, box->begin[1], box->end[1]);
+    for (uintmax_t i = share.i_begin; i < share.i_end; ++i) {
+      for (uintmax_t j = first_row(&share, i); j < end_row(&share, i); ++j) {
+        for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+          const uintmax_t cell = field_offset(fdtd, fdtd->sizeX - 2 - i, j, k);
+          const uintmax_t neighbour =
+              field_offset(fdtd, fdtd->sizeX - 1 - i, j, k);
+          psi_hy_top[i][j][k] =
+              fdtd->bx[i] * psi_hy_top[i][j][k] +
+              fdtd->cx[i] * (ez[neighbour] - ez[cell]) * _dx;
+          hy[cell] =
+              hy[cell] +
+              db_at(fdtd, fdtd->sizeX - 2 - i, j, k) * psi_hy_top[i][j][k];
+          psi_hz_top[i][j][k] =
+              fdtd->bx[i] * psi_hz_top[i][j][k] +
+              fdtd->cx[i] * (ey[neighbour] - ey[cell]) * _dx;
+          hz[cell] =
+              hz[cell] -
+              db_at(fdtd, fdtd->sizeX - 2 - i, j, k) * psi_hz_top[i][j][k];
         }
       }
     }
+    team_barrier(team);
+  }
+}
+
+// CPML corrections left after the bulk update: every slab, or with the
+// fused-cpml kernel only the rows holding sources
+static void update_magnetic_cpml(struct fdtd3D *fdtd,
+                                 const struct box3D *box,
+                                 struct team3D team) {
+  if (sweep_kernel(fdtd) != kernel3D_fused_cpml) {
+    update_magnetic_cpml_slabs(fdtd, box, team);
+    return;
+  }
+  uintmax_t first, last;
+  team_share(team, fdtd->num_MsourceRows, &first, &last);
+  for (uintmax_t r = first; r < last; ++r) {
+    const uintmax_t i = fdtd->MsourceRows[r] / fdtd->sizeY;
+    const uintmax_t j = fdtd->MsourceRows[r] % fdtd->sizeY;
+    if (box_contains(box, 0, i) && box_contains(box, 1, j))
+      magnetic_cpml_row(fdtd, box, i, j);
   }
+  team_barrier(team);
 }
 
-static void border_condition_magnetic(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
+static void border_condition_magnetic(struct fdtd3D *fdtd,
+                                      const struct box3D *box,
+                                      struct team3D team) {
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
+  uintmax_t first, last;
   for (enum border_position3D i = border_front; i < num_borders_3D; ++i) {
     if (fdtd->border_condition[i] == border_perfect_electric_conductor) {
       switch (i) {
       case border_front:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeY; ++k) {
-            hx[j][k][0] = float_cst(0.);
-            hy[j][k][0] = float_cst(0.);
-            hz[j][k][0] = float_cst(0.);
+        if (!box_contains(box, 2, 0))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[1]; k < box->end[1]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, k, 0);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_back:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeY; ++k) {
-            hx[j][k][fdtd->sizeZ - 1] = float_cst(0.);
-            hy[j][k][fdtd->sizeZ - 1] = float_cst(0.);
-            hz[j][k][fdtd->sizeZ - 1] = float_cst(0.);
+        if (!box_contains(box, 2, fdtd->sizeZ - 1))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[1]; k < box->end[1]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, k, fdtd->sizeZ - 1);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_top:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            hx[fdtd->sizeX - 1][j][k] = float_cst(0.);
-            hy[fdtd->sizeX - 1][j][k] = float_cst(0.);
-            hz[fdtd->sizeX - 1][j][k] = float_cst(0.);
+        if (!box_contains(box, 0, fdtd->sizeX - 1))
+          break;
+        team_range(team, box->begin[1], box->end[1], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, fdtd->sizeX - 1, j, k);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_bottom:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            hx[0][j][k] = float_cst(0.);
-            hy[0][j][k] = float_cst(0.);
-            hz[0][j][k] = float_cst(0.);
+        if (!box_contains(box, 0, 0))
+          break;
+        team_range(team, box->begin[1], box->end[1], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, 0, j, k);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_right:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            hx[j][fdtd->sizeY - 1][k] = float_cst(0.);
-            hy[j][fdtd->sizeY - 1][k] = float_cst(0.);
-            hz[j][fdtd->sizeY - 1][k] = float_cst(0.);
+        if (!box_contains(box, 1, fdtd->sizeY - 1))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, fdtd->sizeY - 1, k);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       case border_left:
-        for (uintmax_t j = 0; j < fdtd->sizeX; ++j)
-          for (uintmax_t k = 0; k < fdtd->sizeZ; ++k) {
-            hx[j][0][k] = float_cst(0.);
-            hy[j][0][k] = float_cst(0.);
-            hz[j][0][k] = float_cst(0.);
+        if (!box_contains(box, 1, 0))
+          break;
+        team_range(team, box->begin[0], box->end[0], &first, &last);
+        for (uintmax_t j = first; j < last; ++j)
+          for (uintmax_t k = box->begin[2]; k < box->end[2]; ++k) {
+            const uintmax_t cell = field_offset(fdtd, j, 0, k);
+            hx[cell] = float_cst(0.);
+            hy[cell] = float_cst(0.);
+            hz[cell] = float_cst(0.);
           }
+        team_barrier(team);
         break;
       default:
         fprintf(stderr, "Error while processing the magnetic border "
@@ -643,82 +1811,600 @@ static void border_condition_magnetic(struct fdtd3D *fdtd) {
   }
 }
 
-static void apply_M_sources(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hx,
-                    fdtd->hx);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hy,
-                    fdtd->hy);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, hz,
-                    fdtd->hz);
+static void apply_M_sources(struct fdtd3D *fdtd,
+                            const struct box3D *box) {
+  field_type *restrict hx = fdtd->hx;
+  field_type *restrict hy = fdtd->hy;
+  field_type *restrict hz = fdtd->hz;
   VLA_2D_definition(uintmax_t, fdtd->num_Msources, 3, MsourceLocations,
                     fdtd->MsourceLocations);
   for (uintmax_t i = 0; i < fdtd->num_Msources; ++i) {
+    if (!box_contains(box, 0, MsourceLocations[i][0]) ||
+        !box_contains(box, 1, MsourceLocations[i][1]) ||
+        !box_contains(box, 2, MsourceLocations[i][2]))
+      continue;
     switch (fdtd->Msources[i].type) {
-    case source_gaussian_pulse:
-      hy[MsourceLocations[i][0]][MsourceLocations[i][1]]
-        [MsourceLocations[i][2]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
-      hx[MsourceLocations[i][0]][MsourceLocations[i][1]]
-        [MsourceLocations[i][2]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
-      hz[MsourceLocations[i][0]][MsourceLocations[i][1]]
-        [MsourceLocations[i][2]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
+    case source_gaussian_pulse: {
+      const uintmax_t cell =
+          field_offset(fdtd, MsourceLocations[i][0], MsourceLocations[i][1],
+                       MsourceLocations[i][2]);
+      hy[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
+      hx[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
+      hz[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Msources[i]);
       break;
+    }
     default:
       break;
     }
   }
 }
 
-static void apply_J_sources(struct fdtd3D *fdtd) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ex,
-                    fdtd->ex);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ey,
-                    fdtd->ey);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, ez,
-                    fdtd->ez);
+static void apply_J_sources(struct fdtd3D *fdtd,
+                            const struct box3D *box) {
+  field_type *restrict ex = fdtd->ex;
+  field_type *restrict ey = fdtd->ey;
+  field_type *restrict ez = fdtd->ez;
   VLA_2D_definition(uintmax_t, fdtd->num_Jsources, 3, JsourceLocations,
                     fdtd->JsourceLocations);
   for (uintmax_t i = 0; i < fdtd->num_Jsources; ++i) {
+    if (!box_contains(box, 0, JsourceLocations[i][0]) ||
+        !box_contains(box, 1, JsourceLocations[i][1]) ||
+        !box_contains(box, 2, JsourceLocations[i][2]))
+      continue;
     switch (fdtd->Jsources[i].type) {
-    case source_gaussian_pulse:
-      ex[JsourceLocations[i][0]][JsourceLocations[i][1]]
-        [JsourceLocations[i][1]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
-      ey[JsourceLocations[i][0]][JsourceLocations[i][1]]
-        [JsourceLocations[i][1]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
-      ez[JsourceLocations[i][0]][JsourceLocations[i][1]]
-        [JsourceLocations[i][1]] +=
-          gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
+    case source_gaussian_pulse: {
+      const uintmax_t cell =
+          field_offset(fdtd, JsourceLocations[i][0], JsourceLocations[i][1],
+                       JsourceLocations[i][2]);
+      ex[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
+      ey[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
+      ez[cell] += gaussian_pulse_val(fdtd->time, &fdtd->Jsources[i]);
       break;
+    }
     default:
       break;
     }
   }
 }
 
-void init_fdtd_3D_medium(struct fdtd3D *fdtd,
-                         init_medium_fun_3D permeability_invR,
-                         init_medium_fun_3D permittivity_invR, void *user) {
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permittivity_inv, fdtd->permittivity_inv);
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ,
-                    permeability_inv, fdtd->permeability_inv);
-  float_type posX = float_cst(0.);
+// Magnetic field update over the box, called by every thread of the team
+static void magnetic_box_phase(struct fdtd3D *fdtd, const struct box3D *box,
+                               struct team3D team) {
+  update_magnetic_field(fdtd, box, team);
+  if (team.thread == 0)
+    apply_M_sources(fdtd, box);
+  team_barrier(team);
+  update_magnetic_cpml(fdtd, box, team);
+  border_condition_magnetic(fdtd, box, team);
+}
+
+// Electric field update over the box, called by every thread of the team
+static void electric_box_phase(struct fdtd3D *fdtd, const struct box3D *box,
+                               struct team3D team) {
+  update_electric_field(fdtd, box, team);
+  if (team.thread == 0)
+    apply_J_sources(fdtd, box);
+  team_barrier(team);
+  update_electric_cpml(fdtd, box, team);
+  border_condition_electric(fdtd, box, team);
+}
+
+static bool is_cache_tiled(const struct fdtd3D *fdtd) {
+  return fdtd->tile_shape[0] > 0 || fdtd->tile_shape[1] > 0 ||
+         fdtd->tile_shape[2] > 0;
+}
+
+// Runs the phase over the cache tiles of the box, called by every thread of
+// the team. Each tile goes through the bulk, source, CPML and border updates
+// by a lone thread, while its cells are in cache.
+static void cache_tiled_phase(struct fdtd3D *fdtd,
+                              void (*phase)(struct fdtd3D *,
+                                            const struct box3D *,
+                                            struct team3D),
+                              const struct box3D *box, struct team3D team) {
+  uintmax_t shape[3], num_tiles[3];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    const uintmax_t extent = box->end[axis] - box->begin[axis];
+    shape[axis] = fdtd->tile_shape[axis] > 0
+                      ? min_index(fdtd->tile_shape[axis], extent)
+                      : extent;
+    num_tiles[axis] = shape[axis] > 0 ? (extent + shape[axis] - 1) / shape[axis]
+                                      : 0;
+  }
+  uintmax_t first, last;
+  team_share(team, num_tiles[0] * num_tiles[1] * num_tiles[2], &first, &last);
+  for (uintmax_t t = first; t < last; ++t) {
+    const uintmax_t tile[3] = {t / (num_tiles[1] * num_tiles[2]),
+                               t / num_tiles[2] % num_tiles[1],
+                               t % num_tiles[2]};
+    struct box3D tile_box;
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      tile_box.begin[axis] = box->begin[axis] + tile[axis] * shape[axis];
+      tile_box.end[axis] =
+          min_index(tile_box.begin[axis] + shape[axis], box->end[axis]);
+    }
+    phase(fdtd, &tile_box, lone_thread);
+  }
+  team_barrier(team);
+}
+
+// Magnetic field update over the box, called by every thread of the team
+static void magnetic_phase(struct fdtd3D *fdtd, const struct box3D *box,
+                           struct team3D team) {
+  if (is_cache_tiled(fdtd))
+    cache_tiled_phase(fdtd, magnetic_box_phase, box, team);
+  else
+    magnetic_box_phase(fdtd, box, team);
+}
+
+// Electric field update over the box, called by every thread of the team
+static void electric_phase(struct fdtd3D *fdtd, const struct box3D *box,
+                           struct team3D team) {
+  if (is_cache_tiled(fdtd))
+    cache_tiled_phase(fdtd, electric_box_phase, box, team);
+  else
+    electric_box_phase(fdtd, box, team);
+}
+
+// Splits the owned cells into the planes sent to the neighbours (at most one
+// disjoint box per side) and the interior. The halo cells belong to none.
+static unsigned split_boundary_boxes(const struct fdtd3D *fdtd,
+                                     struct box3D boundary[6],
+                                     struct box3D *interior) {
+  const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    interior->begin[axis] =
+        fdtd3D_has_neighbour(fdtd->decomposition, axis, 0) ? 1 : 0;
+    interior->end[axis] =
+        size[axis] -
+        (fdtd3D_has_neighbour(fdtd->decomposition, axis, 1) ? 1 : 0);
+  }
+  unsigned num_boxes = 0;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    if (fdtd3D_has_neighbour(fdtd->decomposition, axis, 0)) {
+      boundary[num_boxes] = *interior;
+      boundary[num_boxes].end[axis] = interior->begin[axis] + 1;
+      interior->begin[axis]++;
+      num_boxes++;
+    }
+    if (fdtd3D_has_neighbour(fdtd->decomposition, axis, 1)) {
+      boundary[num_boxes] = *interior;
+      boundary[num_boxes].begin[axis] = interior->end[axis] - 1;
+      interior->end[axis]--;
+      num_boxes++;
+    }
+  }
+  return num_boxes;
+}
+
+// Blocking halo exchange accounted as exposed communication
+static void exchange_halos_timed(struct fdtd3D *fdtd, enum fdtd3D_halo which,
+                                 struct fdtd3D_halo_timings *timings) {
+  if (fdtd->decomposition == NULL)
+    return;
+  time_measure start, end;
+  get_current_time(&start);
+  fdtd3D_exchange_halos(fdtd, which);
+  get_current_time(&end);
+  timings->wait += measuring_difftime(start, end);
+}
+
+// Timers of the split-phase schedule, only used by the master thread
+struct split_phase_timers {
+  bool first_step;
+  time_measure start, end;
+  double boundary, interior, wait, reference;
+};
+
+// One field update of the split-phase schedule, called by the whole team.
+// The planes sent to the neighbours are updated first, then their transfer
+// runs while the interior is updated. During the first step the transfers
+// are waited for right away to time a non overlapped exchange.
+static void split_phase_update(struct fdtd3D *fdtd, enum fdtd3D_halo halo,
+                               const struct box3D boundary[],
+                               unsigned num_boundary,
+                               const struct box3D *interior,
+                               struct split_phase_timers *timers) {
+  void (*phase)(struct fdtd3D *, const struct box3D *, struct team3D) =
+      halo == halo_magnetic ? magnetic_phase : electric_phase;
+  const struct team3D team = whole_team();
+#pragma omp master
+  get_current_time(&timers->start);
+  for (unsigned b = 0; b < num_boundary; ++b)
+    phase(fdtd, &boundary[b], team);
+#pragma omp master
+  {
+    get_current_time(&timers->end);
+    timers->boundary += measuring_difftime(timers->start, timers->end);
+    timers->start = timers->end;
+    fdtd3D_start_halo_exchange(fdtd, halo);
+    if (timers->first_step) {
+      fdtd3D_finish_halo_exchange(fdtd);
+      get_current_time(&timers->end);
+      timers->reference += measuring_difftime(timers->start, timers->end);
+      timers->start = timers->end;
+    }
+  }
+  phase(fdtd, interior, team);
+#pragma omp master
+  {
+    get_current_time(&timers->end);
+    timers->interior += measuring_difftime(timers->start, timers->end);
+    timers->start = timers->end;
+    fdtd3D_finish_halo_exchange(fdtd);
+    get_current_time(&timers->end);
+    timers->wait += measuring_difftime(timers->start, timers->end);
+  }
+#pragma omp barrier
+}
+
+// Extent along x and y of the work-stealing tiles, which span the whole z
+// axis
+#define work_stealing_tile_size 8
+
+// Tiles covering the local grid, released with free()
+static size_t work_stealing_tiles(const struct fdtd3D *fdtd,
+                                  struct box3D **tiles) {
+  const uintmax_t tiles_x =
+      (fdtd->sizeX + work_stealing_tile_size - 1) / work_stealing_tile_size;
+  const uintmax_t tiles_y =
+      (fdtd->sizeY + work_stealing_tile_size - 1) / work_stealing_tile_size;
+  *tiles = malloc(tiles_x * tiles_y * sizeof(**tiles));
+  size_t num_tiles = 0;
+  for (uintmax_t i = 0; i < fdtd->sizeX; i += work_stealing_tile_size) {
+    for (uintmax_t j = 0; j < fdtd->sizeY; j += work_stealing_tile_size) {
+      struct box3D tile = {
+          {i, j, 0},
+          {min_index(i + work_stealing_tile_size, fdtd->sizeX),
+           min_index(j + work_stealing_tile_size, fdtd->sizeY), fdtd->sizeZ}};
+      (*tiles)[num_tiles++] = tile;
+    }
+  }
+  return num_tiles;
+}
+
+// Runs the phase over every tile of the pool, called by the whole team. Each
+// tile is updated by the lone thread taking it.
+static void work_stealing_phase(struct fdtd3D *fdtd,
+                                void (*phase)(struct fdtd3D *,
+                                              const struct box3D *,
+                                              struct team3D),
+                                const struct box3D *tiles,
+                                struct fdtd_tile_pool *pool, unsigned thread,
+                                unsigned num_threads) {
+#pragma omp single
+  fdtd_tile_pool_fill(pool, num_threads);
+  size_t tile;
+  while (fdtd_tile_pool_next(pool, thread, &tile)) {
+    time_measure start, end;
+    get_current_time(&start);
+    phase(fdtd, &tiles[tile], lone_thread);
+    get_current_time(&end);
+    fdtd_tile_pool_account(pool, thread, tile, measuring_difftime(start, end));
+  }
+#pragma omp barrier
+}
+
+// Extent along x and y of the temporal blocking tiles, which span the whole z
+// axis, and default number of steps advanced per tile
+#define temporal_tile_size 16
+#define default_time_tile_depth 4
+
+// Bounds along an axis of the tile at the step of the time block. The tiles
+// move back by one cell per step, the last one extending to the grid end.
+static void skewed_tile_range(uintmax_t tile, uintmax_t num_tiles,
+                              unsigned step, uintmax_t size,
+                              uintmax_t *begin, uintmax_t *end) {
+  const uintmax_t lo = tile * temporal_tile_size;
+  const uintmax_t hi = lo + temporal_tile_size;
+  *begin = min_index(lo > step ? lo - step : 0, size);
+  *end = tile + 1 == num_tiles ? size
+                               : min_index(hi > step ? hi - step : 0, size);
+}
+
+// Advances the tile by the steps of the time block, called by one thread.
+// Every step only reads cells of the tile or of the tiles with smaller x and
+// y indices, which are already advanced to that step but not further, the
+// grid fields then hold the same values as with a step by step update. The
+// sources see the time of their step through a private copy of the grid.
+static void temporal_tile_steps(const struct fdtd3D *fdtd, uintmax_t tile_i,
+                                uintmax_t tile_j, const uintmax_t num_tiles[2],
+                                const float_type step_times[],
+                                unsigned num_steps) {
+  struct fdtd3D step_fdtd = *fdtd;
+  for (unsigned step = 0; step < num_steps; ++step) {
+    struct box3D box = {{0, 0, 0}, {0, 0, fdtd->sizeZ}};
+    skewed_tile_range(tile_i, num_tiles[0], step, fdtd->sizeX, &box.begin[0],
+                      &box.end[0]);
+    skewed_tile_range(tile_j, num_tiles[1], step, fdtd->sizeY, &box.begin[1],
+                      &box.end[1]);
+    if (box.begin[0] >= box.end[0] || box.begin[1] >= box.end[1])
+      continue;
+    step_fdtd.time = step_times[step];
+    magnetic_phase(&step_fdtd, &box, lone_thread);
+    electric_phase(&step_fdtd, &box, lone_thread);
+  }
+}
+
+// Advances the grid by the steps of the time block, called by the whole
+// team. The tiles of an anti-diagonal do not depend on each other and form a
+// wavefront shared by the threads.
+static void temporal_blocking_steps(struct fdtd3D *fdtd,
+                                    const uintmax_t num_tiles[2],
+                                    const float_type step_times[],
+                                    unsigned num_steps) {
+  for (uintmax_t wave = 0; wave < num_tiles[0] + num_tiles[1] - 1; ++wave) {
+    const uintmax_t i_begin =
+        wave >= num_tiles[1] ? wave + 1 - num_tiles[1] : 0;
+    const uintmax_t i_end = min_index(wave + 1, num_tiles[0]);
+#pragma omp for schedule(dynamic)
+    for (uintmax_t tile_i = i_begin; tile_i < i_end; ++tile_i)
+      temporal_tile_steps(fdtd, tile_i, wave - tile_i, num_tiles, step_times,
+                          num_steps);
+  }
+}
+
+// Position of the cell index along an axis, accumulated the same way as in
+// the medium initialization loop so that distributed runs see the exact same
+// positions as a single process run
+static float_type accumulated_position(uintmax_t index, float_type step) {
+  float_type pos = float_cst(0.);
+  for (uintmax_t i = 0; i < index; ++i)
+    pos += step;
+  return pos;
+}
+
+static enum fdtd3D_field_layout field_layout = field3D_separate;
+
+void fdtd3D_set_field_layout(enum fdtd3D_field_layout layout) {
+  field_layout = layout;
+}
+
+enum fdtd3D_field_layout fdtd3D_get_field_layout(void) { return field_layout; }
+
+static enum fdtd3D_medium_storage medium_storage = medium3D_per_cell;
+
+void fdtd3D_set_medium_storage(enum fdtd3D_medium_storage storage) {
+  medium_storage = storage;
+}
+
+enum fdtd3D_medium_storage fdtd3D_get_medium_storage(void) {
+  return medium_storage;
+}
+
+static bool classify_medium_tiles = true;
+static uintmax_t medium_tile_shape[3] = {8, 8, 16};
+
+void fdtd3D_set_medium_tile_shape(const uintmax_t shape[3]) {
+  classify_medium_tiles = shape != NULL;
+  if (shape != NULL)
+    memcpy(medium_tile_shape, shape, sizeof(medium_tile_shape));
+}
+
+static bool measure_medium_tile_rates = false;
+
+void fdtd3D_set_medium_tile_rates(bool measure) {
+  measure_medium_tile_rates = measure;
+}
+
+// Cells of a field volume, the padding included. The interleaved rows are a
+// single volume holding the six fields.
+static uintmax_t field_volume_cells(const struct fdtd3D *fdtd) {
+  if (fdtd->field_layout == field3D_bricked)
+    return fdtd->bricks[0] * fdtd->bricks[1] * fdtd->bricks[2] * brick_cells;
+  return fdtd->sizeX * fdtd->field_rows * fdtd->field_pitch;
+}
+
+// Cells of a coefficient or material id volume, the padding included
+static uintmax_t medium_volume_cells(const struct fdtd3D *fdtd) {
+  if (fdtd->field_layout == field3D_bricked)
+    return fdtd->bricks[0] * fdtd->bricks[1] * fdtd->bricks[2] * brick_cells;
+  return fdtd->sizeX * fdtd->medium_rows * fdtd->medium_pitch;
+}
+
+// Requests a field, coefficient or material id volume of the given padded
+// shape, which the bricked layout ignores
+static void request_volume(struct fdtd3D *fdtd, void **ptr,
+                           struct fdtd_volume_shape shape, size_t elem_size) {
+  if (fdtd->field_layout == field3D_bricked)
+    fdtd_arena_request(&fdtd->arena, ptr, fdtd->bricks[0],
+                       fdtd->bricks[1] * fdtd->bricks[2], brick_cells,
+                       elem_size);
+  else
+    fdtd_arena_request_padded(&fdtd->arena, ptr, fdtd->sizeX, fdtd->sizeY,
+                              fdtd->sizeZ, shape, elem_size);
+}
+
+static size_t material_id_size(enum fdtd3D_medium_storage storage) {
+  switch (storage) {
+  case medium3D_uint8_ids:
+    return sizeof(uint8_t);
+  case medium3D_uint16_ids:
+    return sizeof(uint16_t);
+  default:
+    return 0;
+  }
+}
+
+// Whether the material id has the coefficients {ca, cb, da, db}
+static bool is_material(const struct fdtd3D_material_table *table,
+                        unsigned id, const float_type coefficients[4]) {
+  return same_coefficient(table->ca[id], coefficients[0]) &&
+         same_coefficient(table->cb[id], coefficients[1]) &&
+         same_coefficient(table->da[id], coefficients[2]) &&
+         same_coefficient(table->db[id], coefficients[3]);
+}
+
+// Id of the medium with the coefficients {ca, cb, da, db} in the material
+// table, appended when new. The hint is checked first as neighbouring cells
+// mostly share their medium.
+static unsigned material_id(struct fdtd3D *fdtd,
+                            const float_type coefficients[4], unsigned hint) {
+  struct fdtd3D_material_table *table = &fdtd->materials;
+  if (hint < table->count && is_material(table, hint, coefficients))
+    return hint;
+  for (unsigned id = 0; id < table->count; ++id)
+    if (is_material(table, id, coefficients))
+      return id;
+  const unsigned max_count = fdtd->medium_storage == medium3D_uint8_ids
+                                 ? UINT8_MAX + 1
+                                 : UINT16_MAX + 1;
+  if (table->count == max_count) {
+    fprintf(stderr,
+            "The medium has more than %u distinct materials, please use a "
+            "wider medium storage than %s\n",
+            max_count, fdtd3D_medium_storage_name[fdtd->medium_storage]);
+    exit(EXIT_FAILURE);
+  }
+  const unsigned id = table->count++;
+  table->ca = realloc(table->ca, table->count * sizeof(*table->ca));
+  table->cb = realloc(table->cb, table->count * sizeof(*table->cb));
+  table->da = realloc(table->da, table->count * sizeof(*table->da));
+  table->db = realloc(table->db, table->count * sizeof(*table->db));
+  table->ca[id] = coefficients[0];
+  table->cb[id] = coefficients[1];
+  table->da[id] = coefficients[2];
+  table->db[id] = coefficients[3];
+  return id;
+}
+
+// Sorts the medium tiles into uniform and mixed ones, separately for the E
+// and the H coefficients, once they are all set
+static void classify_tiles(struct fdtd3D *fdtd) {
+  struct fdtd3D_medium_tiles *tiles = &fdtd->medium_tiles;
+  if (tiles->shape[0] == 0)
+    return;
+  const size_t num_tiles = tiles->count[0] * tiles->count[1] * tiles->count[2];
+  if (tiles->e_uniform == NULL) {
+    tiles->e_uniform = malloc(num_tiles * sizeof(*tiles->e_uniform));
+    tiles->h_uniform = malloc(num_tiles * sizeof(*tiles->h_uniform));
+    tiles->ca = malloc(num_tiles * sizeof(*tiles->ca));
+    tiles->cb = malloc(num_tiles * sizeof(*tiles->cb));
+    tiles->da = malloc(num_tiles * sizeof(*tiles->da));
+    tiles->db = malloc(num_tiles * sizeof(*tiles->db));
+  }
+  const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  size_t e_tiles = 0, h_tiles = 0;
+  uintmax_t e_cells = 0, h_cells = 0;
+#pragma omp parallel for collapse(3)                                           \
+    reduction(+ : e_tiles, h_tiles, e_cells, h_cells)
+  for (uintmax_t ti = 0; ti < tiles->count[0]; ++ti) {
+    for (uintmax_t tj = 0; tj < tiles->count[1]; ++tj) {
+      for (uintmax_t tk = 0; tk < tiles->count[2]; ++tk) {
+        const size_t tile = (ti * tiles->count[1] + tj) * tiles->count[2] + tk;
+        const uintmax_t tile_index[3] = {ti, tj, tk};
+        uintmax_t begin[3], end[3], cells = 1;
+        for (unsigned axis = 0; axis < 3; ++axis) {
+          begin[axis] = tile_index[axis] * tiles->shape[axis];
+          end[axis] = min_index(begin[axis] + tiles->shape[axis], size[axis]);
+          cells *= end[axis] - begin[axis];
+        }
+        const float_type ca = ca_at(fdtd, begin[0], begin[1], begin[2]);
+        const float_type cb = cb_at(fdtd, begin[0], begin[1], begin[2]);
+        const float_type da = da_at(fdtd, begin[0], begin[1], begin[2]);
+        const float_type db = db_at(fdtd, begin[0], begin[1], begin[2]);
+        bool e_uniform = true, h_uniform = true;
+        for (uintmax_t i = begin[0]; i < end[0] && (e_uniform || h_uniform);
+             ++i) {
+          for (uintmax_t j = begin[1]; j < end[1]; ++j) {
+            for (uintmax_t k = begin[2]; k < end[2]; ++k) {
+              e_uniform = e_uniform &&
+                          same_coefficient(ca_at(fdtd, i, j, k), ca) &&
+                          same_coefficient(cb_at(fdtd, i, j, k), cb);
+              h_uniform = h_uniform &&
+                          same_coefficient(da_at(fdtd, i, j, k), da) &&
+                          same_coefficient(db_at(fdtd, i, j, k), db);
+            }
+          }
+        }
+        tiles->e_uniform[tile] = e_uniform;
+        tiles->h_uniform[tile] = h_uniform;
+        tiles->ca[tile] = ca;
+        tiles->cb[tile] = cb;
+        tiles->da[tile] = da;
+        tiles->db[tile] = db;
+        if (e_uniform) {
+          e_tiles++;
+          e_cells += cells;
+        }
+        if (h_uniform) {
+          h_tiles++;
+          h_cells += cells;
+        }
+      }
+    }
+  }
+  tiles->e_tiles = e_tiles;
+  tiles->h_tiles = h_tiles;
+  tiles->e_cells = e_cells;
+  tiles->h_cells = h_cells;
+}
+
+void init_fdtd_3D_lossy_medium(struct fdtd3D *fdtd,
+                               init_medium_fun_3D permeability_invR,
+                               init_medium_fun_3D permittivity_invR,
+                               init_medium_fun_3D magnetic_conductivityR,
+                               init_medium_fun_3D electric_conductivityR,
+                               void *user) {
+  float_type *restrict ca = fdtd->ca, *restrict cb = fdtd->cb;
+  float_type *restrict da = fdtd->da, *restrict db = fdtd->db;
+  // Every cell is assigned again, the previous media are forgotten
+  fdtd->materials.count = 0;
+  unsigned id = 0;
+  const float_type startY = accumulated_position(fdtd->offset[1], fdtd->dy);
+  const float_type startZ = accumulated_position(fdtd->offset[2], fdtd->dz);
+  float_type posX = accumulated_position(fdtd->offset[0], fdtd->dx);
   for (uintmax_t i = 0; i < fdtd->sizeX; ++i, posX += fdtd->dx) {
-    float_type posY = float_cst(0.);
+    float_type posY = startY;
     for (uintmax_t j = 0; j < fdtd->sizeY; ++j, posY += fdtd->dy) {
-      float_type posZ = float_cst(0.);
+      float_type posZ = startZ;
       for (uintmax_t k = 0; k < fdtd->sizeZ; ++k, posZ += fdtd->dz) {
-        permeability_inv[i][j][k] =
+        const uintmax_t cell = medium_offset(fdtd, i, j, k);
+        const float_type permeability_inv =
             float_cst(1.) / (permeability_invR(posX, posY, posZ, user) * mu0);
-        permittivity_inv[i][j][k] =
+        const float_type permittivity_inv =
             float_cst(1.) / (permittivity_invR(posX, posY, posZ, user) * eps0);
+        const float_type sigma_m =
+            magnetic_conductivityR == NULL
+                ? float_cst(0.)
+                : magnetic_conductivityR(posX, posY, posZ, user);
+        const float_type sigma_e =
+            electric_conductivityR == NULL
+                ? float_cst(0.)
+                : electric_conductivityR(posX, posY, posZ, user);
+        const float_type coefficients[4] = {
+            update_coefficient_a(fdtd->dt, permittivity_inv, sigma_e),
+            update_coefficient_b(fdtd->dt, permittivity_inv, sigma_e),
+            update_coefficient_a(fdtd->dt, permeability_inv, sigma_m),
+            update_coefficient_b(fdtd->dt, permeability_inv, sigma_m),
+        };
+        switch (fdtd->medium_storage) {
+        case medium3D_uint8_ids:
+          id = material_id(fdtd, coefficients, id);
+          ((uint8_t *)fdtd->material_ids)[cell] = (uint8_t)id;
+          break;
+        case medium3D_uint16_ids:
+          id = material_id(fdtd, coefficients, id);
+          ((uint16_t *)fdtd->material_ids)[cell] = (uint16_t)id;
+          break;
+        default:
+          ca[cell] = coefficients[0];
+          cb[cell] = coefficients[1];
+          da[cell] = coefficients[2];
+          db[cell] = coefficients[3];
+          break;
+        }
       }
     }
   }
+  classify_tiles(fdtd);
+}
+
+void init_fdtd_3D_medium(struct fdtd3D *fdtd,
+                         init_medium_fun_3D permeability_invR,
+                         init_medium_fun_3D permittivity_invR, void *user) {
+  init_fdtd_3D_lossy_medium(fdtd, permeability_invR, permittivity_invR, NULL,
+                            NULL, user);
 }
 
 struct fdtd3D init_fdtd_3D(float_type domain_size[3], float_type Sc,
@@ -727,12 +2413,15 @@ struct fdtd3D init_fdtd_3D(float_type domain_size[3], float_type Sc,
   return init_fdtd_3D_cpml(domain_size, Sc, smallest_wavelength, borders, 0);
 }
 
-struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
-                                float_type smallest_wavelength,
-                                enum border_condition borders[num_borders_3D],
-                                uintmax_t cpml_thickness) {
-
-  float_type dx = smallest_wavelength / float_cst(20.);
+// Grid of dx wide cells with its media held in storage and classified over
+// medium tiles of the given shape (NULL for none), report prints the steps
+// and the sizes
+static struct fdtd3D
+init_fdtd_3D_grid(const float_type domain_size[3], float_type dx,
+                  float_type Sc, const enum border_condition borders[],
+                  uintmax_t cpml_thickness, enum fdtd3D_field_layout layout,
+                  enum fdtd3D_medium_storage storage, const uintmax_t tiles[3],
+                  bool report) {
   float_type dy = dx;
   float_type dz = dx;
   float_type dt = dx * Sc / c_light;
@@ -749,21 +2438,83 @@ struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
             "Please use a value lesser or equal to %.5f\n",
             Sc_max);
 
+  const uintmax_t global_size[3] = {sizeX, sizeY, sizeZ};
+  uintmax_t offset[3], local_size[3];
+  const unsigned fields_per_row = layout == field3D_interleaved ? 6 : 1;
+  struct fdtd3D_decomposition *decomposition =
+      fdtd3D_decompose(global_size, offset, local_size, fields_per_row);
+  sizeX = local_size[0];
+  sizeY = local_size[1];
+  sizeZ = local_size[2];
+  if (layout == field3D_bricked && decomposition != NULL) {
+    fprintf(stderr, "The bricked field layout is limited to a single "
+                    "process\n");
+    exit(EXIT_FAILURE);
+  }
+  // Only the blocks owning a physical border apply its boundary condition
+  enum border_condition local_borders[num_borders_3D];
+  const enum border_position3D lower_border[3] = {border_bottom, border_left,
+                                                  border_front};
+  const enum border_position3D upper_border[3] = {border_top, border_right,
+                                                  border_back};
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    local_borders[lower_border[axis]] =
+        fdtd3D_has_neighbour(decomposition, axis, 0)
+            ? 0
+            : borders[lower_border[axis]];
+    local_borders[upper_border[axis]] =
+        fdtd3D_has_neighbour(decomposition, axis, 1)
+            ? 0
+            : borders[upper_border[axis]];
+    if (local_size[axis] < cpml_thickness + 2 &&
+        (local_borders[lower_border[axis]] & border_cpml ||
+         local_borders[upper_border[axis]] & border_cpml)) {
+      fprintf(stderr, "The local domain is thinner than the CPML border\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // The interleaved rows of a cell row are hx, hy, hz, ex, ey and ez in turn
+  const uintmax_t row_cells = fields_per_row * sizeZ;
+  // The bricks are the rows of the bricked volumes, which are not padded
+  const uintmax_t bricks[3] = {(sizeX + brick_edge - 1) / brick_edge,
+                               (sizeY + brick_edge - 1) / brick_edge,
+                               (sizeZ + brick_edge - 1) / brick_edge};
+  struct fdtd_volume_shape field_shape = {sizeY, row_cells};
+  struct fdtd_volume_shape medium_shape = {sizeY, sizeZ};
+  if (layout != field3D_bricked) {
+    field_shape =
+        fdtd_volume_shape(sizeX, sizeY, row_cells, sizeof(field_type));
+    medium_shape = fdtd_volume_shape(
+        sizeX, sizeY, sizeZ,
+        storage == medium3D_per_cell ? sizeof(float_type)
+                                     : material_id_size(storage));
+  }
   struct fdtd3D fdtd = {
       .dx = dx,
       .dy = dy,
       .dz = dz,
       .dt = dt,
-      .hx = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .hy = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .hz = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .ex = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .ey = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .ez = calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .permittivity_inv =
-          calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
-      .permeability_inv =
-          calloc(1, VLA_3D_size(float_type, sizeX, sizeY, sizeZ)),
+      .hx = NULL,
+      .hy = NULL,
+      .hz = NULL,
+      .ex = NULL,
+      .ey = NULL,
+      .ez = NULL,
+      .field_layout = layout,
+      .field_rows = field_shape.rows,
+      .field_pitch = field_shape.pitch,
+      .bricks = {bricks[0], bricks[1], bricks[2]},
+      .medium_rows = medium_shape.rows,
+      .medium_pitch = medium_shape.pitch,
+      .ca = NULL,
+      .cb = NULL,
+      .da = NULL,
+      .db = NULL,
+      .material_ids = NULL,
+      .medium_storage = storage,
+      .materials = {0, NULL, NULL, NULL, NULL},
+      .medium_tiles = {.shape = {0, 0, 0}, .count = {0, 0, 0}},
       .psi_hx_y = {NULL, NULL},
       .psi_hx_z = {NULL, NULL},
       .psi_hy_x = {NULL, NULL},
@@ -785,17 +2536,20 @@ struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
       .cpml_thickness = cpml_thickness,
       .border_condition =
           {
-              [border_front] = borders[border_front],
-              [border_back] = borders[border_back],
-              [border_top] = borders[border_top],
-              [border_bottom] = borders[border_bottom],
-              [border_right] = borders[border_right],
-              [border_left] = borders[border_left],
+              [border_front] = local_borders[border_front],
+              [border_back] = local_borders[border_back],
+              [border_top] = local_borders[border_top],
+              [border_bottom] = local_borders[border_bottom],
+              [border_right] = local_borders[border_right],
+              [border_left] = local_borders[border_left],
           },
       .domain_size = {domain_size[0], domain_size[1], domain_size[2]},
       .sizeX = sizeX,
       .sizeY = sizeY,
       .sizeZ = sizeZ,
+      .global_size = {global_size[0], global_size[1], global_size[2]},
+      .offset = {offset[0], offset[1], offset[2]},
+      .decomposition = decomposition,
       .Sc = Sc,
       .num_Jsources = 0,
       .Jsources = NULL,
@@ -803,74 +2557,119 @@ struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
       .num_Msources = 0,
       .Msources = NULL,
       .MsourceLocations = NULL,
+      .JsourceRows = NULL,
+      .num_JsourceRows = 0,
+      .MsourceRows = NULL,
+      .num_MsourceRows = 0,
       .time = float_cst(0.),
+      .engine = engine3D_fork_join,
+      .kernel = kernel3D_per_component,
+      .time_tile_depth = default_time_tile_depth,
+      .tile_shape = {0, 0, 0},
+      .arena = fdtd_arena_init(),
   };
 
+  if (tiles != NULL) {
+    const uintmax_t size[3] = {sizeX, sizeY, sizeZ};
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      fdtd.medium_tiles.shape[axis] =
+          tiles[axis] > 0 ? min_index(tiles[axis], size[axis]) : size[axis];
+      fdtd.medium_tiles.count[axis] =
+          (size[axis] + fdtd.medium_tiles.shape[axis] - 1) /
+          fdtd.medium_tiles.shape[axis];
+    }
+  }
+  void **fields[6] = {&fdtd.hx, &fdtd.hy, &fdtd.hz, &fdtd.ex, &fdtd.ey,
+                      &fdtd.ez};
+  if (layout == field3D_interleaved) {
+    fdtd_arena_request_padded(&fdtd.arena, &fdtd.hx, sizeX, sizeY, row_cells,
+                              field_shape, sizeof(field_type));
+  } else {
+    for (unsigned f = 0; f < 6; ++f)
+      request_volume(&fdtd, fields[f], field_shape, sizeof(field_type));
+  }
+  if (storage == medium3D_per_cell) {
+    request_volume(&fdtd, &fdtd.ca, medium_shape, sizeof(float_type));
+    request_volume(&fdtd, &fdtd.cb, medium_shape, sizeof(float_type));
+    request_volume(&fdtd, &fdtd.da, medium_shape, sizeof(float_type));
+    request_volume(&fdtd, &fdtd.db, medium_shape, sizeof(float_type));
+  } else {
+    request_volume(&fdtd, &fdtd.material_ids, medium_shape,
+                   material_id_size(storage));
+  }
   if (cpml_thickness > 0 && fdtd.border_condition[border_front] & border_cpml) {
-    fdtd.psi_hx_z[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_hy_z[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_ex_z[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_ey_z[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_z[0], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_z[0], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ex_z[0], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ey_z[0], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_back] & border_cpml) {
-    fdtd.psi_hx_z[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_hy_z[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_ex_z[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
-    fdtd.psi_ey_z[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, sizeY, cpml_thickness));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_z[1], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_z[1], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ex_z[1], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ey_z[1], sizeX, sizeY,
+                       cpml_thickness, sizeof(psi_type));
   }
   if (cpml_thickness > 0 &&
       fdtd.border_condition[border_bottom] & border_cpml) {
-    fdtd.psi_hy_x[0] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_hz_x[0] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_ey_x[0] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_ez_x[0] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_x[0], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hz_x[0], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ey_x[0], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez_x[0], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_top] & border_cpml) {
-    fdtd.psi_hy_x[1] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_hz_x[1] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_ey_x[1] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
-    fdtd.psi_ez_x[1] =
-        calloc(1, VLA_3D_size(float_type, cpml_thickness, sizeY, sizeZ));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hy_x[1], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hz_x[1], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ey_x[1], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez_x[1], cpml_thickness, sizeY,
+                       sizeZ, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_left] & border_cpml) {
-    fdtd.psi_hx_y[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_hz_y[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_ex_y[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_ez_y[0] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_y[0], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hz_y[0], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ex_y[0], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez_y[0], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
   }
   if (cpml_thickness > 0 && fdtd.border_condition[border_right] & border_cpml) {
-    fdtd.psi_hx_y[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_hz_y[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_ex_y[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-    fdtd.psi_ez_y[1] =
-        calloc(1, VLA_3D_size(float_type, sizeX, cpml_thickness, sizeZ));
-  }
-  fdtd.bx = calloc(cpml_thickness, sizeof(*fdtd.bx));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hx_y[1], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_hz_y[1], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ex_y[1], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+    fdtd_arena_request(&fdtd.arena, &fdtd.psi_ez_y[1], sizeX, cpml_thickness,
+                       sizeZ, sizeof(psi_type));
+  }
+  void *bx, *cx;
+  fdtd_arena_request(&fdtd.arena, &bx, 1, 1, cpml_thickness, sizeof(*fdtd.bx));
+  fdtd_arena_request(&fdtd.arena, &cx, 1, 1, cpml_thickness, sizeof(*fdtd.cx));
+  fdtd_arena_map(&fdtd.arena);
+  if (layout == field3D_interleaved) {
+    for (unsigned f = 1; f < 6; ++f)
+      *fields[f] = (field_type *)fdtd.hx + f * sizeZ;
+  }
+  fdtd.bx = bx;
   fdtd.by = fdtd.bx;
   fdtd.bz = fdtd.bx;
-  fdtd.cx = calloc(cpml_thickness, sizeof(*fdtd.bx));
+  fdtd.cx = cx;
   fdtd.cy = fdtd.cx;
   fdtd.cz = fdtd.cx;
   float_type alpha_max = float_cst(2.) * M_PI * eps0 * fdtd.dx * float_cst(0.1);
@@ -884,14 +2683,365 @@ struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
         c(d, cpml_thickness - 1, fdtd.dt, alpha_max, sigma_max);
   }
 
+  if (!report)
+    return fdtd;
+#ifdef FDTD_USE_MPI
+  if (decomposition != NULL) {
+    if (decomposition->rank == 0) {
+      fprintf(stderr, "Dt %e Dx %e Dy %e Dz %e (%.0fx%.0fx%.0f)\n", dt, dx,
+              dy, dz, sizeXf, sizeYf, sizeZf);
+      fprintf(stderr, "Process grid %dx%dx%d\n", decomposition->dims[0],
+              decomposition->dims[1], decomposition->dims[2]);
+    }
+    return fdtd;
+  }
+#endif
   fprintf(stderr, "Dt %e Dx %e Dy %e Dz %e (%.0fx%.0fx%.0f)\n", dt, dx, dy, dz,
           sizeXf, sizeYf, sizeZf);
 
   return fdtd;
 }
 
-void run_3D_fdtd(struct fdtd3D *fdtd, float_type end_time, bool verbose) {
-  const double num_iter_d = ceil((end_time - fdtd->time) / fdtd->dt);
+struct fdtd3D init_fdtd_3D_cpml(float_type domain_size[3], float_type Sc,
+                                float_type smallest_wavelength,
+                                enum border_condition borders[num_borders_3D],
+                                uintmax_t cpml_thickness) {
+  return init_fdtd_3D_grid(domain_size, smallest_wavelength / float_cst(20.),
+                           Sc, borders, cpml_thickness, field_layout,
+                           medium_storage,
+                           classify_medium_tiles ? medium_tile_shape : NULL,
+                           true);
+}
+
+// Update coefficients of the same media for the time step dt_to, both the
+// loss term and dt / permittivity scaling with the step. Lossless cells keep
+// a = 1, and their b is unchanged when the step is.
+static void rescale_update_coefficients(uintmax_t cells, float_type dt_from,
+                                        float_type dt_to,
+                                        const float_type *restrict a_from,
+                                        const float_type *restrict b_from,
+                                        float_type *restrict a_to,
+                                        float_type *restrict b_to) {
+  const float_type ratio = dt_to / dt_from;
+  for (uintmax_t n = 0; n < cells; ++n) {
+    const float_type loss =
+        (float_cst(1.) - a_from[n]) / (float_cst(1.) + a_from[n]);
+    const float_type loss_to = loss * ratio;
+    a_to[n] = (float_cst(1.) - loss_to) / (float_cst(1.) + loss_to);
+    b_to[n] = b_from[n] * (float_cst(1.) + loss) * ratio /
+              (float_cst(1.) + loss_to);
+  }
+}
+
+struct fdtd3D clone_fdtd_3D(const struct fdtd3D *fdtd, float_type Sc) {
+  if (fdtd->decomposition != NULL) {
+    fprintf(stderr, "clone_fdtd_3D: a distributed grid can not be cloned\n");
+    exit(EXIT_FAILURE);
+  }
+  struct fdtd3D clone = init_fdtd_3D_grid(
+      fdtd->domain_size, fdtd->dx, Sc, fdtd->border_condition,
+      fdtd->cpml_thickness, fdtd->field_layout, fdtd->medium_storage,
+      fdtd->medium_tiles.e_uniform != NULL ? fdtd->medium_tiles.shape : NULL,
+      false);
+  // At the same time step, bitwise, nothing needs rescaling, the fields, media
+  // and CPML arrays are copied with the arena in one go
+  const bool same_step = same_coefficient(clone.dt, fdtd->dt);
+  if (same_step)
+    fdtd_arena_copy(&clone.arena, &fdtd->arena);
+  const uintmax_t cells = medium_volume_cells(fdtd);
+  if (fdtd->medium_storage == medium3D_per_cell) {
+    if (!same_step) {
+      rescale_update_coefficients(cells, fdtd->dt, clone.dt, fdtd->ca,
+                                  fdtd->cb, clone.ca, clone.cb);
+      rescale_update_coefficients(cells, fdtd->dt, clone.dt, fdtd->da,
+                                  fdtd->db, clone.da, clone.db);
+    }
+  } else {
+    // The ids are kept, only the table is rescaled
+    if (!same_step)
+      memcpy(clone.material_ids, fdtd->material_ids,
+             cells * material_id_size(fdtd->medium_storage));
+    const unsigned count = fdtd->materials.count;
+    struct fdtd3D_material_table *table = &clone.materials;
+    table->count = count;
+    table->ca = malloc(count * sizeof(*table->ca));
+    table->cb = malloc(count * sizeof(*table->cb));
+    table->da = malloc(count * sizeof(*table->da));
+    table->db = malloc(count * sizeof(*table->db));
+    if (same_step) {
+      memcpy(table->ca, fdtd->materials.ca, count * sizeof(*table->ca));
+      memcpy(table->cb, fdtd->materials.cb, count * sizeof(*table->cb));
+      memcpy(table->da, fdtd->materials.da, count * sizeof(*table->da));
+      memcpy(table->db, fdtd->materials.db, count * sizeof(*table->db));
+    } else {
+      rescale_update_coefficients(count, fdtd->dt, clone.dt,
+                                  fdtd->materials.ca, fdtd->materials.cb,
+                                  table->ca, table->cb);
+      rescale_update_coefficients(count, fdtd->dt, clone.dt,
+                                  fdtd->materials.da, fdtd->materials.db,
+                                  table->da, table->db);
+    }
+  }
+  classify_tiles(&clone);
+  clone.num_Jsources = fdtd->num_Jsources;
+  clone.Jsources = malloc(fdtd->num_Jsources * sizeof(*fdtd->Jsources));
+  memcpy(clone.Jsources, fdtd->Jsources,
+         fdtd->num_Jsources * sizeof(*fdtd->Jsources));
+  clone.JsourceLocations =
+      malloc(VLA_2D_size(uintmax_t, fdtd->num_Jsources, 3));
+  memcpy(clone.JsourceLocations, fdtd->JsourceLocations,
+         VLA_2D_size(uintmax_t, fdtd->num_Jsources, 3));
+  clone.num_Msources = fdtd->num_Msources;
+  clone.Msources = malloc(fdtd->num_Msources * sizeof(*fdtd->Msources));
+  memcpy(clone.Msources, fdtd->Msources,
+         fdtd->num_Msources * sizeof(*fdtd->Msources));
+  clone.MsourceLocations =
+      malloc(VLA_2D_size(uintmax_t, fdtd->num_Msources, 3));
+  memcpy(clone.MsourceLocations, fdtd->MsourceLocations,
+         VLA_2D_size(uintmax_t, fdtd->num_Msources, 3));
+  clone.num_JsourceRows = fdtd->num_JsourceRows;
+  clone.JsourceRows =
+      malloc(fdtd->num_JsourceRows * sizeof(*fdtd->JsourceRows));
+  memcpy(clone.JsourceRows, fdtd->JsourceRows,
+         fdtd->num_JsourceRows * sizeof(*fdtd->JsourceRows));
+  clone.num_MsourceRows = fdtd->num_MsourceRows;
+  clone.MsourceRows =
+      malloc(fdtd->num_MsourceRows * sizeof(*fdtd->MsourceRows));
+  memcpy(clone.MsourceRows, fdtd->MsourceRows,
+         fdtd->num_MsourceRows * sizeof(*fdtd->MsourceRows));
+  clone.time = fdtd->time;
+  clone.engine = fdtd->engine;
+  clone.kernel = fdtd->kernel;
+  clone.time_tile_depth = fdtd->time_tile_depth;
+  memcpy(clone.tile_shape, fdtd->tile_shape, sizeof(clone.tile_shape));
+  return clone;
+}
+
+size_t memory_footprint_3D_fdtd(float_type domain_size[3],
+                                float_type smallest_wavelength,
+                                uintmax_t cpml_thickness) {
+  float_type dx = smallest_wavelength / float_cst(20.);
+  float_type sizeXf = ceil(domain_size[0] / dx);
+  float_type sizeYf = ceil(domain_size[1] / dx);
+  float_type sizeZf = ceil(domain_size[2] / dx);
+  uintmax_t sizeX = (uintmax_t)sizeXf;
+  uintmax_t sizeY = (uintmax_t)sizeYf;
+  uintmax_t sizeZ = (uintmax_t)sizeZf;
+  // 6 fields, and the 4 coefficients unless the cells hold material ids
+  const size_t id_size = material_id_size(medium_storage);
+  // The bricked volumes are padded to whole bricks, the others as allocated
+  uintmax_t field_cells, medium_cells;
+  if (field_layout == field3D_bricked) {
+    field_cells = (sizeX + brick_edge - 1) / brick_edge *
+                  ((sizeY + brick_edge - 1) / brick_edge) *
+                  ((sizeZ + brick_edge - 1) / brick_edge) * brick_cells;
+    medium_cells = field_cells;
+    field_cells *= 6;
+  } else {
+    const unsigned fields_per_row =
+        field_layout == field3D_interleaved ? 6 : 1;
+    const struct fdtd_volume_shape field_shape = fdtd_volume_shape(
+        sizeX, sizeY, fields_per_row * sizeZ, sizeof(field_type));
+    const struct fdtd_volume_shape medium_shape = fdtd_volume_shape(
+        sizeX, sizeY, sizeZ, id_size > 0 ? id_size : sizeof(float_type));
+    field_cells =
+        6 / fields_per_row * sizeX * field_shape.rows * field_shape.pitch;
+    medium_cells = sizeX * medium_shape.rows * medium_shape.pitch;
+  }
+  uintmax_t psi_cells =
+      8 * cpml_thickness * (sizeX * sizeY + sizeY * sizeZ + sizeX * sizeZ);
+  uintmax_t coefficient_cells =
+      (id_size > 0 ? 0 : 4) * medium_cells + 2 * cpml_thickness;
+  // At most 6 fields, 4 coefficients, 24 CPML volumes and 2 CPML profiles
+  return fdtd_arena_footprint(field_cells * sizeof(field_type) +
+                                  psi_cells * sizeof(psi_type) +
+                                  coefficient_cells * sizeof(float_type) +
+                                  medium_cells * id_size,
+                              36);
+}
+
+// Bytes of the coefficients read per cell by a pass, a single material id
+// replaces them when the cells hold ids
+static size_t coefficient_bytes(enum fdtd3D_medium_storage storage,
+                                unsigned coefficients) {
+  const size_t id_size = material_id_size(storage);
+  return id_size > 0 ? id_size : coefficients * sizeof(float_type);
+}
+
+// Memory traffic of the E and H bulk updates, assuming the stencil neighbours
+// hit the caches: every array is read once per pass and the updated ones are
+// written back
+static size_t kernel_bytes_per_cell(enum fdtd3D_kernel kernel,
+                                    enum fdtd3D_medium_storage storage) {
+  switch (kernel) {
+  case kernel3D_fused: // 3 fields, 3 neighbour fields, 2 coefficients, 3 writes
+  case kernel3D_fused_cpml:
+    return 2 * (9 * sizeof(field_type) + coefficient_bytes(storage, 2));
+  default: // 3 passes of 1 field, 2 neighbour fields, 2 coefficients, 1 write
+    return 2 * 3 * (4 * sizeof(field_type) + coefficient_bytes(storage, 2));
+  }
+}
+
+// Memory traffic of the CPML corrections per slab cell: the separate passes
+// reload the two corrected fields, their neighbours and the coefficient, the
+// folded ones only stream the psi arrays
+static size_t cpml_bytes_per_cell(enum fdtd3D_kernel kernel,
+                                  enum fdtd3D_medium_storage storage) {
+  switch (kernel) {
+  case kernel3D_fused_cpml: // 2 psi read and written
+    return 2 * 4 * sizeof(psi_type);
+  default: // 2 psi, 2 fields, 2 neighbour fields, 1 coefficient, 4 writes
+    return 2 * (4 * sizeof(psi_type) + 6 * sizeof(field_type) +
+                coefficient_bytes(storage, 1));
+  }
+}
+
+static double cpml_slab_cells(const struct fdtd3D *fdtd) {
+  const double face_cells[num_borders_3D] = {
+      [border_front] = (double)(fdtd->sizeX * fdtd->sizeY),
+      [border_back] = (double)(fdtd->sizeX * fdtd->sizeY),
+      [border_top] = (double)(fdtd->sizeY * fdtd->sizeZ),
+      [border_bottom] = (double)(fdtd->sizeY * fdtd->sizeZ),
+      [border_right] = (double)(fdtd->sizeX * fdtd->sizeZ),
+      [border_left] = (double)(fdtd->sizeX * fdtd->sizeZ),
+  };
+  double cells = 0.;
+  for (unsigned border = 0; border < num_borders_3D; ++border)
+    if (fdtd->border_condition[border] & border_cpml)
+      cells += (double)fdtd->cpml_thickness * face_cells[border];
+  return cells;
+}
+
+static double step_bytes(const struct fdtd3D *fdtd,
+                         enum fdtd3D_kernel kernel) {
+  const double cells = (double)(fdtd->sizeX * fdtd->sizeY * fdtd->sizeZ);
+  const size_t bulk_bytes = kernel_bytes_per_cell(kernel, fdtd->medium_storage);
+  const size_t cpml_bytes = cpml_bytes_per_cell(kernel, fdtd->medium_storage);
+  return cells * (double)bulk_bytes +
+         cpml_slab_cells(fdtd) * (double)cpml_bytes;
+}
+
+static void print_kernel_traffic(const struct fdtd3D *fdtd, double num_steps,
+                                 double run_time) {
+  const enum fdtd3D_kernel kernel = sweep_kernel(fdtd);
+  const double bytes = step_bytes(fdtd, kernel);
+  const double per_component = step_bytes(fdtd, kernel3D_per_component);
+  // Bandwidth reported for the tile shape when the phases are cache tiled
+  char tiles[80] = "";
+  if (is_cache_tiled(fdtd)) {
+    const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+    uintmax_t shape[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+      shape[axis] = fdtd->tile_shape[axis] > 0
+                        ? min_index(fdtd->tile_shape[axis], size[axis])
+                        : size[axis];
+    snprintf(tiles, sizeof(tiles), " on %jux%jux%ju tiles", shape[0],
+             shape[1], shape[2]);
+  }
+  char media[80] = "";
+  if (fdtd->medium_storage != medium3D_per_cell)
+    snprintf(media, sizeof(media), " with %u %s materials",
+             fdtd->materials.count,
+             fdtd3D_medium_storage_name[fdtd->medium_storage]);
+  char layout[80] = "";
+  if (fdtd->field_layout != field3D_separate)
+    snprintf(layout, sizeof(layout), " on %s fields",
+             fdtd3D_field_layout_name[fdtd->field_layout]);
+  // Saving over the per-component sweeps, for the other kernels only
+  char saving[80] = "";
+  if (kernel != kernel3D_per_component)
+    snprintf(saving, sizeof(saving), " (%.0f%% less than per-component)",
+             100. * (1. - bytes / per_component));
+  printf("3D %s kernels%s%s%s: %zu bytes per cell and %zu per CPML cell and "
+         "step, %.1f MB per step%s, %.2f GB/s\n",
+         fdtd3D_kernel_name[kernel], tiles, media, layout,
+         kernel_bytes_per_cell(kernel, fdtd->medium_storage),
+         cpml_bytes_per_cell(kernel, fdtd->medium_storage), bytes * 1e-6,
+         saving, run_time > 0. ? num_steps * bytes / run_time * 1e-9 : 0.);
+}
+
+// Cells per second of the Ex row updates over the tiles of E class uniform,
+// written to a scratch row so that the fields are left untouched
+static double medium_class_rate(struct fdtd3D *fdtd, bool uniform) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hy, fdtd->hy);
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, hz, fdtd->hz);
+  const struct fdtd3D_medium_tiles *tiles = &fdtd->medium_tiles;
+  const float_type _dy = float_cst(1.) / fdtd->dy;
+  const float_type _dz = float_cst(1.) / fdtd->dz;
+  const struct fdtd_row_kernels *rows = fdtd_get_row_kernels();
+  uintmax_t cells = 0;
+  time_measure start, end;
+  get_current_time(&start);
+#pragma omp parallel reduction(+ : cells)
+  {
+    field_type scratch[tiles->shape[2]];
+    float_type ca_row[fdtd->sizeZ], cb_row[fdtd->sizeZ];
+    memset(scratch, 0, sizeof(scratch));
+#pragma omp for collapse(2)
+    for (uintmax_t i = 1; i < fdtd->sizeX; ++i) {
+      for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
+        const size_t row_tiles =
+            ((i / tiles->shape[0]) * tiles->count[1] + j / tiles->shape[1]) *
+            tiles->count[2];
+        for (uintmax_t tk = 0; tk < tiles->count[2]; ++tk) {
+          const size_t tile = row_tiles + tk;
+          if (tiles->e_uniform[tile] != uniform)
+            continue;
+          const uintmax_t k = max_index(tk * tiles->shape[2], 1);
+          const uintmax_t k_end =
+              min_index((tk + 1) * tiles->shape[2], fdtd->sizeZ);
+          if (k >= k_end)
+            continue;
+          const uintmax_t n = k_end - k;
+          if (uniform)
+            rows->curl2_uniform(n, scratch, &hz[i][j][k], &hz[i][j - 1][k],
+                                &hy[i][j][k], &hy[i][j][k - 1], _dy, _dz,
+                                tiles->ca[tile], tiles->cb[tile]);
+          else
+            rows->curl2(n, scratch, &hz[i][j][k], &hz[i][j - 1][k],
+                        &hy[i][j][k], &hy[i][j][k - 1], _dy, _dz,
+                        coefficient_row(fdtd, fdtd->ca, fdtd->materials.ca, i,
+                                        j, k, n, ca_row),
+                        coefficient_row(fdtd, fdtd->cb, fdtd->materials.cb, i,
+                                        j, k, n, cb_row));
+          cells += n;
+        }
+      }
+    }
+  }
+  get_current_time(&end);
+  const double seconds = measuring_difftime(start, end);
+  return seconds > 0. ? (double)cells / seconds : 0.;
+}
+
+// Share of the uniform medium tiles counted by the classification, and on
+// request the update rate of each class
+static void print_medium_tile_stats(struct fdtd3D *fdtd) {
+  const struct fdtd3D_medium_tiles *tiles = &fdtd->medium_tiles;
+  if (tiles->e_uniform == NULL)
+    return;
+  const size_t num_tiles = tiles->count[0] * tiles->count[1] * tiles->count[2];
+  const double all_cells = (double)(fdtd->sizeX * fdtd->sizeY * fdtd->sizeZ);
+  printf("Medium tiles of %jux%jux%ju cells: E uniform on %zu of %zu tiles "
+         "(%.1f%% of the cells), H uniform on %zu (%.1f%%)\n",
+         tiles->shape[0], tiles->shape[1], tiles->shape[2], tiles->e_tiles,
+         num_tiles, 100. * (double)tiles->e_cells / all_cells, tiles->h_tiles,
+         100. * (double)tiles->h_cells / all_cells);
+  if (!measure_medium_tile_rates)
+    return;
+  printf("Ex row updates: %.1f Mcells/s on the uniform tiles, %.1f Mcells/s "
+         "on the mixed ones\n",
+         tiles->e_tiles > 0 ? medium_class_rate(fdtd, true) * 1e-6 : 0.,
+         tiles->e_tiles < num_tiles ? medium_class_rate(fdtd, false) * 1e-6
+                                    : 0.);
+}
+
+void run_3D_fdtd(struct fdtd3D *fdtd, size_t num_steps, bool verbose) {
+  const double num_iter_d = (double)num_steps;
+  // Only reported by the progress lines
+  const float_type end_time = fdtd->time + (float_type)num_steps * fdtd->dt;
   double print_interval_d;
   if (num_iter_d >= 10.) {
     double divide = 1.;
@@ -908,35 +3058,305 @@ void run_3D_fdtd(struct fdtd3D *fdtd, float_type end_time, bool verbose) {
   size_t iter_count = 0;
   double percentage = percent_increment;
   time_measure tstart_chunk, tend_chunk;
+  const struct box3D whole = {{0, 0, 0},
+                              {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ}};
+  struct fdtd3D_halo_timings halo_timings = {
+      .overlapped = fdtd->engine == engine3D_split_phase};
+  time_measure tstart_run, tend_run;
+  get_current_time(&tstart_run);
   get_current_time(&tstart_chunk);
-  for (; fdtd->time < end_time; fdtd->time += fdtd->dt) {
-    update_magnetic_field(fdtd);
-    apply_M_sources(fdtd);
-    update_magnetic_cpml(fdtd);
-    border_condition_magnetic(fdtd);
+  switch (fdtd->engine) {
+  case engine3D_fork_join:
+    for (size_t step = 0; step < num_steps; ++step, fdtd->time += fdtd->dt) {
+      if (is_cache_tiled(fdtd)) {
+        // One team per field, every tile running all of its kernels
+#pragma omp parallel
+        magnetic_phase(fdtd, &whole, whole_team());
+      } else {
+#pragma omp parallel
+        update_magnetic_field(fdtd, &whole, whole_team());
+        apply_M_sources(fdtd, &whole);
+#pragma omp parallel
+        update_magnetic_cpml(fdtd, &whole, whole_team());
+        border_condition_magnetic(fdtd, &whole, lone_thread);
+      }
+      exchange_halos_timed(fdtd, halo_magnetic, &halo_timings);
+
+      if (is_cache_tiled(fdtd)) {
+#pragma omp parallel
+        electric_phase(fdtd, &whole, whole_team());
+      } else {
+#pragma omp parallel
+        update_electric_field(fdtd, &whole, whole_team());
+        apply_J_sources(fdtd, &whole);
+#pragma omp parallel
+        update_electric_cpml(fdtd, &whole, whole_team());
+        border_condition_electric(fdtd, &whole, lone_thread);
+      }
+      exchange_halos_timed(fdtd, halo_electric, &halo_timings);
+      halo_timings.num_steps++;
+
+      iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+      if (verbose && iter_count == 0) {
+        get_current_time(&tend_chunk);
+        double difference = measuring_difftime(tstart_chunk, tend_chunk);
+        printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+               percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+               difference);
+        percentage += percent_increment;
+        tstart_chunk = tend_chunk;
+      }
+    }
+    break;
+  case engine3D_persistent_team:
+    // The team lives for the whole time loop, each thread counts the steps
+    // privately and only the master thread advances fdtd->time. The barrier
+    // after the advance orders it before the next read of fdtd->time by the
+    // sources, which the cache tiles of any thread may apply as soon as the
+    // next step starts.
+#pragma omp parallel
+    for (size_t step = 0; step < num_steps; ++step) {
+      magnetic_phase(fdtd, &whole, whole_team());
+      if (fdtd->decomposition != NULL) {
+#pragma omp master
+        exchange_halos_timed(fdtd, halo_magnetic, &halo_timings);
+#pragma omp barrier
+      }
+
+      electric_phase(fdtd, &whole, whole_team());
+      if (fdtd->decomposition != NULL) {
+#pragma omp master
+        exchange_halos_timed(fdtd, halo_electric, &halo_timings);
+#pragma omp barrier
+      }
 
-    update_electric_field(fdtd);
-    apply_J_sources(fdtd);
-    update_electric_cpml(fdtd);
-    border_condition_electric(fdtd);
+#pragma omp master
+      {
+        halo_timings.num_steps++;
+        iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+        if (verbose && iter_count == 0) {
+          get_current_time(&tend_chunk);
+          double difference = measuring_difftime(tstart_chunk, tend_chunk);
+          printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+                 percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+                 difference);
+          percentage += percent_increment;
+          tstart_chunk = tend_chunk;
+        }
+        fdtd->time += fdtd->dt;
+      }
+#pragma omp barrier
+    }
+    break;
+  case engine3D_split_phase: {
+    struct box3D boundary[6], interior;
+    const unsigned num_boundary =
+        split_boundary_boxes(fdtd, boundary, &interior);
+    struct split_phase_timers timers = {.first_step = true};
+#pragma omp parallel
+    for (size_t step = 0; step < num_steps; ++step) {
+      split_phase_update(fdtd, halo_magnetic, boundary, num_boundary,
+                         &interior, &timers);
+      split_phase_update(fdtd, halo_electric, boundary, num_boundary,
+                         &interior, &timers);
+
+#pragma omp master
+      {
+        if (!timers.first_step) {
+          halo_timings.boundary += timers.boundary;
+          halo_timings.interior += timers.interior;
+          halo_timings.wait += timers.wait;
+          halo_timings.num_steps++;
+        } else {
+          halo_timings.reference = timers.reference;
+        }
+        timers.first_step = false;
+        timers.boundary = timers.interior = timers.wait = 0.;
+        iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+        if (verbose && iter_count == 0) {
+          get_current_time(&tend_chunk);
+          double difference = measuring_difftime(tstart_chunk, tend_chunk);
+          printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+                 percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+                 difference);
+          percentage += percent_increment;
+          tstart_chunk = tend_chunk;
+        }
+        fdtd->time += fdtd->dt;
+      }
+      // Time advance ordered before the sources of the next step
+#pragma omp barrier
+    }
+  } break;
+  case engine3D_work_stealing: {
+    struct box3D *tiles;
+    const size_t num_tiles = work_stealing_tiles(fdtd, &tiles);
+#ifdef _OPENMP
+    const unsigned max_threads = (unsigned)omp_get_max_threads();
+#else
+    const unsigned max_threads = 1;
+#endif
+    struct fdtd_tile_pool *pool = fdtd_tile_pool_alloc(max_threads, num_tiles);
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+      const unsigned thread = (unsigned)omp_get_thread_num();
+      const unsigned num_threads = (unsigned)omp_get_num_threads();
+#else
+      const unsigned thread = 0, num_threads = 1;
+#endif
+      for (size_t step = 0; step < num_steps; ++step) {
+        work_stealing_phase(fdtd, magnetic_phase, tiles, pool, thread,
+                            num_threads);
+        if (fdtd->decomposition != NULL) {
+#pragma omp master
+          exchange_halos_timed(fdtd, halo_magnetic, &halo_timings);
+#pragma omp barrier
+        }
+
+        work_stealing_phase(fdtd, electric_phase, tiles, pool, thread,
+                            num_threads);
+        if (fdtd->decomposition != NULL) {
+#pragma omp master
+          exchange_halos_timed(fdtd, halo_electric, &halo_timings);
+#pragma omp barrier
+        }
+
+#pragma omp master
+        {
+          halo_timings.num_steps++;
+          iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+          if (verbose && iter_count == 0) {
+            get_current_time(&tend_chunk);
+            double difference = measuring_difftime(tstart_chunk, tend_chunk);
+            printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+                   percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+                   difference);
+            percentage += percent_increment;
+            tstart_chunk = tend_chunk;
+          }
+          fdtd->time += fdtd->dt;
+        }
+      }
+    }
+    if (verbose) {
+      printf("Work stealing over %zu tiles of %ux%ux%ju cells\n", num_tiles,
+             work_stealing_tile_size, work_stealing_tile_size, fdtd->sizeZ);
+      fdtd_tile_pool_print_stats(pool, stdout);
+    }
+    fdtd_tile_pool_free(pool);
+    free(tiles);
+  } break;
+  case engine3D_temporal_blocking: {
+    if (fdtd->decomposition != NULL) {
+      fprintf(stderr, "run_3D_fdtd: the temporal blocking engine needs the "
+                      "whole grid in a single process\n");
+      exit(EXIT_FAILURE);
+    }
+    const unsigned depth = fdtd->time_tile_depth;
+    // Enough tiles for the last ones to still cover the grid end once moved
+    // back by depth - 1 cells
+    const uintmax_t num_tiles[2] = {
+        (fdtd->sizeX + depth - 1 + temporal_tile_size - 1) /
+            temporal_tile_size,
+        (fdtd->sizeY + depth - 1 + temporal_tile_size - 1) /
+            temporal_tile_size};
+    float_type *step_times = malloc(depth * sizeof(*step_times));
+    for (size_t first_step = 0; first_step < num_steps;) {
+      // Same accumulated times as the step by step loop
+      unsigned block_steps = 0;
+      for (float_type time = fdtd->time;
+           block_steps < depth && first_step + block_steps < num_steps;
+           time += fdtd->dt)
+        step_times[block_steps++] = time;
+#pragma omp parallel
+      temporal_blocking_steps(fdtd, num_tiles, step_times, block_steps);
 
-    iter_count = iter_count == inter_print ? 0 : iter_count + 1;
-    if (verbose && iter_count == 0) {
-      get_current_time(&tend_chunk);
-      double difference = measuring_difftime(tstart_chunk, tend_chunk);
-      printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n", percentage,
-             fdtd->time, fdtd->dt, end_time, print_interval, difference);
-      percentage += percent_increment;
-      tstart_chunk = tend_chunk;
+      first_step += block_steps;
+      for (unsigned step = 0; step < block_steps; ++step) {
+        fdtd->time = step_times[step];
+        halo_timings.num_steps++;
+        iter_count = iter_count == inter_print ? 0 : iter_count + 1;
+        if (verbose && iter_count == 0) {
+          get_current_time(&tend_chunk);
+          double difference = measuring_difftime(tstart_chunk, tend_chunk);
+          printf("%.0f%% -- t=%e dt=%e tend=%e (%zu iter in %.3fs)\n",
+                 percentage, fdtd->time, fdtd->dt, end_time, print_interval,
+                 difference);
+          percentage += percent_increment;
+          tstart_chunk = tend_chunk;
+        }
+      }
+      fdtd->time += fdtd->dt;
     }
+    if (verbose)
+      printf("Temporal blocking over %ju tiles of %ux%ux%ju cells, %u steps "
+             "per tile\n",
+             num_tiles[0] * num_tiles[1], temporal_tile_size,
+             temporal_tile_size, fdtd->sizeZ, depth);
+    free(step_times);
+  } break;
+  default:
+    fprintf(stderr, "run_3D_fdtd: unknown engine\n");
+    exit(EXIT_FAILURE);
+  }
+  get_current_time(&tend_run);
+  if (verbose) {
+    print_kernel_traffic(fdtd, num_iter_d,
+                         measuring_difftime(tstart_run, tend_run));
+    print_medium_tile_stats(fdtd);
   }
+  fdtd3D_print_halo_timings(fdtd, &halo_timings, stdout);
 }
 
+const char *fdtd3D_engine_name[num_engines3D] = {
+    [engine3D_fork_join] = "fork-join",
+    [engine3D_persistent_team] = "persistent",
+    [engine3D_split_phase] = "split-phase",
+    [engine3D_work_stealing] = "work-stealing",
+    [engine3D_temporal_blocking] = "temporal-blocking",
+};
+
+const char *fdtd3D_kernel_name[num_kernels3D] = {
+    [kernel3D_per_component] = "per-component",
+    [kernel3D_fused] = "fused",
+    [kernel3D_fused_cpml] = "fused-cpml",
+};
+
+const char *fdtd3D_field_layout_name[num_field_layouts3D] = {
+    [field3D_separate] = "separate",
+    [field3D_interleaved] = "interleaved",
+    [field3D_bricked] = "bricked",
+};
+
+const char *fdtd3D_medium_storage_name[num_medium_storages3D] = {
+    [medium3D_per_cell] = "per-cell",
+    [medium3D_uint8_ids] = "uint8",
+    [medium3D_uint16_ids] = "uint16",
+};
+
 void dump_3D_fdtd(const struct fdtd3D *fdtd, const char *fileName,
                   enum dumpable_data what_to_dump) {
+#ifdef FDTD_USE_MPI
+  // Each process writes its own cells to <fileName>.<rank>
+  char *rankFileName = NULL;
+  if (fdtd->decomposition != NULL) {
+    size_t nameLength = strlen(fileName) + 16;
+    rankFileName = malloc(nameLength);
+    snprintf(rankFileName, nameLength, "%s.%d", fileName,
+             fdtd->decomposition->rank);
+    fileName = rankFileName;
+  }
+#endif
   FILE *out = fopen(fileName, "w");
-  VLA_3D_definition(float_type, fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ, data,
-                    fdtd->ez);
+#ifdef FDTD_USE_MPI
+  free(rankFileName);
+#endif
+  field_type *restrict data = fdtd->ex;
+  // Coefficients dumped instead of a field, the table being looked up per
+  // cell when the medium is stored as ids
+  bool coefficients = false;
+  const float_type *cells = NULL, *table = NULL;
   switch (what_to_dump) {
   case dump_ex:
     break;
@@ -956,75 +3376,172 @@ void dump_3D_fdtd(const struct fdtd3D *fdtd, const char *fileName,
     data = fdtd->hz;
     break;
   case dump_permeability:
-    data = fdtd->permeability_inv;
+    coefficients = true;
+    cells = fdtd->db;
+    table = fdtd->materials.db;
     break;
   case dump_permittivity:
-    data = fdtd->permittivity_inv;
+    coefficients = true;
+    cells = fdtd->cb;
+    table = fdtd->materials.cb;
     break;
   default:
     fprintf(stderr, "Dump of \"%s\" not available for 2D fdtd\n",
             dumpable_data_name[what_to_dump]);
     exit(EXIT_FAILURE);
   }
-  for (uintmax_t i = 0; i < fdtd->sizeX; ++i) {
-    for (uintmax_t j = 1; j < fdtd->sizeY; ++j) {
-      for (uintmax_t k = 1; k < fdtd->sizeZ; ++k) {
-        fprintf(out, "%e %e %e %e\n", (float_type)i * fdtd->dx,
-                (float_type)j * fdtd->dy, (float_type)k * fdtd->dt,
-                data[i][j][k]);
+  fdtd_dump_header(out, what_to_dump);
+  // Halo cells are owned by the neighbours, the first y and z planes of the
+  // whole domain are skipped
+  const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  uintmax_t begin[3], end[3];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    begin[axis] = fdtd3D_has_neighbour(fdtd->decomposition, axis, 0) ? 1 : 0;
+    end[axis] = size[axis] -
+                (fdtd3D_has_neighbour(fdtd->decomposition, axis, 1) ? 1 : 0);
+    if (axis > 0 && fdtd->offset[axis] + begin[axis] == 0)
+      begin[axis] = 1;
+  }
+  for (uintmax_t i = begin[0]; i < end[0]; ++i) {
+    for (uintmax_t j = begin[1]; j < end[1]; ++j) {
+      for (uintmax_t k = begin[2]; k < end[2]; ++k) {
+        fprintf(out, "%e %e %e %e\n",
+                (float_type)(i + fdtd->offset[0]) * fdtd->dx,
+                (float_type)(j + fdtd->offset[1]) * fdtd->dy,
+                (float_type)(k + fdtd->offset[2]) * fdtd->dt,
+                coefficients ? coefficient_at(fdtd, cells, table, i, j, k)
+                             : (float_type)data[field_offset(fdtd, i, j, k)]);
       }
     }
   }
   fclose(out);
 }
 
+// Cells of the field widened to double, in the separate layout order
+static double *widen_field_3D(const struct fdtd3D *fdtd, void *field) {
+  field_type *restrict data = field;
+  double *widened =
+      malloc(fdtd->sizeX * fdtd->sizeY * fdtd->sizeZ * sizeof(*widened));
+  double *cell = widened;
+  for (uintmax_t i = 0; i < fdtd->sizeX; ++i)
+    for (uintmax_t j = 0; j < fdtd->sizeY; ++j)
+      for (uintmax_t k = 0; k < fdtd->sizeZ; ++k)
+        *cell++ = (double)data[field_offset(fdtd, i, j, k)];
+  return widened;
+}
+
+void snapshot_3D_fdtd(const struct fdtd3D *fdtd,
+                      struct fdtd_field_snapshot *snapshot) {
+  *snapshot = (struct fdtd_field_snapshot){
+      .num_components = 6,
+      .name = {"hx", "hy", "hz", "ex", "ey", "ez"},
+      .cells = fdtd->sizeX * fdtd->sizeY * fdtd->sizeZ,
+      .component = {widen_field_3D(fdtd, fdtd->hx),
+                    widen_field_3D(fdtd, fdtd->hy),
+                    widen_field_3D(fdtd, fdtd->hz),
+                    widen_field_3D(fdtd, fdtd->ex),
+                    widen_field_3D(fdtd, fdtd->ey),
+                    widen_field_3D(fdtd, fdtd->ez)},
+  };
+}
+
 void free_3D_fdtd(struct fdtd3D *fdtd) {
-  free(fdtd->ex);
-  free(fdtd->ey);
-  free(fdtd->ez);
-  free(fdtd->hx);
-  free(fdtd->hy);
-  free(fdtd->hz);
-  free(fdtd->permittivity_inv);
-  free(fdtd->permeability_inv);
+  fdtd3D_decomposition_free(fdtd->decomposition);
+  fdtd_arena_free(&fdtd->arena);
+  free(fdtd->materials.ca);
+  free(fdtd->materials.cb);
+  free(fdtd->materials.da);
+  free(fdtd->materials.db);
+  free(fdtd->medium_tiles.e_uniform);
+  free(fdtd->medium_tiles.h_uniform);
+  free(fdtd->medium_tiles.ca);
+  free(fdtd->medium_tiles.cb);
+  free(fdtd->medium_tiles.da);
+  free(fdtd->medium_tiles.db);
   free(fdtd->JsourceLocations);
   free(fdtd->Jsources);
   free(fdtd->MsourceLocations);
   free(fdtd->Msources);
-  free(fdtd->psi_hx_z[0]);
-  free(fdtd->psi_hx_z[1]);
-  free(fdtd->psi_hx_y[0]);
-  free(fdtd->psi_hx_y[1]);
-  free(fdtd->psi_hy_z[0]);
-  free(fdtd->psi_hy_z[1]);
-  free(fdtd->psi_hy_x[0]);
-  free(fdtd->psi_hy_x[1]);
-  free(fdtd->psi_hz_x[0]);
-  free(fdtd->psi_hz_x[1]);
-  free(fdtd->psi_hz_y[0]);
-  free(fdtd->psi_hz_y[1]);
-  free(fdtd->psi_ex_z[0]);
-  free(fdtd->psi_ex_z[1]);
-  free(fdtd->psi_ex_y[0]);
-  free(fdtd->psi_ex_y[1]);
-  free(fdtd->psi_ey_z[0]);
-  free(fdtd->psi_ey_z[1]);
-  free(fdtd->psi_ey_x[0]);
-  free(fdtd->psi_ey_x[1]);
-  free(fdtd->psi_ez_x[0]);
-  free(fdtd->psi_ez_x[1]);
-  free(fdtd->psi_ez_y[0]);
-  free(fdtd->psi_ez_y[1]);
-  free(fdtd->bx);
-  free(fdtd->cx);
+  free(fdtd->JsourceRows);
+  free(fdtd->MsourceRows);
+}
+
+void print_memory_placement_3D(const struct fdtd3D *fdtd, FILE *out) {
+  const uintmax_t cells = medium_volume_cells(fdtd);
+  const size_t volume = field_volume_cells(fdtd) * sizeof(field_type);
+  const size_t coefficient_volume = cells * sizeof(float_type);
+  const size_t slab_x =
+      VLA_3D_size(psi_type, fdtd->cpml_thickness, fdtd->sizeY, fdtd->sizeZ);
+  const size_t slab_y =
+      VLA_3D_size(psi_type, fdtd->sizeX, fdtd->cpml_thickness, fdtd->sizeZ);
+  const size_t slab_z =
+      VLA_3D_size(psi_type, fdtd->sizeX, fdtd->sizeY, fdtd->cpml_thickness);
+  struct fdtd_memory_usage usage = fdtd_memory_usage_init();
+  if (fdtd->field_layout == field3D_interleaved) {
+    fdtd_memory_usage_add(&usage, fdtd->hx, volume);
+  } else {
+    fdtd_memory_usage_add(&usage, fdtd->hx, volume);
+    fdtd_memory_usage_add(&usage, fdtd->hy, volume);
+    fdtd_memory_usage_add(&usage, fdtd->hz, volume);
+    fdtd_memory_usage_add(&usage, fdtd->ex, volume);
+    fdtd_memory_usage_add(&usage, fdtd->ey, volume);
+    fdtd_memory_usage_add(&usage, fdtd->ez, volume);
+  }
+  fdtd_memory_usage_add(&usage, fdtd->ca, coefficient_volume);
+  fdtd_memory_usage_add(&usage, fdtd->cb, coefficient_volume);
+  fdtd_memory_usage_add(&usage, fdtd->da, coefficient_volume);
+  fdtd_memory_usage_add(&usage, fdtd->db, coefficient_volume);
+  fdtd_memory_usage_add(&usage, fdtd->material_ids,
+                        cells * material_id_size(fdtd->medium_storage));
+  for (unsigned side = 0; side < 2; ++side) {
+    fdtd_memory_usage_add(&usage, fdtd->psi_hy_x[side], slab_x);
+    fdtd_memory_usage_add(&usage, fdtd->psi_hz_x[side], slab_x);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ey_x[side], slab_x);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ez_x[side], slab_x);
+    fdtd_memory_usage_add(&usage, fdtd->psi_hx_y[side], slab_y);
+    fdtd_memory_usage_add(&usage, fdtd->psi_hz_y[side], slab_y);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ex_y[side], slab_y);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ez_y[side], slab_y);
+    fdtd_memory_usage_add(&usage, fdtd->psi_hx_z[side], slab_z);
+    fdtd_memory_usage_add(&usage, fdtd->psi_hy_z[side], slab_z);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ex_z[side], slab_z);
+    fdtd_memory_usage_add(&usage, fdtd->psi_ey_z[side], slab_z);
+  }
+  fdtd_memory_usage_print(out, &usage);
+  fdtd_memory_usage_free(&usage);
+}
+
+// Adds the row to the sorted set of rows holding sources
+static void insert_source_row(uintmax_t **rows, unsigned *num_rows,
+                              uintmax_t row) {
+  unsigned pos = 0;
+  while (pos < *num_rows && (*rows)[pos] < row)
+    pos++;
+  if (pos < *num_rows && (*rows)[pos] == row)
+    return;
+  *rows = realloc(*rows, (*num_rows + 1) * sizeof(**rows));
+  memmove(*rows + pos + 1, *rows + pos, (*num_rows - pos) * sizeof(**rows));
+  (*rows)[pos] = row;
+  (*num_rows)++;
 }
 
 void add_source_fdtd_3D(enum source_type sType, struct fdtd3D *fdtd,
                         struct fdtd_source src, float_type positionX,
                         float_type positionY, float_type positionZ) {
-  float_type posX = ceil(positionX / fdtd->dx);
-  float_type posY = ceil(positionY / fdtd->dy);
-  float_type posZ = ceil(positionZ / fdtd->dz);
+  float_type posX = ceil(positionX / fdtd->dx - float_cst(1e-3));
+  float_type posY = ceil(positionY / fdtd->dy - float_cst(1e-3));
+  float_type posZ = ceil(positionZ / fdtd->dz - float_cst(1e-3));
+  // Sources outside of the local block belong to another process
+  const uintmax_t globalPos[3] = {(uintmax_t)posX, (uintmax_t)posY,
+                                  (uintmax_t)posZ};
+  uintmax_t localPos[3];
+  const uintmax_t localSize[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    if (globalPos[axis] < fdtd->offset[axis] ||
+        globalPos[axis] - fdtd->offset[axis] >= localSize[axis])
+      return;
+    localPos[axis] = globalPos[axis] - fdtd->offset[axis];
+  }
   switch (sType) {
   case source_electric: {
     fdtd->num_Jsources++;
@@ -1032,12 +3549,14 @@ void add_source_fdtd_3D(enum source_type sType, struct fdtd3D *fdtd,
         fdtd->JsourceLocations, VLA_2D_size(uintmax_t, fdtd->num_Jsources, 3));
     VLA_2D_definition(uintmax_t, fdtd->num_Jsources, 3, JsourceLocations,
                       fdtd->JsourceLocations);
-    JsourceLocations[fdtd->num_Jsources - 1][0] = (uintmax_t)posX;
-    JsourceLocations[fdtd->num_Jsources - 1][1] = (uintmax_t)posY;
-    JsourceLocations[fdtd->num_Jsources - 1][2] = (uintmax_t)posZ;
+    JsourceLocations[fdtd->num_Jsources - 1][0] = localPos[0];
+    JsourceLocations[fdtd->num_Jsources - 1][1] = localPos[1];
+    JsourceLocations[fdtd->num_Jsources - 1][2] = localPos[2];
     fdtd->Jsources =
         realloc(fdtd->Jsources, fdtd->num_Jsources * sizeof(*fdtd->Jsources));
     fdtd->Jsources[fdtd->num_Jsources - 1] = src;
+    insert_source_row(&fdtd->JsourceRows, &fdtd->num_JsourceRows,
+                      localPos[0] * fdtd->sizeY + localPos[1]);
     break;
   }
   case source_magnetic:
@@ -1046,12 +3565,14 @@ void add_source_fdtd_3D(enum source_type sType, struct fdtd3D *fdtd,
         fdtd->MsourceLocations, VLA_2D_size(uintmax_t, fdtd->num_Msources, 3));
     VLA_2D_definition(uintmax_t, fdtd->num_Msources, 3, MsourceLocations,
                       fdtd->MsourceLocations);
-    MsourceLocations[fdtd->num_Msources - 1][0] = (uintmax_t)posX;
-    MsourceLocations[fdtd->num_Msources - 1][1] = (uintmax_t)posY;
-    MsourceLocations[fdtd->num_Msources - 1][2] = (uintmax_t)posZ;
+    MsourceLocations[fdtd->num_Msources - 1][0] = localPos[0];
+    MsourceLocations[fdtd->num_Msources - 1][1] = localPos[1];
+    MsourceLocations[fdtd->num_Msources - 1][2] = localPos[2];
     fdtd->Msources =
         realloc(fdtd->Msources, fdtd->num_Msources * sizeof(*fdtd->Msources));
     fdtd->Msources[fdtd->num_Msources - 1] = src;
+    insert_source_row(&fdtd->MsourceRows, &fdtd->num_MsourceRows,
+                      localPos[0] * fdtd->sizeY + localPos[1]);
     break;
   }
 }
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd3D_mpi.h"
+#include "fdtd_memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int requested_grid[3] = {0, 0, 0};
+static bool decomposition_enabled = true;
+
+void fdtd3D_set_process_grid(const int dims[3]) {
+  for (unsigned axis = 0; axis < 3; ++axis)
+    requested_grid[axis] = dims[axis];
+}
+
+void fdtd3D_enable_decomposition(bool enabled) {
+  decomposition_enabled = enabled;
+}
+
+struct fdtd3D_decomposition *
+fdtd3D_decompose(const uintmax_t global_size[3], uintmax_t offset[3],
+                 uintmax_t local_size[3], unsigned fields_per_row) {
+  int num_procs = 1;
+  if (decomposition_enabled)
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+  if (num_procs == 1) {
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      offset[axis] = 0;
+      local_size[axis] = global_size[axis];
+    }
+    return NULL;
+  }
+
+  struct fdtd3D_decomposition *dec = malloc(sizeof(*dec));
+  int dims[3] = {requested_grid[0], requested_grid[1], requested_grid[2]};
+  if (MPI_Dims_create(num_procs, 3, dims) != MPI_SUCCESS) {
+    fprintf(stderr, "The process grid %dx%dx%d does not match the %d MPI "
+                    "processes\n",
+            requested_grid[0], requested_grid[1], requested_grid[2],
+            num_procs);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  int periods[3] = {0, 0, 0};
+  MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 0, &dec->comm);
+  MPI_Comm_rank(dec->comm, &dec->rank);
+  MPI_Cart_coords(dec->comm, dec->rank, 3, dec->coords);
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    dec->dims[axis] = dims[axis];
+    MPI_Cart_shift(dec->comm, (int)axis, 1, &dec->neighbour[axis][0],
+                   &dec->neighbour[axis][1]);
+    // Balanced block distribution of the cells along the axis
+    uintmax_t num_blocks = (uintmax_t)dims[axis];
+    uintmax_t coord = (uintmax_t)dec->coords[axis];
+    uintmax_t base = global_size[axis] / num_blocks;
+    uintmax_t remainder = global_size[axis] % num_blocks;
+    dec->owned_begin[axis] =
+        coord * base + (coord < remainder ? coord : remainder);
+    dec->owned_end[axis] =
+        dec->owned_begin[axis] + base + (coord < remainder ? 1 : 0);
+    if (dec->owned_end[axis] - dec->owned_begin[axis] < 2) {
+      fprintf(stderr, "Too many processes (%d) along axis %u for %ju cells\n",
+              dims[axis], axis, global_size[axis]);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    uintmax_t lower_halo = fdtd3D_has_neighbour(dec, axis, 0) ? 1 : 0;
+    uintmax_t upper_halo = fdtd3D_has_neighbour(dec, axis, 1) ? 1 : 0;
+    offset[axis] = dec->owned_begin[axis] - lower_halo;
+    local_size[axis] =
+        dec->owned_end[axis] - dec->owned_begin[axis] + lower_halo + upper_halo;
+  }
+
+  // A plane normal to an axis covers the owned cells of the two other axes,
+  // the edges of the halo are never read by the Yee stencil
+  int sizes[3], owned_size[3], owned_start[3];
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    sizes[axis] = (int)local_size[axis];
+    owned_size[axis] = (int)(dec->owned_end[axis] - dec->owned_begin[axis]);
+    owned_start[axis] = (int)(dec->owned_begin[axis] - offset[axis]);
+  }
+  // Over the padded rows of the field volumes
+  const struct fdtd_volume_shape shape =
+      fdtd_volume_shape(local_size[0], local_size[1],
+                        fields_per_row * local_size[2], sizeof(field_type));
+  sizes[1] = (int)shape.rows;
+  sizes[2] = (int)shape.pitch;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    int subsizes[3] = {owned_size[0], owned_size[1], owned_size[2]};
+    int starts[3] = {owned_start[0], owned_start[1], owned_start[2]};
+    subsizes[axis] = 1;
+    starts[axis] = 0;
+    MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C,
+                             MPI_FIELD_TYPE, &dec->plane[axis]);
+    MPI_Type_commit(&dec->plane[axis]);
+  }
+  dec->num_requests = 0;
+  return dec;
+}
+
+bool fdtd3D_has_neighbour(const struct fdtd3D_decomposition *dec,
+                          unsigned axis, unsigned side) {
+  return dec != NULL && dec->neighbour[axis][side] != MPI_PROC_NULL;
+}
+
+static field_type *plane_address(const struct fdtd3D *fdtd, void *field,
+                                 unsigned axis, uintmax_t index) {
+  VLA_3D_definition(field_type, fdtd->sizeX, fdtd->field_rows,
+                    fdtd->field_pitch, data, field);
+  switch (axis) {
+  case 0:
+    return &data[index][0][0];
+  case 1:
+    return &data[0][index][0];
+  default:
+    return &data[0][0][index];
+  }
+}
+
+void fdtd3D_start_halo_exchange(struct fdtd3D *fdtd, enum fdtd3D_halo which) {
+  struct fdtd3D_decomposition *dec = fdtd->decomposition;
+  if (dec == NULL)
+    return;
+  void *fields[3];
+  if (which == halo_magnetic) {
+    fields[0] = fdtd->hx;
+    fields[1] = fdtd->hy;
+    fields[2] = fdtd->hz;
+  } else {
+    fields[0] = fdtd->ex;
+    fields[1] = fdtd->ey;
+    fields[2] = fdtd->ez;
+  }
+  const uintmax_t size[3] = {fdtd->sizeX, fdtd->sizeY, fdtd->sizeZ};
+  dec->num_requests = 0;
+  for (unsigned axis = 0; axis < 3; ++axis) {
+    for (unsigned side = 0; side < 2; ++side) {
+      if (!fdtd3D_has_neighbour(dec, axis, side))
+        continue;
+      // The lower halo is filled from the last owned plane of the lower
+      // neighbour and the upper halo from the first owned plane of the upper
+      uintmax_t halo = side == 0 ? 0 : size[axis] - 1;
+      uintmax_t owned = side == 0 ? 1 : size[axis] - 2;
+      int neighbour = dec->neighbour[axis][side];
+      for (unsigned f = 0; f < 3; ++f) {
+        int recv_tag = (int)(6 * f + 2 * axis + side);
+        int send_tag = (int)(6 * f + 2 * axis + 1 - side);
+        MPI_Irecv(plane_address(fdtd, fields[f], axis, halo), 1,
+                  dec->plane[axis], neighbour, recv_tag, dec->comm,
+                  &dec->requests[dec->num_requests++]);
+        MPI_Isend(plane_address(fdtd, fields[f], axis, owned), 1,
+                  dec->plane[axis], neighbour, send_tag, dec->comm,
+                  &dec->requests[dec->num_requests++]);
+      }
+    }
+  }
+}
+
+void fdtd3D_finish_halo_exchange(struct fdtd3D *fdtd) {
+  struct fdtd3D_decomposition *dec = fdtd->decomposition;
+  if (dec == NULL)
+    return;
+  MPI_Waitall(dec->num_requests, dec->requests, MPI_STATUSES_IGNORE);
+  dec->num_requests = 0;
+}
+
+void fdtd3D_exchange_halos(struct fdtd3D *fdtd, enum fdtd3D_halo which) {
+  fdtd3D_start_halo_exchange(fdtd, which);
+  fdtd3D_finish_halo_exchange(fdtd);
+}
+
+void fdtd3D_print_halo_timings(const struct fdtd3D *fdtd,
+                               const struct fdtd3D_halo_timings *timings,
+                               FILE *out) {
+  const struct fdtd3D_decomposition *dec = fdtd->decomposition;
+  if (dec == NULL)
+    return;
+  double local[4] = {timings->boundary, timings->interior, timings->wait,
+                     timings->reference};
+  double slowest[4];
+  MPI_Reduce(local, slowest, 4, MPI_DOUBLE, MPI_MAX, 0, dec->comm);
+  if (dec->rank != 0)
+    return;
+  const double to_us =
+      timings->num_steps > 0 ? 1e6 / (double)timings->num_steps : 0.;
+  if (!timings->overlapped) {
+    fprintf(out, "Halo exchange: %.1f us per step, not overlapped\n",
+            slowest[2] * to_us);
+    return;
+  }
+  fprintf(out,
+          "Halo exchange per step: boundary update %.1f us, interior update "
+          "%.1f us, exposed wait %.1f us\n",
+          slowest[0] * to_us, slowest[1] * to_us, slowest[2] * to_us);
+  if (slowest[3] > 0. && timings->num_steps > 0) {
+    double exposed = slowest[2] * to_us;
+    double reference = slowest[3] * 1e6;
+    double hidden = exposed < reference ? reference - exposed : 0.;
+    fprintf(out,
+            "Non overlapped exchange %.1f us, %.1f us (%.0f%%) hidden behind "
+            "the interior update\n",
+            reference, hidden, 100. * hidden / reference);
+  }
+}
+
+void fdtd3D_decomposition_free(struct fdtd3D_decomposition *dec) {
+  if (dec == NULL)
+    return;
+  for (unsigned axis = 0; axis < 3; ++axis)
+    MPI_Type_free(&dec->plane[axis]);
+  MPI_Comm_free(&dec->comm);
+  free(dec);
+}
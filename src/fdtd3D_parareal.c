@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd3D_parareal.h"
+#include "time_measurement.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tgmath.h>
+
+#define max_state_arrays 30
+
+// Fields and CPML unknowns advanced by the time loop, returns their count.
+// The first num_fields arrays hold the fields, the others the CPML unknowns.
+static unsigned state_arrays(const struct fdtd3D *fdtd,
+                             void *arrays[max_state_arrays],
+                             size_t lengths[max_state_arrays],
+                             unsigned *num_fields) {
+  // The padded volumes, the bricked ones being padded to whole bricks. The
+  // interleaved rows are a single volume starting with hx.
+  const size_t volume =
+      fdtd->field_layout == field3D_bricked
+          ? fdtd->bricks[0] * fdtd->bricks[1] * fdtd->bricks[2] *
+                fdtd3D_brick_edge * fdtd3D_brick_edge * fdtd3D_brick_edge
+          : fdtd->sizeX * fdtd->field_rows * fdtd->field_pitch;
+  const bool interleaved = fdtd->field_layout == field3D_interleaved;
+  *num_fields = interleaved ? 1 : 6;
+  const size_t slab_x = fdtd->cpml_thickness * fdtd->sizeY * fdtd->sizeZ;
+  const size_t slab_y = fdtd->sizeX * fdtd->cpml_thickness * fdtd->sizeZ;
+  const size_t slab_z = fdtd->sizeX * fdtd->sizeY * fdtd->cpml_thickness;
+  const struct {
+    void *ptr;
+    size_t length;
+  } candidates[max_state_arrays] = {
+      {fdtd->hx, volume},
+      {interleaved ? NULL : fdtd->hy, volume},
+      {interleaved ? NULL : fdtd->hz, volume},
+      {interleaved ? NULL : fdtd->ex, volume},
+      {interleaved ? NULL : fdtd->ey, volume},
+      {interleaved ? NULL : fdtd->ez, volume},
+      {fdtd->psi_hy_x[0], slab_x}, {fdtd->psi_hy_x[1], slab_x},
+      {fdtd->psi_hz_x[0], slab_x}, {fdtd->psi_hz_x[1], slab_x},
+      {fdtd->psi_ey_x[0], slab_x}, {fdtd->psi_ey_x[1], slab_x},
+      {fdtd->psi_ez_x[0], slab_x}, {fdtd->psi_ez_x[1], slab_x},
+      {fdtd->psi_hx_y[0], slab_y}, {fdtd->psi_hx_y[1], slab_y},
+      {fdtd->psi_hz_y[0], slab_y}, {fdtd->psi_hz_y[1], slab_y},
+      {fdtd->psi_ex_y[0], slab_y}, {fdtd->psi_ex_y[1], slab_y},
+      {fdtd->psi_ez_y[0], slab_y}, {fdtd->psi_ez_y[1], slab_y},
+      {fdtd->psi_hx_z[0], slab_z}, {fdtd->psi_hx_z[1], slab_z},
+      {fdtd->psi_hy_z[0], slab_z}, {fdtd->psi_hy_z[1], slab_z},
+      {fdtd->psi_ex_z[0], slab_z}, {fdtd->psi_ex_z[1], slab_z},
+      {fdtd->psi_ey_z[0], slab_z}, {fdtd->psi_ey_z[1], slab_z},
+  };
+  unsigned count = 0;
+  for (unsigned i = 0; i < max_state_arrays; ++i) {
+    if (candidates[i].ptr == NULL)
+      continue;
+    arrays[count] = candidates[i].ptr;
+    lengths[count] = candidates[i].length;
+    count++;
+  }
+  return count;
+}
+
+static size_t state_length(const struct fdtd3D *fdtd) {
+  void *arrays[max_state_arrays];
+  size_t lengths[max_state_arrays];
+  unsigned num_fields;
+  const unsigned count = state_arrays(fdtd, arrays, lengths, &num_fields);
+  size_t length = 0;
+  for (unsigned i = 0; i < count; ++i)
+    length += lengths[i];
+  return length;
+}
+
+// The states are kept in float_type, the 16 bits fields being widened when
+// packed and rounded back when unpacked
+static void pack_state(const struct fdtd3D *fdtd, float_type *state) {
+  void *arrays[max_state_arrays];
+  size_t lengths[max_state_arrays];
+  unsigned num_fields;
+  const unsigned count = state_arrays(fdtd, arrays, lengths, &num_fields);
+  for (unsigned i = 0; i < count; ++i) {
+    if (i < num_fields) {
+      const field_type *field = arrays[i];
+      for (size_t cell = 0; cell < lengths[i]; ++cell)
+        state[cell] = field[cell];
+    } else {
+      const psi_type *psi = arrays[i];
+      for (size_t cell = 0; cell < lengths[i]; ++cell)
+        state[cell] = psi[cell];
+    }
+    state += lengths[i];
+  }
+}
+
+static void unpack_state(struct fdtd3D *fdtd, const float_type *state) {
+  void *arrays[max_state_arrays];
+  size_t lengths[max_state_arrays];
+  unsigned num_fields;
+  const unsigned count = state_arrays(fdtd, arrays, lengths, &num_fields);
+  for (unsigned i = 0; i < count; ++i) {
+    if (i < num_fields) {
+      field_type *field = arrays[i];
+      for (size_t cell = 0; cell < lengths[i]; ++cell)
+        field[cell] = (field_type)state[cell];
+    } else {
+      psi_type *psi = arrays[i];
+      for (size_t cell = 0; cell < lengths[i]; ++cell)
+        psi[cell] = (psi_type)state[cell];
+    }
+    state += lengths[i];
+  }
+}
+
+// Runs num_steps time steps of fdtd starting from the state at start_time
+static void propagate(struct fdtd3D *fdtd, const float_type *state,
+                      float_type start_time, size_t num_steps) {
+  unpack_state(fdtd, state);
+  fdtd->time = start_time;
+  run_3D_fdtd(fdtd, num_steps, false);
+}
+
+// Coarse prediction of the state after the fine steps
+// [first, first + num_steps): whole coarse steps, then the steps left over by
+// the coarsening taken at the fine time step of tail
+static void predict(struct fdtd3D *coarse, struct fdtd3D *tail,
+                    const float_type *state, float_type start_time,
+                    size_t first, size_t num_steps, unsigned coarsening,
+                    float_type *prediction) {
+  const size_t coarse_steps = num_steps / coarsening;
+  const size_t tail_first = first + coarse_steps * coarsening;
+  if (coarse_steps > 0) {
+    propagate(coarse, state, start_time + (float_type)first * tail->dt,
+              coarse_steps);
+    pack_state(coarse, prediction);
+  } else {
+    memcpy(prediction, state, state_length(coarse) * sizeof(*prediction));
+  }
+  if (tail_first < first + num_steps) {
+    propagate(tail, prediction, start_time + (float_type)tail_first * tail->dt,
+              first + num_steps - tail_first);
+    pack_state(tail, prediction);
+  }
+}
+
+// Relative L2 distance between two states
+static double relative_distance(const float_type *state,
+                                const float_type *reference, size_t length) {
+  double distance = 0., norm = 0.;
+#pragma omp parallel for reduction(+ : distance, norm)
+  for (size_t i = 0; i < length; ++i) {
+    const double difference = (double)(state[i] - reference[i]);
+    distance += difference * difference;
+    norm += (double)reference[i] * (double)reference[i];
+  }
+  return norm > 0. ? sqrt(distance / norm) : sqrt(distance);
+}
+
+void run_3D_parareal(struct fdtd3D *fdtd, size_t num_steps,
+                     const struct fdtd3D_parareal *config, bool verbose) {
+  const float_type start_time = fdtd->time;
+  if (num_steps == 0)
+    return;
+  const unsigned coarsening = config->coarsening;
+  // The slices start on coarse steps, the last one ending with the fine steps
+  // left over by the coarsening
+  const size_t num_coarse_steps =
+      num_steps >= coarsening ? num_steps / coarsening : 1;
+  const unsigned num_slices = config->num_slices < num_coarse_steps
+                                  ? config->num_slices
+                                  : (unsigned)num_coarse_steps;
+  const float_type Sc_max = float_cst(1.) / sqrt(float_cst(3.));
+  if (fdtd->Sc * (float_type)coarsening > Sc_max) {
+    fprintf(stderr,
+            "The coarse propagator is unstable with steps of %u fine steps, "
+            "please use a Courant number lesser or equal to %.5f\n",
+            coarsening, Sc_max / (float_type)coarsening);
+    exit(EXIT_FAILURE);
+  }
+
+  // Slice n covers the fine steps [first_step[n], first_step[n + 1])
+  size_t *first_step = malloc((num_slices + 1) * sizeof(*first_step));
+  float_type *slice_time = malloc(num_slices * sizeof(*slice_time));
+  for (unsigned n = 0; n < num_slices; ++n)
+    first_step[n] = n * num_coarse_steps / num_slices * coarsening;
+  first_step[num_slices] = num_steps;
+  for (unsigned n = 0; n < num_slices; ++n)
+    slice_time[n] = start_time + (float_type)first_step[n] * fdtd->dt;
+
+  struct fdtd3D coarse =
+      clone_fdtd_3D(fdtd, fdtd->Sc * (float_type)coarsening);
+  // Fine propagator of the serial reference, also taking the steps left over
+  // by the coarse propagator
+  struct fdtd3D reference = clone_fdtd_3D(fdtd, fdtd->Sc);
+  struct fdtd3D *fine = malloc(num_slices * sizeof(*fine));
+  for (unsigned n = 0; n < num_slices; ++n) {
+    struct fdtd3D clone = clone_fdtd_3D(fdtd, fdtd->Sc);
+    memcpy(&fine[n], &clone, sizeof(clone));
+  }
+  const size_t length = state_length(fdtd);
+  // States at the slice boundaries and coarse predictions of the previous
+  // iteration
+  float_type *boundary =
+      malloc((num_slices + 1) * length * sizeof(*boundary));
+  float_type *prediction = malloc(num_slices * length * sizeof(*prediction));
+  float_type *coarse_state = malloc(length * sizeof(*coarse_state));
+  float_type *fine_state = malloc(length * sizeof(*fine_state));
+
+  time_measure tstart, tend;
+  get_current_time(&tstart);
+  pack_state(fdtd, boundary);
+  for (unsigned n = 0; n < num_slices; ++n) {
+    predict(&coarse, &reference, boundary + n * length, start_time,
+            first_step[n], first_step[n + 1] - first_step[n], coarsening,
+            boundary + (n + 1) * length);
+    memcpy(prediction + n * length, boundary + (n + 1) * length,
+           length * sizeof(*boundary));
+  }
+
+  // After k iterations the first k boundary states are the fine ones
+  unsigned iterations = 0;
+  double correction = 0.;
+  while (iterations < num_slices) {
+#pragma omp parallel for schedule(dynamic, 1)
+    for (unsigned n = iterations; n < num_slices; ++n) {
+      // Own team so that the orphaned worksharing of the solver does not
+      // bind to the slice loop
+#pragma omp parallel num_threads(1)
+      propagate(&fine[n], boundary + n * length, slice_time[n],
+                first_step[n + 1] - first_step[n]);
+    }
+
+    correction = 0.;
+    for (unsigned n = iterations; n < num_slices; ++n) {
+      predict(&coarse, &reference, boundary + n * length, start_time,
+              first_step[n], first_step[n + 1] - first_step[n], coarsening,
+              coarse_state);
+      pack_state(&fine[n], fine_state);
+      float_type *next = boundary + (n + 1) * length;
+      float_type *previous = prediction + n * length;
+      double change = 0., norm = 0.;
+#pragma omp parallel for reduction(+ : change, norm)
+      for (size_t i = 0; i < length; ++i) {
+        const float_type value = coarse_state[i] + fine_state[i] - previous[i];
+        change += (double)((value - next[i]) * (value - next[i]));
+        norm += (double)(value * value);
+        next[i] = value;
+        previous[i] = coarse_state[i];
+      }
+      if (norm > 0.)
+        correction = fmax(correction, sqrt(change / norm));
+    }
+    iterations++;
+    if (verbose)
+      printf("Parareal iteration %u: largest relative correction %e\n",
+             iterations, correction);
+    if (correction <= config->tolerance)
+      break;
+  }
+  get_current_time(&tend);
+  const double parareal_time = measuring_difftime(tstart, tend);
+
+  // Serial run of the fine propagator over the whole time range
+  get_current_time(&tstart);
+  propagate(&reference, boundary, start_time, num_steps);
+  get_current_time(&tend);
+  const double reference_time = measuring_difftime(tstart, tend);
+  pack_state(&reference, fine_state);
+  const double error = relative_distance(boundary + num_slices * length,
+                                         fine_state, length);
+
+  printf("Parareal: %zu steps in %u slices, coarse steps of %u fine steps\n",
+         num_steps, num_slices, coarsening);
+  printf("Parareal %s after %u iterations in %.4fs, serial reference in "
+         "%.4fs (speedup %.2f)\n",
+         correction <= config->tolerance ? "converged"
+                                         : "ran to the last slice",
+         iterations, parareal_time, reference_time,
+         parareal_time > 0. ? reference_time / parareal_time : 0.);
+  printf("Parareal relative error against the serial reference %e\n", error);
+
+  unpack_state(fdtd, boundary + num_slices * length);
+  fdtd->time = start_time + (float_type)num_steps * fdtd->dt;
+
+  free_3D_fdtd(&reference);
+  for (unsigned n = 0; n < num_slices; ++n)
+    free_3D_fdtd(&fine[n]);
+  free_3D_fdtd(&coarse);
+  free(fine);
+  free(fine_state);
+  free(coarse_state);
+  free(prediction);
+  free(boundary);
+  free(slice_time);
+  free(first_step);
+}
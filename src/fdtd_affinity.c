@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "fdtd_affinity.h"
+#include <stdlib.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+const char *fdtd_affinity_policy_name[num_affinity_policies] = {
+    [affinity_none] = "none",
+    [affinity_compact] = "compact",
+    [affinity_scatter] = "scatter",
+    [affinity_cores] = "cores-only",
+    [affinity_list] = "list",
+};
+
+static enum fdtd_affinity_policy affinity_policy = affinity_none;
+static int *cpu_list = NULL;
+static size_t cpu_list_size = 0;
+
+void fdtd_set_affinity_policy(enum fdtd_affinity_policy policy) {
+  affinity_policy = policy;
+}
+
+bool fdtd_set_affinity_cpu_list(const char *list) {
+  int *cpus = NULL;
+  size_t count = 0, allocated = 0;
+  bool valid = *list != '\0';
+  const char *c = list;
+  while (valid && *c != '\0') {
+    char *end;
+    long first = strtol(c, &end, 10);
+    long last = first;
+    valid = end != c && first >= 0;
+    if (valid && *end == '-') {
+      c = end + 1;
+      last = strtol(c, &end, 10);
+      valid = end != c && last >= first;
+    }
+    if (valid && *end == ',' && end[1] != '\0')
+      end++;
+    else if (*end != '\0')
+      valid = false;
+    for (long cpu = first; valid && cpu <= last; ++cpu) {
+      if (count == allocated) {
+        allocated = allocated == 0 ? 16 : 2 * allocated;
+        cpus = realloc(cpus, allocated * sizeof(*cpus));
+      }
+      cpus[count++] = (int)cpu;
+    }
+    c = end;
+  }
+  if (!valid) {
+    free(cpus);
+    return false;
+  }
+  free(cpu_list);
+  cpu_list = cpus;
+  cpu_list_size = count;
+  affinity_policy = affinity_list;
+  return true;
+}
+
+#ifdef __linux__
+
+struct cpu_topology {
+  int cpu;
+  int package;
+  int core;
+  unsigned core_rank; // Index of the core inside its package
+  unsigned sibling;   // Index of the hardware thread inside its core
+};
+
+// Value of the sysfs topology file, -1 when unknown
+static int read_topology(int cpu, const char *name) {
+  char path[96];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+           cpu, name);
+  FILE *in = fopen(path, "r");
+  int value = -1;
+  if (in != NULL) {
+    if (fscanf(in, "%d", &value) != 1)
+      value = -1;
+    fclose(in);
+  }
+  return value;
+}
+
+static int compare_compact(const void *a, const void *b) {
+  const struct cpu_topology *x = a, *y = b;
+  if (x->package != y->package)
+    return x->package < y->package ? -1 : 1;
+  if (x->core != y->core)
+    return x->core < y->core ? -1 : 1;
+  return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+static int compare_scatter(const void *a, const void *b) {
+  const struct cpu_topology *x = a, *y = b;
+  if (x->sibling != y->sibling)
+    return x->sibling < y->sibling ? -1 : 1;
+  if (x->core_rank != y->core_rank)
+    return x->core_rank < y->core_rank ? -1 : 1;
+  if (x->package != y->package)
+    return x->package < y->package ? -1 : 1;
+  return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+// Topology of the allowed CPUs, sorted in the compact order
+static size_t read_cpu_topology(const cpu_set_t *allowed,
+                                struct cpu_topology **topology) {
+  size_t num_cpus = (size_t)CPU_COUNT(allowed);
+  *topology = malloc(num_cpus * sizeof(**topology));
+  size_t count = 0;
+  for (int cpu = 0; cpu < CPU_SETSIZE && count < num_cpus; ++cpu) {
+    if (!CPU_ISSET((size_t)cpu, allowed))
+      continue;
+    int package = read_topology(cpu, "physical_package_id");
+    int core = read_topology(cpu, "core_id");
+    // Unknown topology: every CPU is a core of a single package
+    (*topology)[count++] = (struct cpu_topology){
+        .cpu = cpu,
+        .package = package < 0 ? 0 : package,
+        .core = core < 0 ? cpu : core,
+    };
+  }
+  qsort(*topology, count, sizeof(**topology), compare_compact);
+  for (size_t i = 0; i < count; ++i) {
+    struct cpu_topology *t = &(*topology)[i];
+    if (i == 0 || t->package != t[-1].package) {
+      t->core_rank = 0;
+      t->sibling = 0;
+    } else if (t->core != t[-1].core) {
+      t->core_rank = t[-1].core_rank + 1;
+      t->sibling = 0;
+    } else {
+      t->core_rank = t[-1].core_rank;
+      t->sibling = t[-1].sibling + 1;
+    }
+  }
+  return count;
+}
+
+static const struct cpu_topology *
+find_cpu(const struct cpu_topology *topology, size_t num_cpus, int cpu) {
+  for (size_t i = 0; i < num_cpus; ++i)
+    if (topology[i].cpu == cpu)
+      return &topology[i];
+  return NULL;
+}
+
+void fdtd_apply_affinity(FILE *out, unsigned first_thread) {
+  if (affinity_policy == affinity_none)
+    return;
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    fprintf(stderr, "Unable to read the CPU affinity, ignoring the %s thread "
+                    "placement\n",
+            fdtd_affinity_policy_name[affinity_policy]);
+    return;
+  }
+  struct cpu_topology *topology;
+  const size_t num_cpus = read_cpu_topology(&allowed, &topology);
+
+  // CPU of the thread i is order[(first_thread + i) % num_order]
+  int *order = malloc(
+      (affinity_policy == affinity_list ? cpu_list_size : num_cpus) *
+      sizeof(*order));
+  size_t num_order = 0;
+  switch (affinity_policy) {
+  case affinity_scatter:
+    qsort(topology, num_cpus, sizeof(*topology), compare_scatter);
+    // fallthrough
+  case affinity_compact:
+    for (size_t i = 0; i < num_cpus; ++i)
+      order[num_order++] = topology[i].cpu;
+    break;
+  case affinity_cores:
+    for (size_t i = 0; i < num_cpus; ++i)
+      if (topology[i].sibling == 0)
+        order[num_order++] = topology[i].cpu;
+    break;
+  case affinity_list:
+    for (size_t i = 0; i < cpu_list_size; ++i) {
+      if (cpu_list[i] >= CPU_SETSIZE ||
+          !CPU_ISSET((size_t)cpu_list[i], &allowed)) {
+        fprintf(stderr, "The CPU %d of the affinity list is not available to "
+                        "the process\n",
+                cpu_list[i]);
+        exit(EXIT_FAILURE);
+      }
+      order[num_order++] = cpu_list[i];
+    }
+    break;
+  default:
+    break;
+  }
+
+  unsigned num_threads = 1;
+  bool failed = false;
+#pragma omp parallel
+  {
+    unsigned thread = 0;
+#ifdef _OPENMP
+    thread = (unsigned)omp_get_thread_num();
+#pragma omp master
+    num_threads = (unsigned)omp_get_num_threads();
+#endif
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t)order[(first_thread + thread) % num_order], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+#pragma omp atomic write
+      failed = true;
+    }
+  }
+  if (failed)
+    fprintf(stderr, "Unable to pin every thread, the %s thread placement is "
+                    "partially applied\n",
+            fdtd_affinity_policy_name[affinity_policy]);
+
+  if (out != NULL) {
+    fprintf(out, "Thread placement %s: %u threads from thread %u on %zu "
+                 "CPUs%s\n",
+            fdtd_affinity_policy_name[affinity_policy], num_threads,
+            first_thread, num_order,
+            first_thread + num_threads > num_order ? ", sharing CPUs" : "");
+    for (unsigned thread = 0; thread < num_threads; ++thread) {
+      const int cpu = order[(first_thread + thread) % num_order];
+      const struct cpu_topology *t = find_cpu(topology, num_cpus, cpu);
+      fprintf(out, "  thread %u: CPU %d (package %d, core %d)\n", thread, cpu,
+              t->package, t->core);
+    }
+  }
+  free(order);
+  free(topology);
+}
+
+#else // __linux__
+
+void fdtd_apply_affinity(FILE *out, unsigned first_thread) {
+  (void)out;
+  (void)first_thread;
+  if (affinity_policy != affinity_none)
+    fprintf(stderr, "The thread placement is only supported on Linux, "
+                    "ignoring the %s policy\n",
+            fdtd_affinity_policy_name[affinity_policy]);
+}
+
+#endif // __linux__
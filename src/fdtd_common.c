@@ -29,6 +29,7 @@
  */
 
 #include "fdtd_common.h"
+#include <stdlib.h>
 
 struct fdtd_source gaussian_source(float_type delay, float_type peak_time,
                                    float_type peak_val) {
@@ -39,6 +40,18 @@ struct fdtd_source gaussian_source(float_type delay, float_type peak_time,
   return gs;
 }
 
+void fdtd_dump_header(FILE *out, enum dumpable_data what_to_dump) {
+  fprintf(out, "# %s, %s precision\n", dumpable_data_name[what_to_dump],
+          fdtd_precision_name[field_type_precision]);
+}
+
+double *fdtd_widen_field(const field_type *field, size_t cells) {
+  double *widened = malloc(cells * sizeof(*widened));
+  for (size_t cell = 0; cell < cells; ++cell)
+    widened[cell] = (double)field[cell];
+  return widened;
+}
+
 float_type gaussian_pulse_val(float_type time, struct fdtd_source *src) {
   /*if ((time - src->gaussian_pulse_delay) >=*/
   /*(-src->gaussian_pulse_peak_time / float_cst(2.)) &&*/
@@ -72,6 +85,12 @@ extern inline float_type c(uintmax_t dist_from_border,
                            uintmax_t CPML_region_width, float_type dt,
                            float_type alpha_max, float_type sigma_max);
 
+extern inline float_type update_coefficient_a(float_type dt, float_type inv,
+                                              float_type sigma);
+
+extern inline float_type update_coefficient_b(float_type dt, float_type inv,
+                                              float_type sigma);
+
 const char *dumpable_data_name[num_dumpable_data] = {
     "Electric field X directed components",
     "Electric field Y directed components",
@@ -79,6 +98,6 @@ const char *dumpable_data_name[num_dumpable_data] = {
     "Magnetic field X directed components",
     "Magnetic field Y directed components",
     "Magnetic field Z directed components",
-    "Multiplicative inverse of the permittivity",
-    "Multiplicative inverse of the permeability",
+    "Electric field update coefficient Cb",
+    "Magnetic field update coefficient Db",
 };
@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd_memory.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef FDTD_HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+const char *fdtd_memory_placement_name[num_memory_placements] = {
+    [placement_default] = "default",
+    [placement_first_touch] = "first-touch",
+    [placement_interleave] = "interleave",
+};
+
+static enum fdtd_memory_placement memory_placement = placement_default;
+
+void fdtd_set_memory_placement(enum fdtd_memory_placement placement) {
+#ifdef FDTD_HAVE_LIBNUMA
+  if (placement == placement_interleave && numa_available() < 0) {
+    fprintf(stderr, "NUMA is not available on this system, falling back to "
+                    "the first-touch placement\n");
+    placement = placement_first_touch;
+  }
+#else
+  if (placement == placement_interleave) {
+    fprintf(stderr, "fdtd was compiled without libnuma, falling back to the "
+                    "first-touch placement\n");
+    placement = placement_first_touch;
+  }
+#endif
+  memory_placement = placement;
+}
+
+enum fdtd_memory_placement fdtd_get_memory_placement(void) {
+  return memory_placement;
+}
+
+const char *fdtd_volume_padding_name[num_volume_paddings] = {
+    [padding_none] = "none",
+    [padding_aligned] = "aligned",
+    [padding_staggered] = "staggered",
+};
+
+static enum fdtd_volume_padding volume_padding = padding_staggered;
+
+void fdtd_set_volume_padding(enum fdtd_volume_padding padding) {
+  volume_padding = padding;
+}
+
+enum fdtd_volume_padding fdtd_get_volume_padding(void) {
+  return volume_padding;
+}
+
+const char *fdtd_huge_pages_name[num_huge_page_modes] = {
+    [huge_pages_none] = "none",
+    [huge_pages_transparent] = "thp",
+    [huge_pages_hugetlb] = "hugetlb",
+};
+
+static enum fdtd_huge_pages huge_pages = huge_pages_none;
+
+// Whether the kernel hands out transparent huge pages to madvised mappings
+static bool transparent_huge_pages_available(void) {
+  FILE *in = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (in == NULL)
+    return false;
+  char modes[128];
+  const bool read = fgets(modes, sizeof(modes), in) != NULL;
+  fclose(in);
+  return read && strstr(modes, "[never]") == NULL;
+}
+
+void fdtd_set_huge_pages(enum fdtd_huge_pages mode) {
+  // The hugetlbfs pages fall back to the transparent ones when the pool runs
+  // out, which only shows at mapping time
+  if (mode == huge_pages_transparent && !transparent_huge_pages_available()) {
+    fprintf(stderr, "Transparent huge pages are not available on this "
+                    "system, falling back to the base pages\n");
+    mode = huge_pages_none;
+  }
+  huge_pages = mode;
+}
+
+enum fdtd_huge_pages fdtd_get_huge_pages(void) { return huge_pages; }
+
+struct fdtd_volume_shape fdtd_volume_shape(uintmax_t size1, uintmax_t size2,
+                                           uintmax_t size3, size_t elem_size) {
+  struct fdtd_volume_shape shape = {size2, size3};
+  if (volume_padding == padding_none || fdtd_cache_line % elem_size != 0)
+    return shape;
+  const uintmax_t line = fdtd_cache_line / elem_size;
+  shape.pitch = (size3 + line - 1) / line * line;
+  if (volume_padding == padding_aligned)
+    return shape;
+  // An extra cache line makes the row stride an odd number of lines, which
+  // spreads the consecutive rows over all the sets
+  if (shape.pitch * elem_size % fdtd_critical_stride == 0)
+    shape.pitch += line;
+  while (size1 > 1 &&
+         shape.rows * shape.pitch * elem_size % fdtd_critical_stride == 0)
+    shape.rows++;
+  return shape;
+}
+
+static struct fdtd_padding_stats padding_stats;
+
+static size_t page_size(void) {
+  long size = sysconf(_SC_PAGESIZE);
+  return size > 0 ? (size_t)size : 4096;
+}
+
+static size_t round_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// Mappings of the freed arenas kept for reuse when recycling
+struct buffer {
+  void *ptr;
+  size_t capacity;
+  enum fdtd_huge_pages huge_pages;
+};
+
+struct buffer_list {
+  struct buffer *buffers;
+  size_t count;
+  size_t allocated;
+};
+
+static bool buffer_recycling = false;
+static struct buffer_list cached_buffers;
+static struct fdtd_buffer_cache_stats cache_stats;
+// Largest cached mapping the arenas of the calling thread may reuse
+static size_t reuse_limit = SIZE_MAX;
+#pragma omp threadprivate(reuse_limit)
+
+static void buffer_list_push(struct buffer_list *list, struct buffer buffer) {
+  if (list->count == list->allocated) {
+    list->allocated = list->allocated == 0 ? 16 : 2 * list->allocated;
+    list->buffers =
+        realloc(list->buffers, list->allocated * sizeof(*list->buffers));
+  }
+  list->buffers[list->count++] = buffer;
+}
+
+static struct buffer buffer_list_remove(struct buffer_list *list,
+                                        size_t index) {
+  struct buffer buffer = list->buffers[index];
+  list->buffers[index] = list->buffers[--list->count];
+  return buffer;
+}
+
+void fdtd_set_buffer_recycling(bool enable) { buffer_recycling = enable; }
+
+void fdtd_set_buffer_reuse_limit(size_t max_bytes) { reuse_limit = max_bytes; }
+
+struct fdtd_arena fdtd_arena_init(void) {
+  return (struct fdtd_arena){.base = NULL};
+}
+
+void fdtd_arena_request(struct fdtd_arena *arena, void **ptr, uintmax_t size1,
+                        uintmax_t size2, uintmax_t size3, size_t elem_size) {
+  fdtd_arena_request_padded(arena, ptr, size1, size2, size3,
+                            (struct fdtd_volume_shape){size2, size3},
+                            elem_size);
+}
+
+void fdtd_arena_request_padded(struct fdtd_arena *arena, void **ptr,
+                               uintmax_t size1, uintmax_t size2,
+                               uintmax_t size3, struct fdtd_volume_shape shape,
+                               size_t elem_size) {
+  if (arena->base != NULL) {
+    fprintf(stderr, "Arrays cannot be added to an arena already mapped\n");
+    exit(EXIT_FAILURE);
+  }
+  // Every array starts on a cache line. With the staggered padding, the
+  // arrays are further shifted by one line each so that their first elements
+  // do not all fall into the same cache set.
+  size_t offset = round_up(arena->size, fdtd_cache_line);
+  if (volume_padding == padding_staggered && arena->num_arrays > 0)
+    offset += fdtd_cache_line;
+  const size_t row_size = shape.pitch * elem_size;
+  const size_t bytes = size1 * shape.rows * row_size;
+  if (arena->num_arrays == arena->allocated) {
+    arena->allocated = arena->allocated == 0 ? 16 : 2 * arena->allocated;
+    arena->arrays =
+        realloc(arena->arrays, arena->allocated * sizeof(*arena->arrays));
+  }
+  arena->arrays[arena->num_arrays++] = (struct fdtd_arena_array){
+      .ptr = ptr,
+      .offset = offset,
+      .planes = size1,
+      .rows = shape.rows,
+      .row_size = row_size,
+  };
+  arena->size = offset + bytes;
+  arena->padding += bytes - size1 * size2 * size3 * elem_size;
+}
+
+size_t fdtd_arena_footprint(size_t array_bytes, unsigned num_arrays) {
+  // Up to a line to align each array, and a line to stagger it
+  const size_t lines_per_array = volume_padding == padding_staggered ? 2 : 1;
+  size_t capacity =
+      round_up(array_bytes + num_arrays * lines_per_array * fdtd_cache_line,
+               page_size());
+  if (huge_pages != huge_pages_none && capacity >= fdtd_huge_page_size)
+    capacity = round_up(capacity, fdtd_huge_page_size);
+  return capacity;
+}
+
+// Zeroes the arrays of the arena with the same static distribution of the
+// (planes, rows) pairs as the kernels, which also places the pages on first
+// touch
+static void zero_arena_arrays(struct fdtd_arena *arena) {
+  for (unsigned a = 0; a < arena->num_arrays; ++a) {
+    const struct fdtd_arena_array array = arena->arrays[a];
+    unsigned char *ptr = arena->base + array.offset;
+#pragma omp parallel for collapse(2) schedule(static)
+    for (uintmax_t i = 0; i < array.planes; ++i) {
+      for (uintmax_t j = 0; j < array.rows; ++j) {
+        memset(ptr + (i * array.rows + j) * array.row_size, 0,
+               array.row_size);
+      }
+    }
+  }
+}
+
+// Anonymous mapping of size bytes starting on a huge page boundary, so that
+// all of it can be backed by transparent huge pages
+static unsigned char *map_huge_page_aligned(size_t size) {
+  unsigned char *mapping =
+      mmap(NULL, size + fdtd_huge_page_size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+    return MAP_FAILED;
+  const size_t head = round_up((uintptr_t)mapping, fdtd_huge_page_size) -
+                      (uintptr_t)mapping;
+  unsigned char *base = mapping + head;
+  if (head > 0)
+    munmap(mapping, head);
+  if (head < fdtd_huge_page_size)
+    munmap(base + size, fdtd_huge_page_size - head);
+  return base;
+}
+
+// New zero filled mapping of capacity bytes backed by the requested pages,
+// capacity being rounded up to whole huge pages when they are used
+static unsigned char *map_arena(size_t *capacity,
+                                enum fdtd_huge_pages *backing) {
+  *backing = huge_pages;
+  if (*capacity < fdtd_huge_page_size)
+    *backing = huge_pages_none;
+  if (*backing != huge_pages_none)
+    *capacity = round_up(*capacity, fdtd_huge_page_size);
+  unsigned char *base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (*backing == huge_pages_hugetlb) {
+#ifdef MAP_HUGE_2MB
+    const int huge_flags = MAP_HUGETLB | MAP_HUGE_2MB;
+#else
+    const int huge_flags = MAP_HUGETLB;
+#endif
+    base = mmap(NULL, *capacity, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | huge_flags, -1, 0);
+    if (base == MAP_FAILED) {
+      fprintf(stderr,
+              "Not enough hugetlbfs pages for the %zu MiB arena, falling back "
+              "to transparent huge pages\n",
+              *capacity / (1024 * 1024));
+      *backing = huge_pages_transparent;
+    }
+  }
+#else
+  if (*backing == huge_pages_hugetlb)
+    *backing = huge_pages_transparent;
+#endif
+  if (*backing == huge_pages_transparent) {
+    base = map_huge_page_aligned(*capacity);
+#ifdef MADV_HUGEPAGE
+    if (base != MAP_FAILED && madvise(base, *capacity, MADV_HUGEPAGE) != 0)
+      *backing = huge_pages_none;
+#else
+    *backing = huge_pages_none;
+#endif
+  } else if (*backing == huge_pages_none) {
+    base = mmap(NULL, *capacity, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  return base;
+}
+
+void fdtd_arena_map(struct fdtd_arena *arena) {
+  size_t capacity = round_up(arena->size > 0 ? arena->size : 1, page_size());
+  enum fdtd_huge_pages backing = huge_pages_none;
+  unsigned char *base = NULL;
+  if (buffer_recycling) {
+    // Smallest cached mapping large enough, within the reuse limit
+#pragma omp critical(fdtd_buffer_cache)
+    {
+      size_t best = cached_buffers.count;
+      for (size_t i = 0; i < cached_buffers.count; ++i) {
+        if (cached_buffers.buffers[i].capacity >= capacity &&
+            cached_buffers.buffers[i].capacity <= reuse_limit &&
+            (best == cached_buffers.count ||
+             cached_buffers.buffers[i].capacity <
+                 cached_buffers.buffers[best].capacity))
+          best = i;
+      }
+      if (best < cached_buffers.count) {
+        struct buffer buffer = buffer_list_remove(&cached_buffers, best);
+        cache_stats.cached_bytes -= buffer.capacity;
+        cache_stats.reused++;
+        base = buffer.ptr;
+        capacity = buffer.capacity;
+        backing = buffer.huge_pages;
+      }
+      cache_stats.allocations++;
+    }
+  }
+  const bool reused = base != NULL;
+  if (!reused) {
+    // Fresh anonymous pages read as zero and are only placed on first touch
+    base = map_arena(&capacity, &backing);
+    if (base == MAP_FAILED) {
+      fprintf(stderr, "Failed to map the %zu bytes of the simulation arena\n",
+              capacity);
+      exit(EXIT_FAILURE);
+    }
+#ifdef FDTD_HAVE_LIBNUMA
+    if (memory_placement == placement_interleave)
+      numa_interleave_memory(base, capacity, numa_all_nodes_ptr);
+#endif
+  }
+  arena->base = base;
+  arena->capacity = capacity;
+  arena->huge_pages = backing;
+  if (reused || memory_placement != placement_default)
+    zero_arena_arrays(arena);
+  for (unsigned a = 0; a < arena->num_arrays; ++a)
+    *arena->arrays[a].ptr = base + arena->arrays[a].offset;
+  // The requests point into the caller's frame, no use keeping them
+  free(arena->arrays);
+  arena->arrays = NULL;
+  arena->allocated = 0;
+#pragma omp critical(fdtd_padding_stats)
+  {
+    padding_stats.volumes += arena->num_arrays;
+    padding_stats.bytes += arena->size;
+    padding_stats.padding += arena->padding;
+  }
+}
+
+void fdtd_arena_zero(struct fdtd_arena *arena) {
+  memset(arena->base, 0, arena->size);
+}
+
+void fdtd_arena_copy(struct fdtd_arena *dst, const struct fdtd_arena *src) {
+  if (dst->size != src->size || dst->num_arrays != src->num_arrays) {
+    fprintf(stderr,
+            "Cannot copy an arena of %u arrays in %zu bytes to one of %u "
+            "arrays in %zu bytes\n",
+            src->num_arrays, src->size, dst->num_arrays, dst->size);
+    exit(EXIT_FAILURE);
+  }
+  memcpy(dst->base, src->base, src->size);
+}
+
+void fdtd_arena_free(struct fdtd_arena *arena) {
+  if (arena->base != NULL) {
+#pragma omp critical(fdtd_padding_stats)
+    {
+      padding_stats.volumes -= arena->num_arrays;
+      padding_stats.bytes -= arena->size;
+      padding_stats.padding -= arena->padding;
+    }
+    if (buffer_recycling) {
+#pragma omp critical(fdtd_buffer_cache)
+      {
+        buffer_list_push(&cached_buffers,
+                         (struct buffer){arena->base, arena->capacity,
+                                         arena->huge_pages});
+        cache_stats.cached_bytes += arena->capacity;
+      }
+    } else {
+      munmap(arena->base, arena->capacity);
+    }
+  }
+  free(arena->arrays);
+  *arena = fdtd_arena_init();
+}
+
+size_t fdtd_arena_huge_pages(const struct fdtd_arena *arena) {
+  if (arena->base == NULL || arena->huge_pages == huge_pages_none)
+    return 0;
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if (smaps == NULL)
+    return 0;
+  // Huge pages of the mappings overlapping the arena, in proportion of their
+  // overlap as a mapping merged with a neighbouring one spans both
+  const uintptr_t first = (uintptr_t)arena->base;
+  const uintptr_t last = first + arena->capacity;
+  double overlap = 0.;
+  double huge_kB = 0.;
+  char line[256];
+  while (fgets(line, sizeof(line), smaps) != NULL) {
+    uintptr_t start, end;
+    size_t kB;
+    if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ", &start, &end) == 2) {
+      const uintptr_t overlap_start = start > first ? start : first;
+      const uintptr_t overlap_end = end < last ? end : last;
+      overlap = overlap_start < overlap_end
+                    ? (double)(overlap_end - overlap_start) /
+                          (double)(end - start)
+                    : 0.;
+    } else if (overlap > 0. &&
+               (sscanf(line, "AnonHugePages: %zu kB", &kB) == 1 ||
+                sscanf(line, "Private_Hugetlb: %zu kB", &kB) == 1)) {
+      huge_kB += overlap * (double)kB;
+    }
+  }
+  fclose(smaps);
+  return (size_t)(huge_kB * 1024. / (double)fdtd_huge_page_size + 0.5);
+}
+
+void fdtd_print_huge_pages(FILE *out, const struct fdtd_arena *arena) {
+  if (huge_pages == huge_pages_none)
+    return;
+  const double MiB = 1024. * 1024.;
+  if (arena->huge_pages == huge_pages_none) {
+    fprintf(out,
+            "Huge pages (%s): none for the %.1f MiB arena, smaller than a "
+            "huge page\n",
+            fdtd_huge_pages_name[huge_pages], (double)arena->size / MiB);
+    return;
+  }
+  fprintf(out, "Huge pages (%s): %zu of %zu pages of %zu MiB for the %.1f MiB "
+               "arena\n",
+          fdtd_huge_pages_name[arena->huge_pages],
+          fdtd_arena_huge_pages(arena),
+          arena->capacity / fdtd_huge_page_size,
+          fdtd_huge_page_size / (1024 * 1024), (double)arena->size / MiB);
+}
+
+size_t fdtd_trim_buffer_cache(size_t max_bytes) {
+  size_t cached_bytes;
+#pragma omp critical(fdtd_buffer_cache)
+  {
+    // Release the largest mappings first
+    while (cache_stats.cached_bytes > max_bytes) {
+      size_t largest = 0;
+      for (size_t i = 1; i < cached_buffers.count; ++i) {
+        if (cached_buffers.buffers[i].capacity >
+            cached_buffers.buffers[largest].capacity)
+          largest = i;
+      }
+      struct buffer buffer = buffer_list_remove(&cached_buffers, largest);
+      cache_stats.cached_bytes -= buffer.capacity;
+      munmap(buffer.ptr, buffer.capacity);
+    }
+    cached_bytes = cache_stats.cached_bytes;
+  }
+  return cached_bytes;
+}
+
+struct fdtd_buffer_cache_stats fdtd_get_buffer_cache_stats(void) {
+  struct fdtd_buffer_cache_stats stats;
+#pragma omp critical(fdtd_buffer_cache)
+  stats = cache_stats;
+  return stats;
+}
+
+struct fdtd_padding_stats fdtd_get_padding_stats(void) {
+  struct fdtd_padding_stats stats;
+#pragma omp critical(fdtd_padding_stats)
+  stats = padding_stats;
+  return stats;
+}
+
+void fdtd_print_padding_stats(FILE *out) {
+  const double MiB = 1024. * 1024.;
+  const struct fdtd_padding_stats stats = fdtd_get_padding_stats();
+  fprintf(out,
+          "Volume padding (%s): %.1f MiB over %zu volumes of %.1f MiB "
+          "(%.1f%%)\n",
+          fdtd_volume_padding_name[volume_padding],
+          (double)stats.padding / MiB, stats.volumes,
+          (double)stats.bytes / MiB,
+          stats.bytes > 0 ? 100. * (double)stats.padding / (double)stats.bytes
+                          : 0.);
+}
+
+struct fdtd_memory_usage fdtd_memory_usage_init(void) {
+  struct fdtd_memory_usage usage = {
+      .num_nodes = 1, .node_bytes = NULL, .non_resident = 0, .unknown = 0};
+#ifdef FDTD_HAVE_LIBNUMA
+  if (numa_available() >= 0)
+    usage.num_nodes = (unsigned)numa_max_node() + 1;
+#endif
+  usage.node_bytes = calloc(usage.num_nodes, sizeof(*usage.node_bytes));
+  return usage;
+}
+
+void fdtd_memory_usage_add(struct fdtd_memory_usage *usage, const void *ptr,
+                           size_t size) {
+  if (ptr == NULL || size == 0)
+    return;
+#ifdef FDTD_HAVE_LIBNUMA
+  if (numa_available() >= 0) {
+    enum { query_batch = 4096 };
+    void *pages[query_batch];
+    int status[query_batch];
+    const size_t page = page_size();
+    uintptr_t first = (uintptr_t)ptr / page * page;
+    uintptr_t end = (uintptr_t)ptr + size;
+    uintptr_t addr = first;
+    while (addr < end) {
+      unsigned long count = 0;
+      for (; count < query_batch && addr < end; ++count, addr += page)
+        pages[count] = (void *)addr;
+      if (move_pages(0, count, pages, NULL, status, 0) != 0) {
+        usage->unknown += count * page;
+        continue;
+      }
+      for (unsigned long p = 0; p < count; ++p) {
+        if (status[p] >= 0 && (unsigned)status[p] < usage->num_nodes)
+          usage->node_bytes[status[p]] += page;
+        else
+          usage->non_resident += page;
+      }
+    }
+    return;
+  }
+#endif
+  usage->unknown += size;
+}
+
+void fdtd_memory_usage_print(FILE *out, const struct fdtd_memory_usage *usage) {
+  const double MiB = 1024. * 1024.;
+  size_t total = usage->non_resident + usage->unknown;
+  for (unsigned n = 0; n < usage->num_nodes; ++n)
+    total += usage->node_bytes[n];
+  if (total == 0)
+    total = 1;
+  fprintf(out, "Memory placement (%s):",
+          fdtd_memory_placement_name[memory_placement]);
+  if (usage->unknown == total) {
+    fprintf(out, " %.1f MiB, per node placement unavailable\n",
+            (double)usage->unknown / MiB);
+    return;
+  }
+  for (unsigned n = 0; n < usage->num_nodes; ++n) {
+    fprintf(out, " node%u %.1f MiB (%.1f%%)", n,
+            (double)usage->node_bytes[n] / MiB,
+            100. * (double)usage->node_bytes[n] / (double)total);
+  }
+  if (usage->non_resident > 0)
+    fprintf(out, " not resident %.1f MiB", (double)usage->non_resident / MiB);
+  if (usage->unknown > 0)
+    fprintf(out, " unknown %.1f MiB", (double)usage->unknown / MiB);
+  fprintf(out, "\n");
+}
+
+void fdtd_memory_usage_free(struct fdtd_memory_usage *usage) {
+  free(usage->node_bytes);
+  usage->node_bytes = NULL;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd_precision.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *fdtd_precision_name[num_precisions] = {
+    [precision_float] = "float",
+    [precision_double] = "double",
+    [precision_fp16] = "fp16",
+    [precision_bf16] = "bf16",
+};
+
+// Unit roundoff of the stored values, the error bound of a single rounding
+static const double unit_roundoff[num_precisions] = {
+    [precision_float] = 0x1p-24,
+    [precision_double] = 0x1p-53,
+    [precision_fp16] = 0x1p-11,
+    [precision_bf16] = 0x1p-8,
+};
+
+void fdtd_free_field_snapshot(struct fdtd_field_snapshot *snapshot) {
+  for (unsigned c = 0; c < snapshot->num_components; ++c)
+    free(snapshot->component[c]);
+  snapshot->num_components = 0;
+}
+
+void fdtd_print_precision_report(FILE *out, enum fdtd_precision precision,
+                                 const struct fdtd_field_snapshot *fields,
+                                 const struct fdtd_field_snapshot *reference) {
+  if (fields->num_components != reference->num_components ||
+      fields->cells != reference->cells ||
+      fields->num_steps != reference->num_steps) {
+    fprintf(stderr, "The fields of the precision report do not match the "
+                    "reference\n");
+    exit(EXIT_FAILURE);
+  }
+  fprintf(out,
+          "Precision report: %s against double, %zu cells after %zu steps, "
+          "unit roundoff %.3g\n",
+          fdtd_precision_name[precision], fields->cells, fields->num_steps,
+          unit_roundoff[precision]);
+  fprintf(out, "# field max|ref| max|error| rel_max rel_l2\n");
+  for (unsigned c = 0; c < fields->num_components; ++c) {
+    const double *value = fields->component[c];
+    const double *expected = reference->component[c];
+    double max_reference = 0., max_error = 0., error_norm = 0., norm = 0.;
+    for (size_t i = 0; i < fields->cells; ++i) {
+      const double error = value[i] - expected[i];
+      max_reference = fmax(max_reference, fabs(expected[i]));
+      max_error = fmax(max_error, fabs(error));
+      error_norm += error * error;
+      norm += expected[i] * expected[i];
+    }
+    fprintf(out, "%s %.6e %.6e %.6e %.6e\n", fields->name[c], max_reference,
+            max_error, max_reference > 0. ? max_error / max_reference : 0.,
+            norm > 0. ? sqrt(error_norm / norm) : 0.);
+  }
+}
+
+// Value of the -R or --precision option, NULL when absent. The option is
+// parsed again, and ignored, by the command line parser of the precision.
+static const char *precision_option(int argc, char **argv) {
+  const char *value = NULL;
+  for (int arg = 1; arg < argc; ++arg) {
+    if (strcmp(argv[arg], "--") == 0)
+      break;
+    if ((strcmp(argv[arg], "-R") == 0 ||
+         strcmp(argv[arg], "--precision") == 0) &&
+        arg + 1 < argc)
+      value = argv[++arg];
+    else if (strncmp(argv[arg], "--precision=", 12) == 0)
+      value = argv[arg] + 12;
+    else if (strncmp(argv[arg], "-R", 2) == 0 && argv[arg][2] != '\0')
+      value = argv[arg] + 2;
+  }
+  return value;
+}
+
+int main(int argc, char **argv) {
+  enum fdtd_precision precision = precision_double;
+  const char *name = precision_option(argc, argv);
+  if (name != NULL) {
+    precision = 0;
+    while (precision < num_precisions &&
+           strcmp(name, fdtd_precision_name[precision]) != 0)
+      precision++;
+    if (precision == num_precisions) {
+      fprintf(stderr, "Unknown precision \"%s\"\n", name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  switch (precision) {
+  case precision_float:
+    return fdtd_main_float(argc, argv);
+#ifdef FDTD_HAVE_FP16_FIELDS
+  case precision_fp16:
+    return fdtd_main_fp16(argc, argv);
+#endif
+#ifdef FDTD_HAVE_BF16_FIELDS
+  case precision_bf16:
+    return fdtd_main_bf16(argc, argv);
+#endif
+  case precision_double:
+    return fdtd_main_double(argc, argv);
+  default:
+    fprintf(stderr, "The %s fields are not supported by this build\n",
+            fdtd_precision_name[precision]);
+    exit(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd_simd.h"
+
+const char *fdtd_kernel_isa_name[num_kernel_isas] = {
+    [kernel_isa_scalar] = "scalar",
+    [kernel_isa_sse2] = "sse2",
+    [kernel_isa_avx2] = "avx2",
+    [kernel_isa_avx512] = "avx512",
+};
+
+static void scalar_curl1_row(uintmax_t n, field_type *restrict out,
+                             const field_type *restrict a,
+                             const field_type *restrict b, float_type c1,
+                             const float_type *restrict ca,
+                             const float_type *restrict cb) {
+  for (uintmax_t k = 0; k < n; ++k)
+    out[k] = ca[k] * out[k] + (a[k] - b[k]) * c1 * cb[k];
+}
+
+static void scalar_curl2_row(uintmax_t n, field_type *restrict out,
+                             const field_type *restrict a,
+                             const field_type *restrict b,
+                             const field_type *restrict c,
+                             const field_type *restrict d, float_type c1,
+                             float_type c2, const float_type *restrict ca,
+                             const float_type *restrict cb) {
+  for (uintmax_t k = 0; k < n; ++k)
+    out[k] =
+        ca[k] * out[k] + ((a[k] - b[k]) * c1 - (c[k] - d[k]) * c2) * cb[k];
+}
+
+static void scalar_curl2_uniform_row(uintmax_t n, field_type *restrict out,
+                                     const field_type *restrict a,
+                                     const field_type *restrict b,
+                                     const field_type *restrict c,
+                                     const field_type *restrict d,
+                                     float_type c1, float_type c2,
+                                     float_type ca, float_type cb) {
+  for (uintmax_t k = 0; k < n; ++k)
+    out[k] = ca * out[k] + ((a[k] - b[k]) * c1 - (c[k] - d[k]) * c2) * cb;
+}
+
+static const struct fdtd_row_kernels scalar_row_kernels = {
+    .curl1 = scalar_curl1_row,
+    .curl2 = scalar_curl2_row,
+    .curl2_uniform = scalar_curl2_uniform_row,
+};
+
+static enum fdtd_kernel_isa kernel_isa = kernel_isa_scalar;
+static const struct fdtd_row_kernels *row_kernels = &scalar_row_kernels;
+
+static bool cpu_supports(enum fdtd_kernel_isa isa) {
+#ifdef FDTD_HAVE_X86_SIMD
+  // The CPUID feature bits, with the OS support of the wide registers
+  __builtin_cpu_init();
+  switch (isa) {
+  case kernel_isa_sse2:
+    return __builtin_cpu_supports("sse2");
+  case kernel_isa_avx2:
+#ifdef FDTD_FIELD_FP16
+    // The half precision conversions are F16C instructions
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+  case kernel_isa_avx512:
+    return __builtin_cpu_supports("avx512f");
+  default:
+    return true;
+  }
+#else
+  return isa == kernel_isa_scalar;
+#endif
+}
+
+enum fdtd_kernel_isa fdtd_detect_kernel_isa(void) {
+  enum fdtd_kernel_isa isa = num_kernel_isas - 1;
+  while (isa > kernel_isa_scalar && !cpu_supports(isa))
+    isa--;
+  return isa;
+}
+
+bool fdtd_set_kernel_isa(enum fdtd_kernel_isa isa) {
+  if (!cpu_supports(isa))
+    return false;
+  switch (isa) {
+#ifdef FDTD_HAVE_X86_SIMD
+  case kernel_isa_sse2:
+    row_kernels = &fdtd_row_kernels_sse2;
+    break;
+  case kernel_isa_avx2:
+    row_kernels = &fdtd_row_kernels_avx2;
+    break;
+  case kernel_isa_avx512:
+    row_kernels = &fdtd_row_kernels_avx512;
+    break;
+#endif
+  default:
+    row_kernels = &scalar_row_kernels;
+    break;
+  }
+  kernel_isa = isa;
+  return true;
+}
+
+enum fdtd_kernel_isa fdtd_get_kernel_isa(void) { return kernel_isa; }
+
+const struct fdtd_row_kernels *fdtd_get_row_kernels(void) {
+  return row_kernels;
+}
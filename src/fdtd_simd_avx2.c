@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// AVX2 row kernels, this file being the only one built with AVX2 enabled
+
+#include "fdtd_simd.h"
+#include <immintrin.h>
+
+#ifdef FDTD_USE_DOUBLE
+#define vec_t __m256d
+#define vec_width 4
+#define vec_load _mm256_loadu_pd
+#define vec_store _mm256_storeu_pd
+#define vec_set1 _mm256_set1_pd
+#define vec_add _mm256_add_pd
+#define vec_sub _mm256_sub_pd
+#define vec_mul _mm256_mul_pd
+#else
+#define vec_t __m256
+#define vec_width 8
+#define vec_load _mm256_loadu_ps
+#define vec_store _mm256_storeu_ps
+#define vec_set1 _mm256_set1_ps
+#define vec_add _mm256_add_ps
+#define vec_sub _mm256_sub_ps
+#define vec_mul _mm256_mul_ps
+#endif
+#if defined(FDTD_FIELD_FP16)
+// F16C conversions, rounding to nearest even as the scalar ones
+static inline vec_t vec_load_field(const field_type *field) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)field));
+}
+
+static inline void vec_store_field(field_type *field, vec_t value) {
+  _mm_storeu_si128((__m128i *)field,
+                   _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+}
+#elif defined(FDTD_FIELD_BF16)
+// The bfloat16 bits are the upper half of the float ones
+static inline vec_t vec_load_field(const field_type *field) {
+  const __m256i bits =
+      _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)field));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 16));
+}
+
+// Rounded to nearest even as the scalar conversions, the NaN made quiet
+static inline void vec_store_field(field_type *field, vec_t value) {
+  const __m256i bits = _mm256_castps_si256(value);
+  const __m256i upper = _mm256_srli_epi32(bits, 16);
+  const __m256i bias = _mm256_add_epi32(
+      _mm256_and_si256(upper, _mm256_set1_epi32(1)), _mm256_set1_epi32(0x7fff));
+  const __m256i rounded =
+      _mm256_srli_epi32(_mm256_add_epi32(bits, bias), 16);
+  const __m256i quiet = _mm256_or_si256(upper, _mm256_set1_epi32(0x40));
+  const __m256i nan =
+      _mm256_castps_si256(_mm256_cmp_ps(value, value, _CMP_UNORD_Q));
+  // The packing works within the 128 bits lanes
+  const __m256i packed = _mm256_packus_epi32(
+      _mm256_blendv_epi8(rounded, quiet, nan), _mm256_setzero_si256());
+  _mm_storeu_si128((__m128i *)field,
+                   _mm256_castsi256_si128(_mm256_permute4x64_epi64(
+                       packed, _MM_SHUFFLE(3, 1, 2, 0))));
+}
+#else
+#define vec_load_field vec_load
+#define vec_store_field vec_store
+#endif
+#define row_kernel(name) avx2_##name##_row
+
+#include "fdtd_simd_rows.h"
+
+const struct fdtd_row_kernels fdtd_row_kernels_avx2 = {
+    .curl1 = row_kernel(curl1),
+    .curl2 = row_kernel(curl2),
+    .curl2_uniform = row_kernel(curl2_uniform),
+};
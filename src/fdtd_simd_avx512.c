@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// AVX-512 row kernels, this file being the only one built with AVX-512 enabled
+
+#include "fdtd_simd.h"
+#include <immintrin.h>
+
+#ifdef FDTD_USE_DOUBLE
+#define vec_t __m512d
+#define vec_width 8
+#define vec_load _mm512_loadu_pd
+#define vec_store _mm512_storeu_pd
+#define vec_set1 _mm512_set1_pd
+#define vec_add _mm512_add_pd
+#define vec_sub _mm512_sub_pd
+#define vec_mul _mm512_mul_pd
+#else
+#define vec_t __m512
+#define vec_width 16
+#define vec_load _mm512_loadu_ps
+#define vec_store _mm512_storeu_ps
+#define vec_set1 _mm512_set1_ps
+#define vec_add _mm512_add_ps
+#define vec_sub _mm512_sub_ps
+#define vec_mul _mm512_mul_ps
+#endif
+#if defined(FDTD_FIELD_FP16)
+// Rounding to nearest even as the scalar conversions
+static inline vec_t vec_load_field(const field_type *field) {
+  return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)field));
+}
+
+static inline void vec_store_field(field_type *field, vec_t value) {
+  _mm256_storeu_si256((__m256i *)field,
+                      _mm512_maskz_cvtps_ph(0xffff, value,
+                                            _MM_FROUND_TO_NEAREST_INT |
+                                                _MM_FROUND_NO_EXC));
+}
+#elif defined(FDTD_FIELD_BF16)
+// The bfloat16 bits are the upper half of the float ones
+static inline vec_t vec_load_field(const field_type *field) {
+  const __m512i bits =
+      _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)field));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(bits, 16));
+}
+
+// Rounded to nearest even as the scalar conversions, the NaN made quiet
+static inline void vec_store_field(field_type *field, vec_t value) {
+  const __m512i bits = _mm512_castps_si512(value);
+  const __m512i upper = _mm512_srli_epi32(bits, 16);
+  const __m512i bias = _mm512_add_epi32(
+      _mm512_and_si512(upper, _mm512_set1_epi32(1)), _mm512_set1_epi32(0x7fff));
+  const __m512i rounded =
+      _mm512_srli_epi32(_mm512_add_epi32(bits, bias), 16);
+  const __m512i quiet = _mm512_or_si512(upper, _mm512_set1_epi32(0x40));
+  const __mmask16 nan = _mm512_cmp_ps_mask(value, value, _CMP_UNORD_Q);
+  _mm256_storeu_si256(
+      (__m256i *)field,
+      _mm512_cvtepi32_epi16(_mm512_mask_mov_epi32(rounded, nan, quiet)));
+}
+#else
+#define vec_load_field vec_load
+#define vec_store_field vec_store
+#endif
+#define row_kernel(name) avx512_##name##_row
+
+#include "fdtd_simd_rows.h"
+
+const struct fdtd_row_kernels fdtd_row_kernels_avx512 = {
+    .curl1 = row_kernel(curl1),
+    .curl2 = row_kernel(curl2),
+    .curl2_uniform = row_kernel(curl2_uniform),
+};
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// SSE2 row kernels, this file being the only one built with SSE2 enabled
+
+#include "fdtd_simd.h"
+#include <emmintrin.h>
+
+#ifdef FDTD_USE_DOUBLE
+#define vec_t __m128d
+#define vec_width 2
+#define vec_load _mm_loadu_pd
+#define vec_store _mm_storeu_pd
+#define vec_set1 _mm_set1_pd
+#define vec_add _mm_add_pd
+#define vec_sub _mm_sub_pd
+#define vec_mul _mm_mul_pd
+#else
+#define vec_t __m128
+#define vec_width 4
+#define vec_load _mm_loadu_ps
+#define vec_store _mm_storeu_ps
+#define vec_set1 _mm_set1_ps
+#define vec_add _mm_add_ps
+#define vec_sub _mm_sub_ps
+#define vec_mul _mm_mul_ps
+#endif
+#if defined(FDTD_FIELD_FP16) || defined(FDTD_FIELD_BF16)
+// Without conversion instructions the 16 bits fields are converted one by one
+static inline vec_t vec_load_field(const field_type *field) {
+  return _mm_setr_ps(field[0], field[1], field[2], field[3]);
+}
+
+static inline void vec_store_field(field_type *field, vec_t value) {
+  float values[vec_width];
+  _mm_storeu_ps(values, value);
+  for (unsigned k = 0; k < vec_width; ++k)
+    field[k] = values[k];
+}
+#else
+#define vec_load_field vec_load
+#define vec_store_field vec_store
+#endif
+#define row_kernel(name) sse2_##name##_row
+
+#include "fdtd_simd_rows.h"
+
+const struct fdtd_row_kernels fdtd_row_kernels_sse2 = {
+    .curl1 = row_kernel(curl1),
+    .curl2 = row_kernel(curl2),
+    .curl2_uniform = row_kernel(curl2_uniform),
+};
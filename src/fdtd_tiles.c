@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2020 Maxime Schmitt <maxime.schmitt@manchester.ac.uk>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fdtd_tiles.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// Tiles [front, back) of tile_order, protected by a spin lock
+struct tile_deque {
+  _Alignas(64) atomic_flag lock;
+  size_t front, back;
+  // Statistics of the owner thread
+  double busy;
+  size_t num_tiles;
+  size_t num_stolen;
+};
+
+struct fdtd_tile_pool {
+  unsigned max_threads;
+  unsigned num_threads;
+  size_t num_tiles;
+  struct tile_deque *deques;
+  double *tile_time; // Accumulated time per tile
+};
+
+struct fdtd_tile_pool *fdtd_tile_pool_alloc(unsigned max_threads,
+                                            size_t num_tiles) {
+  struct fdtd_tile_pool *pool = malloc(sizeof(*pool));
+  pool->max_threads = max_threads;
+  pool->num_threads = max_threads;
+  pool->num_tiles = num_tiles;
+  pool->deques = aligned_alloc(_Alignof(struct tile_deque),
+                               max_threads * sizeof(*pool->deques));
+  for (unsigned t = 0; t < max_threads; ++t) {
+    atomic_flag_clear(&pool->deques[t].lock);
+    pool->deques[t].front = 0;
+    pool->deques[t].back = 0;
+    pool->deques[t].busy = 0.;
+    pool->deques[t].num_tiles = 0;
+    pool->deques[t].num_stolen = 0;
+  }
+  pool->tile_time = calloc(num_tiles, sizeof(*pool->tile_time));
+  return pool;
+}
+
+// Static split: thread t initially owns the tiles [first_tile(t),
+// first_tile(t + 1))
+static size_t first_tile(const struct fdtd_tile_pool *pool, unsigned thread) {
+  return pool->num_tiles * thread / pool->num_threads;
+}
+
+void fdtd_tile_pool_fill(struct fdtd_tile_pool *pool, unsigned num_threads) {
+  pool->num_threads = num_threads < pool->max_threads ? num_threads
+                                                      : pool->max_threads;
+  for (unsigned t = 0; t < pool->num_threads; ++t) {
+    pool->deques[t].front = first_tile(pool, t);
+    pool->deques[t].back = first_tile(pool, t + 1);
+  }
+}
+
+static void deque_lock(struct tile_deque *deque) {
+  while (atomic_flag_test_and_set_explicit(&deque->lock, memory_order_acquire))
+    ;
+}
+
+static void deque_unlock(struct tile_deque *deque) {
+  atomic_flag_clear_explicit(&deque->lock, memory_order_release);
+}
+
+bool fdtd_tile_pool_next(struct fdtd_tile_pool *pool, unsigned thread,
+                         size_t *tile) {
+  struct tile_deque *own = &pool->deques[thread];
+  bool found = false;
+  deque_lock(own);
+  if (own->front < own->back) {
+    *tile = --own->back;
+    found = true;
+  }
+  deque_unlock(own);
+  if (found)
+    return true;
+  // Steal from the front of the other queues, starting with the next thread
+  for (unsigned i = 1; i < pool->num_threads; ++i) {
+    struct tile_deque *victim =
+        &pool->deques[(thread + i) % pool->num_threads];
+    deque_lock(victim);
+    if (victim->front < victim->back) {
+      *tile = victim->front++;
+      found = true;
+    }
+    deque_unlock(victim);
+    if (found) {
+      own->num_stolen++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void fdtd_tile_pool_account(struct fdtd_tile_pool *pool, unsigned thread,
+                            size_t tile, double seconds) {
+  pool->deques[thread].busy += seconds;
+  pool->deques[thread].num_tiles++;
+  pool->tile_time[tile] += seconds;
+}
+
+void fdtd_tile_pool_print_stats(const struct fdtd_tile_pool *pool, FILE *out) {
+  double max_busy = 0., sum_busy = 0., max_static = 0.;
+  for (unsigned t = 0; t < pool->num_threads; ++t) {
+    const struct tile_deque *deque = &pool->deques[t];
+    double static_busy = 0.;
+    for (size_t i = first_tile(pool, t); i < first_tile(pool, t + 1); ++i)
+      static_busy += pool->tile_time[i];
+    fprintf(out,
+            "Thread %u: busy %.3fs, %zu tiles (%zu stolen), static split "
+            "%.3fs\n",
+            t, deque->busy, deque->num_tiles, deque->num_stolen, static_busy);
+    max_busy = deque->busy > max_busy ? deque->busy : max_busy;
+    max_static = static_busy > max_static ? static_busy : max_static;
+    sum_busy += deque->busy;
+  }
+  if (sum_busy > 0.) {
+    double mean_busy = sum_busy / pool->num_threads;
+    fprintf(out,
+            "Busy time imbalance (max / mean): %.3f with work stealing, "
+            "%.3f with a static split\n",
+            max_busy / mean_busy, max_static / mean_busy);
+  }
+}
+
+void fdtd_tile_pool_free(struct fdtd_tile_pool *pool) {
+  free(pool->deques);
+  free(pool->tile_time);
+  free(pool);
+}
@@ -38,12 +38,14 @@
 struct two_medium_data {
   float_type permeability1, permeability2;
   float_type permittivity1, permittivity2;
+  float_type conductivity1, conductivity2; // Electric conductivities (S/m)
   float_type switch_location;
 };
 
 struct middle_object_2D {
   float_type permeability_medium, permeability_object;
   float_type permittivity_medium, permittivity_object;
+  float_type conductivity_medium, conductivity_object; // Electric (S/m)
   float_type object_center[2];
   float_type object_dimensions[2];
 };
@@ -51,6 +53,7 @@ struct middle_object_2D {
 struct middle_object_3D {
   float_type permeability_medium, permeability_object;
   float_type permittivity_medium, permittivity_object;
+  float_type conductivity_medium, conductivity_object; // Electric (S/m)
   float_type object_center[3];
   float_type object_dimensions[3];
 };
@@ -73,6 +76,15 @@ static float_type init_permittivity_two_parts_1D(float_type pos, void *user) {
   }
 }
 
+static float_type init_conductivity_two_parts_1D(float_type pos, void *user) {
+  struct two_medium_data *tpd = (struct two_medium_data *)user;
+  if (pos < tpd->switch_location) {
+    return tpd->conductivity1;
+  } else {
+    return tpd->conductivity2;
+  }
+}
+
 static float_type init_permeability_object_2D(float_type posX, float_type posY,
                                               void *user) {
   struct middle_object_2D *mo = (struct middle_object_2D *)user;
@@ -109,6 +121,24 @@ static float_type init_permittivity_object_2D(float_type posX, float_type posY,
   }
 }
 
+static float_type init_conductivity_object_2D(float_type posX, float_type posY,
+                                              void *user) {
+  struct middle_object_2D *mo = (struct middle_object_2D *)user;
+  if (posX < mo->object_center[0] - mo->object_dimensions[0] / float_cst(2.) ||
+      posX > mo->object_center[0] + mo->object_dimensions[0] / float_cst(2.)) {
+    return mo->conductivity_medium;
+  } else {
+    if (posY <
+            mo->object_center[1] - mo->object_dimensions[1] / float_cst(2.) ||
+        posY >
+            mo->object_center[1] + mo->object_dimensions[1] / float_cst(2.)) {
+      return mo->conductivity_medium;
+    } else {
+      return mo->conductivity_object;
+    }
+  }
+}
+
 static float_type init_permeability_object_3D(float_type posX, float_type posY,
                                               float_type posZ, void *user) {
   struct middle_object_3D *mo = (struct middle_object_3D *)user;
@@ -159,6 +189,31 @@ static float_type init_permittivity_object_3D(float_type posX, float_type posY,
   }
 }
 
+static float_type init_conductivity_object_3D(float_type posX, float_type posY,
+                                              float_type posZ, void *user) {
+  struct middle_object_3D *mo = (struct middle_object_3D *)user;
+  if (posX < mo->object_center[0] - mo->object_dimensions[0] / float_cst(2.) ||
+      posX > mo->object_center[0] + mo->object_dimensions[0] / float_cst(2.)) {
+    return mo->conductivity_medium;
+  } else {
+    if (posY <
+            mo->object_center[1] - mo->object_dimensions[1] / float_cst(2.) ||
+        posY >
+            mo->object_center[1] + mo->object_dimensions[1] / float_cst(2.)) {
+      return mo->conductivity_medium;
+    } else {
+      if (posZ <
+              mo->object_center[2] - mo->object_dimensions[2] / float_cst(2.) ||
+          posZ >
+              mo->object_center[2] + mo->object_dimensions[2] / float_cst(2.)) {
+        return mo->conductivity_medium;
+      } else {
+        return mo->conductivity_object;
+      }
+    }
+  }
+}
+
 static struct fdtd initializeFdtd1D(unsigned setupID, float_type domain_size,
                                     float_type Sc,
                                     float_type smallest_wavelength) {
@@ -182,6 +237,27 @@ static struct fdtd initializeFdtd1D(unsigned setupID, float_type domain_size,
     struct fdtd retval = {.oneDim = fdtd, .type = fdtd_one_dim};
     return retval;
   }
+  case half_air_half_sea_water_1D: {
+    enum border_condition bc[2] = {border_perfect_electric_conductor,
+                                   border_perfect_magnetic_conductor};
+    struct fdtd1D fdtd = init_fdtd_1D(domain_size, Sc, smallest_wavelength, bc);
+    struct two_medium_data tmd = {.permittivity1 = float_cst(1.00058986),
+                                  .permittivity2 = float_cst(78.4),
+                                  .permeability1 = float_cst(1.00000037),
+                                  .permeability2 = float_cst(0.999992),
+                                  .conductivity1 = float_cst(0.),
+                                  .conductivity2 = float_cst(4.),
+                                  .switch_location =
+                                      domain_size / float_cst(2.)};
+    init_fdtd_1D_lossy_medium(&fdtd, init_permeability_two_parts_1D,
+                              init_permittivity_two_parts_1D, NULL,
+                              init_conductivity_two_parts_1D, &tmd);
+    struct fdtd_source src = gaussian_source(
+        float_cst(25.) * fdtd.dt, float_cst(3.) * fdtd.dt, float_cst(1.e-2));
+    add_source_fdtd_1D(source_magnetic, &fdtd, src, float_cst(0.));
+    struct fdtd retval = {.oneDim = fdtd, .type = fdtd_one_dim};
+    return retval;
+  }
   default:
     fprintf(stderr, "The specified 1D setup ID is does not exist\n");
     exit(EXIT_FAILURE);
@@ -218,7 +294,7 @@ static struct fdtd initializeFdtd2D(unsigned setupID, float_type *domain_size,
                         init_permittivity_object_2D, &mo);
 
     struct fdtd_source src = gaussian_source(
-        float_cst(25.) * fdtd.dt, float_cst(3.) * fdtd.dt, float_cst(100));
+        float_cst(25.) * fdtd.dt, float_cst(3.) * fdtd.dt, float_cst(100.));
     for (uintmax_t j = fdtd.cpml_thickness;
          j < fdtd.sizeX - fdtd.cpml_thickness; ++j) {
       add_source_fdtd_2D(source_electric, &fdtd, src, (float_type)j * fdtd.dx,
@@ -282,6 +358,38 @@ static struct fdtd initializeFdtd2D(unsigned setupID, float_type *domain_size,
     struct fdtd retval = {.twoDims = fdtd, .type = fdtd_two_dims};
     return retval;
   } break;
+  case lossy_object_in_free_space_gaussian_exitation_absorbing_border_2D: {
+    enum border_condition bc[num_borders_2D] = {
+        [border_south] = border_perfect_electric_conductor | border_cpml,
+        [border_north] = border_perfect_electric_conductor | border_cpml,
+        [border_east] = border_perfect_electric_conductor | border_cpml,
+        [border_west] = border_perfect_electric_conductor | border_cpml};
+    struct fdtd2D fdtd = init_fdtd_2D_cpml(domain_size, Sc, smallest_wavelength,
+                                           bc, cpml_thickness);
+    // Graphite like conductor on the north side of the excitation
+    struct middle_object_2D mo = {
+        .permittivity_medium = float_cst(1.),
+        .permittivity_object = float_cst(10.),
+        .permeability_medium = float_cst(1.),
+        .permeability_object = float_cst(1.),
+        .conductivity_medium = float_cst(0.),
+        .conductivity_object = float_cst(1e5),
+        .object_center = {float_cst(3.) * domain_size[0] / float_cst(4.),
+                          domain_size[1] / float_cst(2.)},
+        .object_dimensions = {domain_size[0] / float_cst(4.),
+                              domain_size[1] / float_cst(2.)}};
+    init_fdtd_2D_lossy_medium(&fdtd, init_permeability_object_2D,
+                              init_permittivity_object_2D, NULL,
+                              init_conductivity_object_2D, &mo);
+
+    struct fdtd_source src = gaussian_source(
+        float_cst(30.) * fdtd.dt, float_cst(15.) * fdtd.dt, float_cst(1.));
+    add_source_fdtd_2D(source_electric, &fdtd, src,
+                       fdtd.domain_size[0] / float_cst(2.),
+                       fdtd.domain_size[1] / float_cst(2.));
+    struct fdtd retval = {.twoDims = fdtd, .type = fdtd_two_dims};
+    return retval;
+  } break;
   default:
     fprintf(stderr, "The specified 1D setup ID is does not exist\n");
     exit(EXIT_FAILURE);
@@ -320,10 +428,11 @@ static struct fdtd initializeFdtd3D(unsigned setupID, float_type *domain_size,
 
     struct fdtd_source src = gaussian_source(
         float_cst(10.) * fdtd.dt, float_cst(5.) * fdtd.dt, float_cst(1.e-2));
-    for (uintmax_t j = 0; j < fdtd.sizeY; ++j) {
+    for (uintmax_t j = 0; j < fdtd.global_size[1]; ++j) {
       add_source_fdtd_3D(
-          source_magnetic, &fdtd, src, (cpml_thickness + 2) * fdtd.dx,
-          (float_type)j * fdtd.dy, (cpml_thickness + 2) * fdtd.dz);
+          source_magnetic, &fdtd, src,
+          (float_type)(cpml_thickness + 2) * fdtd.dx, (float_type)j * fdtd.dy,
+          (float_type)(cpml_thickness + 2) * fdtd.dz);
     }
 
     struct fdtd retval = {.threeDims = fdtd, .type = fdtd_three_dims};
@@ -355,10 +464,49 @@ static struct fdtd initializeFdtd3D(unsigned setupID, float_type *domain_size,
 
     struct fdtd_source src = gaussian_source(
         float_cst(10.) * fdtd.dt, float_cst(5.) * fdtd.dt, float_cst(1.e-2));
-    for (uintmax_t j = 0; j < fdtd.sizeY; ++j) {
+    for (uintmax_t j = 0; j < fdtd.global_size[1]; ++j) {
+      add_source_fdtd_3D(
+          source_magnetic, &fdtd, src,
+          (float_type)(cpml_thickness + 2) * fdtd.dx, (float_type)j * fdtd.dy,
+          (float_type)(cpml_thickness + 2) * fdtd.dz);
+    }
+    struct fdtd retval = {.threeDims = fdtd, .type = fdtd_three_dims};
+    return retval;
+  } break;
+  case half_air_half_sea_water_3D: {
+    enum border_condition bc[num_borders_3D] = {
+        [border_front] = border_perfect_electric_conductor,
+        [border_back] = border_perfect_electric_conductor,
+        [border_bottom] = border_perfect_electric_conductor,
+        [border_top] = border_perfect_electric_conductor,
+        [border_left] = border_perfect_electric_conductor,
+        [border_right] = border_perfect_electric_conductor};
+    struct fdtd3D fdtd = init_fdtd_3D_cpml(domain_size, Sc, smallest_wavelength,
+                                           bc, cpml_thickness);
+    struct middle_object_3D mo = {
+        .permittivity_medium = float_cst(1.00058986),
+        .permittivity_object = float_cst(78.4),
+        .permeability_medium = float_cst(1.00000037),
+        .permeability_object = float_cst(0.999992),
+        .conductivity_medium = float_cst(0.),
+        .conductivity_object = float_cst(4.),
+        .object_center = {domain_size[0] / float_cst(2.),
+                          domain_size[1] / float_cst(2.),
+                          float_cst(3.) * domain_size[2] / float_cst(4.)},
+        .object_dimensions = {domain_size[0] * float_cst(2.),
+                              domain_size[1] * float_cst(2.),
+                              domain_size[1] / float_cst(2.)}};
+    init_fdtd_3D_lossy_medium(&fdtd, init_permeability_object_3D,
+                              init_permittivity_object_3D, NULL,
+                              init_conductivity_object_3D, &mo);
+
+    struct fdtd_source src = gaussian_source(
+        float_cst(10.) * fdtd.dt, float_cst(5.) * fdtd.dt, float_cst(1.e-2));
+    for (uintmax_t j = 0; j < fdtd.global_size[1]; ++j) {
       add_source_fdtd_3D(
-          source_magnetic, &fdtd, src, (cpml_thickness + 2) * fdtd.dx,
-          (float_type)j * fdtd.dy, (cpml_thickness + 2) * fdtd.dz);
+          source_magnetic, &fdtd, src,
+          (float_type)(cpml_thickness + 2) * fdtd.dx, (float_type)j * fdtd.dy,
+          (float_type)(cpml_thickness + 2) * fdtd.dz);
     }
     struct fdtd retval = {.threeDims = fdtd, .type = fdtd_three_dims};
     return retval;
@@ -390,3 +538,17 @@ struct fdtd initializeFdtd_cmpl(unsigned setupID, float_type *domain_size,
     exit(EXIT_SUCCESS);
   }
 }
+
+size_t fdtd_memory_footprint(unsigned setupID, float_type *domain_size,
+                             float_type smallest_wavelength,
+                             uintmax_t cpml_thickness) {
+  if (setupID < last_1D_setup) {
+    return memory_footprint_1D_fdtd(domain_size[0], smallest_wavelength);
+  } else if (setupID < last_2D_setup) {
+    return memory_footprint_2D_fdtd(domain_size, smallest_wavelength,
+                                    cpml_thickness);
+  } else {
+    return memory_footprint_3D_fdtd(domain_size, smallest_wavelength,
+                                    cpml_thickness);
+  }
+}
@@ -29,7 +29,11 @@
  */
 
 #include "fdtd.h"
+#include "fdtd3D_parareal.h"
+#include "fdtd_affinity.h"
 #include "fdtd_common.h"
+#include "fdtd_memory.h"
+#include "fdtd_simd.h"
 #include "initialize.h"
 #include "time_measurement.h"
 #include <getopt.h>
@@ -38,6 +42,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <tgmath.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef FDTD_USE_MPI
+#include "fdtd3D_mpi.h"
+#endif
 
 static struct option opt_options[] = {
     {"one-dimensional", no_argument, 0, '1'},
@@ -53,11 +64,35 @@ static struct option opt_options[] = {
     {"cpml-absorbing-thickness", required_argument, 0, 'a'},
     {"stop-sim-time", required_argument, 0, 't'},
     {"num-iterations", required_argument, 0, 'i'},
+    {"threads", required_argument, 0, 'n'},
+    {"engine", required_argument, 0, 'e'},
+    {"kernel", required_argument, 0, 'k'},
+    {"time-tile-depth", required_argument, 0, 'D'},
+    {"tile-shape", required_argument, 0, 'B'},
+    {"memory-placement", required_argument, 0, 'm'},
+    {"volume-padding", required_argument, 0, 'A'},
+    {"huge-pages", required_argument, 0, 'H'},
+    {"field-layout", required_argument, 0, 'L'},
+    {"medium-storage", required_argument, 0, 'G'},
+    {"medium-tile-shape", required_argument, 0, 'U'},
+    {"medium-tile-rates", no_argument, 0, 'u'},
+    {"thread-placement", required_argument, 0, 'p'},
+    {"kernel-isa", required_argument, 0, 'I'},
+    {"precision", required_argument, 0, 'R'},
+    {"precision-report", no_argument, 0, 'E'},
+    {"process-grid", required_argument, 0, 'g'},
+    {"parareal", required_argument, 0, 'P'},
+    {"parareal-coarsening", required_argument, 0, 'C'},
+    {"parareal-tolerance", required_argument, 0, 'T'},
+    {"batch", required_argument, 0, 'b'},
+    {"batch-memory", required_argument, 0, 'M'},
+    {"batch-summary", required_argument, 0, 'S'},
     {"help", no_argument, 0, 'h'},
     {"quiet", no_argument, 0, 'q'},
     {0, 0, 0, 0}};
 
-static const char options[] = ":123s:x:y:z:o:c:w:a:t:i:hq";
+static const char options[] =
+    ":123s:x:y:z:o:c:w:a:t:i:n:e:k:D:B:m:A:H:L:G:U:up:I:R:Eg:P:C:T:b:M:S:hq";
 
 static const char help_string[] =
     "Options:"
@@ -67,16 +102,22 @@ static const char help_string[] =
     "\n  -s --setup-id            : Predefined problem identifier"
     "\n                             1D : 0 - Half air half water, "
     "left-to-right gaussian"
+    "\n                                  1 - Half air half sea water "
+    "(lossy)"
     "\n                             2D : 0 - West air east water, "
     "west-to-east gaussian"
     "\n                                  1 - Air with high "
     "permittivity centered object, west pulse"
     "\n                                  2 - Centered gaussian "
     "excitation in free space"
+    "\n                                  3 - Centered gaussian, lossy "
+    "conductor on the north side"
     "\n                             3D : 0 - Half air half water, "
     "west-to-east gaussian"
     "\n                                  1 - Air with high permittivity "
     "centered object"
+    "\n                                  2 - Half air half sea water "
+    "(lossy)"
     "\n  -x --size-x              : Size of the domain (e.g. 0.00001)"
     "\n  -y --size-y              : Size of the domain (e.g. 0.00001)"
     "\n  -z --size-z              : Size of the domain (e.g. 0.00001)"
@@ -88,6 +129,111 @@ static const char help_string[] =
     "reached"
     "\n  -i --num-iterations      : Stop the simulation after the specified "
     "amount of solver iterations"
+    "\n  -n --threads             : Number of threads used by the solver "
+    "(default: OpenMP runtime choice)"
+    "\n  -e --engine              : Parallel time loop strategy"
+    "\n                             2D : serial     - Sequential kernels "
+    "(default)"
+    "\n                                  persistent - One thread team for the "
+    "whole time loop"
+    "\n                             3D : fork-join     - One thread team per "
+    "kernel (default)"
+    "\n                                  persistent    - One thread team for "
+    "the whole time loop"
+    "\n                                  split-phase   - Persistent team "
+    "overlapping the MPI halo exchanges with the interior update"
+    "\n                                  work-stealing - Tiles balanced over "
+    "per-thread queues"
+    "\n                                  temporal-blocking - Tiles advanced by "
+    "several steps, in wavefronts"
+    "\n  -k --kernel              : Sweeps of the 3D field updates"
+    "\n                             per-component - One pass per field "
+    "component (default)"
+    "\n                             fused         - One pass updating the "
+    "three components"
+    "\n                             fused-cpml    - Fused pass also applying "
+    "the CPML corrections"
+    "\n  -D --time-tile-depth     : Time steps advanced per tile by the 3D "
+    "temporal-blocking engine (default 4)"
+    "\n  -B --tile-shape          : Cache tiles IxJxK of the 3D updates, 0 "
+    "for a whole axis (default: $FDTD_TILE_SHAPE, else untiled)";
+
+// Kept apart from help_string to stay within the C99 string literal limit
+static const char placement_help_string[] =
+    "\n  -m --memory-placement    : NUMA placement of the 2D and 3D arrays"
+    "\n                             default     - Pages owned by the first "
+    "thread touching them"
+    "\n                             first-touch - Parallel first touch "
+    "matching the kernels"
+    "\n                             interleave  - Pages interleaved over the "
+    "NUMA nodes"
+    "\n  -A --volume-padding      : Padding of the rows and planes of the 2D "
+    "and 3D field and medium arrays"
+    "\n                             none      - Stored back to back"
+    "\n                             aligned   - Rows rounded up to whole "
+    "cache lines"
+    "\n                             staggered - Aligned rows, and rows and "
+    "planes not a multiple of 512 bytes apart (default)"
+    "\n  -H --huge-pages          : Pages backing the arrays of the 2D and 3D "
+    "solvers, reported after the run"
+    "\n                             none    - Base pages of the system "
+    "(default)"
+    "\n                             thp     - 2 MiB transparent huge pages "
+    "requested with madvise"
+    "\n                             hugetlb - Reserved 2 MiB hugetlbfs pages, "
+    "else transparent ones"
+    "\n  -L --field-layout        : Storage of the 3D fields"
+    "\n                             separate    - One array per component "
+    "(default)"
+    "\n                             interleaved - Rows of the six components "
+    "of each cell row stored next to each other"
+    "\n                             bricked     - 8x8x8 bricks of cells "
+    "stored contiguously, the media as well"
+    "\n  -G --medium-storage      : Update coefficients of the 3D media"
+    "\n                             per-cell - Four coefficient arrays "
+    "(default)"
+    "\n                             uint8    - One byte material id per cell "
+    "and a table of up to 256 media"
+    "\n                             uint16   - Two bytes material id per cell "
+    "and a table of up to 65536 media"
+    "\n  -U --medium-tile-shape   : Tiles IxJxK of the 3D media, 0 for a "
+    "whole axis, whose uniform ones keep their coefficients in registers, or "
+    "none (default 8x8x16)"
+    "\n  -u --medium-tile-rates   : Time the row updates of the uniform and "
+    "mixed medium tiles after a verbose 3D run, in an extra sweep"
+    "\n  -p --thread-placement    : CPUs of the threads, one of the policies "
+    "or a CPU list (e.g. 0-3,8)"
+    "\n                             none       - Left to the operating "
+    "system (default)"
+    "\n                             compact    - Consecutive threads on "
+    "sibling hardware threads"
+    "\n                             scatter    - Threads spread over the "
+    "packages, then the cores"
+    "\n                             cores-only - One thread per physical core"
+    "\n                             The MPI ranks of a node follow each other "
+    "in the placement"
+    "\n  -I --kernel-isa          : Instruction set of the field update "
+    "kernels: scalar, sse2, avx2 or avx512 (default: widest supported)"
+    "\n  -R --precision           : Floating point type of the solvers, float "
+    "or double, or fp16 and bf16 for 16 bits fields updated in float "
+    "(default: double)"
+    "\n  -E --precision-report    : Compare the final fields with those of "
+    "the same run in double precision"
+    "\n  -g --process-grid        : MPI process grid of the 3D solver (e.g. "
+    "2x2x1, 0 lets MPI choose)"
+    "\n  -P --parareal            : Time slices of the experimental parallel "
+    "in time 3D solver (default: 0, disabled)"
+    "\n  -C --parareal-coarsening : Coarse propagator time step in solver "
+    "steps (default: 2), the default Courant number of the solver being "
+    "divided by it so that the coarse propagator stays stable"
+    "\n  -T --parareal-tolerance  : Relative correction ending the parareal "
+    "iterations (default: 1e-6)"
+    "\n  -b --batch               : Run the simulations listed in the file, "
+    "one line of options per run, concurrently on the worker threads"
+    "\n  -M --batch-memory        : Memory cap in MiB of the concurrent batch "
+    "runs (default: none)"
+    "\n  -S --batch-summary       : Kernel time and output of each batch run "
+    "(default: batch_summary.txt)"
     "\n  -h --help                : Print this help"
     "\n  -q --quiet               : Do not print information to the user from "
     "inside the main kernel";
@@ -98,235 +244,978 @@ static const char help_string[] =
 #define default_Sc float_cst(-1.)
 #define default_end_time float_cst(-1.)
 #define default_iteration_count 400
+#define default_batch_summary "batch_summary.txt"
+#define default_parareal_coarsening 2
+#define default_parareal_tolerance 1e-6
+
+// Parameters of one simulation, from the command line or a batch file line
+struct run_config {
+  float_type domain_size[3];
+  char *output_filename;
+  float_type Sc;
+  float_type smallest_wavelength;
+  unsigned border_cpml_width;
+  unsigned dimension;
+  unsigned setup_id; // Default to the first one for each the dimension
+  float_type end_time;
+  size_t num_iterations;
+  bool verbose;
+  const char *engine_name;
+  const char *kernel_name;
+  unsigned time_tile_depth; // 0 for the solver default
+  const char *tile_shape_name;
+  // Set by resolve_run_config
+  unsigned initialize_setup_id;
+  int engine; // Index in the engine names of the dimension, -1 for default
+  int kernel; // Index in the 3D kernel names, -1 for default
+  uintmax_t tile_shape[3]; // All 0 for untiled updates
+};
+
+static const struct run_config default_run_config = {
+    .domain_size = {default_domain_size, default_domain_size,
+                    default_domain_size},
+    .output_filename = NULL,
+    .Sc = default_Sc,
+    .smallest_wavelength = default_smallest_wavelength,
+    .border_cpml_width = default_cpml_width,
+    .dimension = 1,
+    .setup_id = 0,
+    .end_time = default_end_time,
+    .num_iterations = default_iteration_count,
+    .verbose = true,
+    .engine_name = NULL,
+    .kernel_name = NULL,
+    .time_tile_depth = 0,
+    .tile_shape_name = NULL,
+    .initialize_setup_id = 0,
+    .engine = -1,
+    .kernel = -1,
+    .tile_shape = {0, 0, 0},
+};
 
-int main(int argc, char **argv) {
-  float_type domain_size[3] = {default_domain_size, default_domain_size,
-                               default_domain_size};
-  char *output_filename = NULL;
-  float_type Sc = default_Sc;
-  float_type smallest_wavelength = default_smallest_wavelength;
-  unsigned border_cpml_width = default_cpml_width;
-  unsigned dimension = 1;
-  unsigned setup_id = 0; // Default to the first one for each the dimension
-  float_type end_time = default_end_time;
-  size_t num_iterations = default_iteration_count;
-  bool verbose = true;
+// Process wide settings, only available from the command line
+struct process_config {
+  unsigned num_threads; // 0: let the OpenMP runtime decide
+  const char *batch_filename;
+  const char *batch_summary;
+  size_t batch_memory; // MiB, 0 for no cap
+  struct fdtd3D_parareal parareal;
+  int kernel_isa; // -1 for the widest one supported
+  bool precision_report;
+  bool help;
+};
 
+static const struct process_config default_process_config = {
+    .num_threads = 0,
+    .batch_filename = NULL,
+    .batch_summary = default_batch_summary,
+    .batch_memory = 0,
+    .parareal = {.num_slices = 0,
+                 .coarsening = default_parareal_coarsening,
+                 .tolerance = default_parareal_tolerance},
+    .kernel_isa = -1,
+    .precision_report = false,
+    .help = false,
+};
+
+static const char process_options[] = "nmAHLGUupIREgPCTbMSh";
+
+// Parses the options into run, and into process for the command line. The
+// batch file lines are parsed with process set to NULL.
+static void parse_options(int argc, char **argv, struct run_config *run,
+                          struct process_config *process) {
+  optind = 0; // Full getopt reinitialization for each batch line
   while (true) {
     int sscanf_return;
     int optchar = getopt_long(argc, argv, options, opt_options, NULL);
     if (optchar == -1)
       break;
+    if (process == NULL && optchar > 0 &&
+        strchr(process_options, optchar) != NULL) {
+      fprintf(stderr, "The option -%c is not available in a batch file\n",
+              optchar);
+      exit(EXIT_FAILURE);
+    }
     switch (optchar) {
     case '1':
-      dimension = 1;
+      run->dimension = 1;
       break;
     case '2':
-      dimension = 2;
+      run->dimension = 2;
       break;
     case '3':
-      dimension = 3;
+      run->dimension = 3;
       break;
     case 'o':
       if (optarg != NULL && optarg[0] != '-' && optarg[0] != '\0') {
-        output_filename = optarg;
+        run->output_filename = optarg;
       } else {
-        output_filename = "gridData.dat";
+        run->output_filename = "gridData.dat";
         if (optarg != NULL)
           optind--;
       }
       break;
     case 'q':
-      verbose = false;
+      run->verbose = false;
       break;
     case 'x':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &domain_size[0]);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->domain_size[0]);
 #else
-      sscanf_return = sscanf(optarg, "%f", &domain_size[0]);
+      sscanf_return = sscanf(optarg, "%f", &run->domain_size[0]);
 #endif
       if (sscanf_return == EOF || sscanf_return == 0 ||
-          domain_size[0] < float_cst(0.)) {
+          run->domain_size[0] < float_cst(0.)) {
         fprintf(stderr,
                 "Please enter a positive floating point number for the domain "
                 "size instead of \"-%c %s\"\n",
                 optchar, optarg);
-        domain_size[0] = default_domain_size;
+        run->domain_size[0] = default_domain_size;
       }
       break;
     case 'y':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &domain_size[1]);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->domain_size[1]);
 #else
-      sscanf_return = sscanf(optarg, "%f", &domain_size[1]);
+      sscanf_return = sscanf(optarg, "%f", &run->domain_size[1]);
 #endif
       if (sscanf_return == EOF || sscanf_return == 0 ||
-          domain_size[1] < float_cst(0.)) {
+          run->domain_size[1] < float_cst(0.)) {
         fprintf(stderr,
                 "Please enter a positive floating point number for the domain "
                 "size instead of \"-%c %s\"\n",
                 optchar, optarg);
-        domain_size[1] = default_domain_size;
+        run->domain_size[1] = default_domain_size;
       }
       break;
     case 'z':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &domain_size[2]);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->domain_size[2]);
 #else
-      sscanf_return = sscanf(optarg, "%f", &domain_size[2]);
+      sscanf_return = sscanf(optarg, "%f", &run->domain_size[2]);
 #endif
       if (sscanf_return == EOF || sscanf_return == 0 ||
-          domain_size[2] < float_cst(0.)) {
+          run->domain_size[2] < float_cst(0.)) {
         fprintf(stderr,
                 "Please enter a positive floating point number for the domain "
                 "size instead of \"-%c %s\"\n",
                 optchar, optarg);
-        domain_size[2] = default_domain_size;
+        run->domain_size[2] = default_domain_size;
       }
       break;
     case 'a':
-      sscanf_return = sscanf(optarg, "%u", &border_cpml_width);
+      sscanf_return = sscanf(optarg, "%u", &run->border_cpml_width);
       if (sscanf_return == EOF || sscanf_return == 0) {
         fprintf(stderr,
                 "Please enter a positive integer for the cpml thickness "
                 "instead of \"-%c %s\"\n",
                 optchar, optarg);
-        border_cpml_width = default_cpml_width;
+        run->border_cpml_width = default_cpml_width;
       }
       break;
     case 's':
-      sscanf_return = sscanf(optarg, "%u", &setup_id);
+      sscanf_return = sscanf(optarg, "%u", &run->setup_id);
       if (sscanf_return == EOF || sscanf_return == 0) {
         fprintf(stderr,
                 "Please enter a positive integer for the setup id instead of "
                 "\"-%c %s\"\n",
                 optchar, optarg);
-        setup_id = 0;
+        run->setup_id = 0;
       }
       break;
     case 'i':
-      sscanf_return = sscanf(optarg, "%zu", &num_iterations);
+      sscanf_return = sscanf(optarg, "%zu", &run->num_iterations);
       if (sscanf_return == EOF || sscanf_return == 0) {
         fprintf(stderr,
                 "Please enter a positive integer for the number of iterations "
                 "instead of "
                 "\"-%c %s\"\n",
                 optchar, optarg);
-        num_iterations = 0;
+        run->num_iterations = 0;
+      }
+      break;
+    case 'n':
+      sscanf_return = sscanf(optarg, "%u", &process->num_threads);
+      if (sscanf_return == EOF || sscanf_return == 0 ||
+          process->num_threads == 0) {
+        fprintf(stderr,
+                "Please enter a positive integer for the number of threads "
+                "instead of \"-%c %s\"\n",
+                optchar, optarg);
+        process->num_threads = 0;
+      }
+      break;
+    case 'e':
+      run->engine_name = optarg;
+      break;
+    case 'k':
+      run->kernel_name = optarg;
+      break;
+    case 'B':
+      run->tile_shape_name = optarg;
+      break;
+    case 'D':
+      sscanf_return = sscanf(optarg, "%u", &run->time_tile_depth);
+      if (sscanf_return == EOF || sscanf_return == 0 ||
+          run->time_tile_depth == 0) {
+        fprintf(stderr,
+                "Please enter a positive integer for the time tile depth "
+                "instead of \"-%c %s\"\n",
+                optchar, optarg);
+        run->time_tile_depth = 0;
       }
       break;
+    case 'm': {
+      enum fdtd_memory_placement placement = 0;
+      while (placement < num_memory_placements &&
+             strcmp(optarg, fdtd_memory_placement_name[placement]) != 0)
+        placement++;
+      if (placement == num_memory_placements) {
+        fprintf(stderr, "Unknown memory placement \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      fdtd_set_memory_placement(placement);
+    } break;
+    case 'A': {
+      enum fdtd_volume_padding padding = 0;
+      while (padding < num_volume_paddings &&
+             strcmp(optarg, fdtd_volume_padding_name[padding]) != 0)
+        padding++;
+      if (padding == num_volume_paddings) {
+        fprintf(stderr, "Unknown volume padding \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      fdtd_set_volume_padding(padding);
+    } break;
+    case 'H': {
+      enum fdtd_huge_pages mode = 0;
+      while (mode < num_huge_page_modes &&
+             strcmp(optarg, fdtd_huge_pages_name[mode]) != 0)
+        mode++;
+      if (mode == num_huge_page_modes) {
+        fprintf(stderr, "Unknown huge pages \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      fdtd_set_huge_pages(mode);
+    } break;
+    case 'L': {
+      enum fdtd3D_field_layout layout = 0;
+      while (layout < num_field_layouts3D &&
+             strcmp(optarg, fdtd3D_field_layout_name[layout]) != 0)
+        layout++;
+      if (layout == num_field_layouts3D) {
+        fprintf(stderr, "Unknown field layout \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      fdtd3D_set_field_layout(layout);
+    } break;
+    case 'G': {
+      enum fdtd3D_medium_storage storage = 0;
+      while (storage < num_medium_storages3D &&
+             strcmp(optarg, fdtd3D_medium_storage_name[storage]) != 0)
+        storage++;
+      if (storage == num_medium_storages3D) {
+        fprintf(stderr, "Unknown medium storage \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      fdtd3D_set_medium_storage(storage);
+    } break;
+    case 'U': {
+      uintmax_t shape[3];
+      if (strcmp(optarg, "none") == 0) {
+        fdtd3D_set_medium_tile_shape(NULL);
+      } else if (sscanf(optarg, "%jux%jux%ju", &shape[0], &shape[1],
+                        &shape[2]) == 3) {
+        fdtd3D_set_medium_tile_shape(shape);
+      } else {
+        fprintf(stderr,
+                "Please enter the medium tile shape as IxJxK or none instead "
+                "of \"-%c %s\"\n",
+                optchar, optarg);
+        exit(EXIT_FAILURE);
+      }
+    } break;
+    case 'p':
+      if (optarg[0] >= '0' && optarg[0] <= '9') {
+        if (!fdtd_set_affinity_cpu_list(optarg)) {
+          fprintf(stderr, "Please enter the CPU list as 0-3,8 instead of "
+                          "\"-%c %s\"\n",
+                  optchar, optarg);
+          exit(EXIT_FAILURE);
+        }
+      } else {
+        enum fdtd_affinity_policy policy = 0;
+        while (policy < affinity_list &&
+               strcmp(optarg, fdtd_affinity_policy_name[policy]) != 0)
+          policy++;
+        if (policy == affinity_list) {
+          fprintf(stderr, "Unknown thread placement \"%s\"\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        fdtd_set_affinity_policy(policy);
+      }
+      break;
+    case 'I': {
+      enum fdtd_kernel_isa isa = 0;
+      while (isa < num_kernel_isas &&
+             strcmp(optarg, fdtd_kernel_isa_name[isa]) != 0)
+        isa++;
+      if (isa == num_kernel_isas) {
+        fprintf(stderr, "Unknown kernel instruction set \"%s\"\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      process->kernel_isa = (int)isa;
+    } break;
+    case 'R':
+      // Selected by main before the solvers of the precision are entered
+      break;
+    case 'E':
+      process->precision_report = true;
+      break;
+    case 'u':
+      fdtd3D_set_medium_tile_rates(true);
+      break;
+    case 'g': {
+      int process_grid[3];
+      sscanf_return = sscanf(optarg, "%dx%dx%d", &process_grid[0],
+                             &process_grid[1], &process_grid[2]);
+      if (sscanf_return != 3 || process_grid[0] < 0 || process_grid[1] < 0 ||
+          process_grid[2] < 0) {
+        fprintf(stderr,
+                "Please enter the process grid as PxQxR instead of "
+                "\"-%c %s\"\n",
+                optchar, optarg);
+        exit(EXIT_FAILURE);
+      }
+#ifdef FDTD_USE_MPI
+      fdtd3D_set_process_grid(process_grid);
+#else
+      fprintf(stderr, "Ignoring the process grid: fdtd was compiled without "
+                      "MPI support\n");
+#endif
+    } break;
     case 'c':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &Sc);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->Sc);
 #else
-      sscanf_return = sscanf(optarg, "%f", &Sc);
+      sscanf_return = sscanf(optarg, "%f", &run->Sc);
 #endif
-      if (sscanf_return == EOF || sscanf_return == 0 || Sc < float_cst(0.)) {
+      if (sscanf_return == EOF || sscanf_return == 0 ||
+          run->Sc < float_cst(0.)) {
         fprintf(
             stderr,
             "Please enter a positive floating point number for the "
             "Courant-Friedrichs-Levy stability value instead of \"-%c %s\"\n",
             optchar, optarg);
-        Sc = default_Sc;
+        run->Sc = default_Sc;
       }
       break;
     case 't':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &end_time);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->end_time);
 #else
-      sscanf_return = sscanf(optarg, "%f", &end_time);
+      sscanf_return = sscanf(optarg, "%f", &run->end_time);
 #endif
       if (sscanf_return == EOF || sscanf_return == 0 ||
-          end_time < float_cst(0.)) {
+          run->end_time < float_cst(0.)) {
         fprintf(stderr,
                 "Please enter a positive floating point number for the "
                 "simulation end time instead of \"-%c %s\"\n",
                 optchar, optarg);
-        end_time = default_end_time;
+        run->end_time = default_end_time;
       }
       break;
     case 'w':
-#if float_type == double
-      sscanf_return = sscanf(optarg, "%lf", &smallest_wavelength);
+#ifdef FDTD_USE_DOUBLE
+      sscanf_return = sscanf(optarg, "%lf", &run->smallest_wavelength);
 #else
-      sscanf_return = sscanf(optarg, "%f", &smallest_wavelength);
+      sscanf_return = sscanf(optarg, "%f", &run->smallest_wavelength);
 #endif
       if (sscanf_return == EOF || sscanf_return == 0 ||
-          smallest_wavelength < float_cst(0.)) {
+          run->smallest_wavelength < float_cst(0.)) {
         fprintf(
             stderr,
             "Please enter a positive floating point number for the "
             "Courant-Friedrichs-Levy stability value instead of \"-%c %s\"\n",
             optchar, optarg);
-        smallest_wavelength = default_smallest_wavelength;
+        run->smallest_wavelength = default_smallest_wavelength;
+      }
+      break;
+    case 'P':
+      sscanf_return = sscanf(optarg, "%u", &process->parareal.num_slices);
+      if (sscanf_return == EOF || sscanf_return == 0) {
+        fprintf(stderr,
+                "Please enter a positive integer for the number of parareal "
+                "slices instead of \"-%c %s\"\n",
+                optchar, optarg);
+        process->parareal.num_slices = 0;
       }
       break;
+    case 'C':
+      sscanf_return = sscanf(optarg, "%u", &process->parareal.coarsening);
+      if (sscanf_return == EOF || sscanf_return == 0 ||
+          process->parareal.coarsening == 0) {
+        fprintf(stderr,
+                "Please enter a positive integer for the parareal coarsening "
+                "instead of \"-%c %s\"\n",
+                optchar, optarg);
+        process->parareal.coarsening = default_parareal_coarsening;
+      }
+      break;
+    case 'T':
+      sscanf_return = sscanf(optarg, "%lf", &process->parareal.tolerance);
+      if (sscanf_return == EOF || sscanf_return == 0 ||
+          process->parareal.tolerance < 0.) {
+        fprintf(stderr,
+                "Please enter a positive floating point number for the "
+                "parareal tolerance instead of \"-%c %s\"\n",
+                optchar, optarg);
+        process->parareal.tolerance = default_parareal_tolerance;
+      }
+      break;
+    case 'b':
+      process->batch_filename = optarg;
+      break;
+    case 'M':
+      sscanf_return = sscanf(optarg, "%zu", &process->batch_memory);
+      if (sscanf_return == EOF || sscanf_return == 0) {
+        fprintf(stderr,
+                "Please enter a positive integer for the batch memory cap in "
+                "MiB instead of \"-%c %s\"\n",
+                optchar, optarg);
+        process->batch_memory = 0;
+      }
+      break;
+    case 'S':
+      process->batch_summary = optarg;
+      break;
     case 'h':
-      printf("Usage: %s <options>\n%s\n", argv[0], help_string);
-      return EXIT_SUCCESS;
+      process->help = true;
+      break;
     }
   }
+}
 
-  unsigned initialize_setup_id;
-  switch (dimension) {
+// Checks the setup and engine of the run and fills the dimension defaults.
+// The default Courant number of a parareal run is the one of its coarse
+// propagator, parareal being NULL otherwise.
+static void resolve_run_config(struct run_config *run,
+                               const struct fdtd3D_parareal *parareal) {
+  switch (run->dimension) {
   case 1: {
-    if (setup_id >= last_1D_setup) {
+    if (run->setup_id >= last_1D_setup) {
       fprintf(stderr,
               "The input setup id %u does not map to any available 1D setup\n",
-              setup_id);
+              run->setup_id);
       exit(EXIT_FAILURE);
     }
-    initialize_setup_id = setup_id;
-    if (Sc == default_Sc) {
-      Sc = float_cst(1.);
+    run->initialize_setup_id = run->setup_id;
+    if (run->Sc == default_Sc) {
+      run->Sc = float_cst(1.);
     }
   } break;
   case 2: {
-    if (setup_id >= last_2D_setup - last_1D_setup - 1) {
+    if (run->setup_id >= last_2D_setup - last_1D_setup - 1) {
       fprintf(stderr,
               "The input setup id %u does not map to any available 2D setup\n",
-              setup_id);
+              run->setup_id);
       exit(EXIT_FAILURE);
     }
-    initialize_setup_id = setup_id + last_1D_setup + 1;
-    if (Sc == default_Sc) {
-      Sc = float_cst(1.) / sqrt(float_cst(3.));
+    run->initialize_setup_id = run->setup_id + last_1D_setup + 1;
+    if (run->Sc == default_Sc) {
+      run->Sc = float_cst(1.) / sqrt(float_cst(3.));
     }
   } break;
   case 3: {
-    if (setup_id >= last_3D_setup - last_2D_setup - 1) {
+    if (run->setup_id >= last_3D_setup - last_2D_setup - 1) {
       fprintf(stderr,
               "The input setup id %u does not map to any available 3D setup\n",
-              setup_id);
+              run->setup_id);
       exit(EXIT_FAILURE);
     }
-    initialize_setup_id = setup_id + last_2D_setup + 1;
-    if (Sc == default_Sc) {
-      Sc = float_cst(1.) / sqrt(float_cst(4.));
+    run->initialize_setup_id = run->setup_id + last_2D_setup + 1;
+    if (run->Sc == default_Sc) {
+      run->Sc = float_cst(1.) / sqrt(float_cst(4.));
+      if (parareal != NULL)
+        run->Sc /= (float_type)parareal->coarsening;
     }
   } break;
   }
 
+  if (run->engine_name != NULL) {
+    switch (run->dimension) {
+    case 2: {
+      enum fdtd2D_engine engine = 0;
+      while (engine < num_engines2D &&
+             strcmp(run->engine_name, fdtd2D_engine_name[engine]) != 0)
+        engine++;
+      if (engine == num_engines2D) {
+        fprintf(stderr, "Unknown 2D engine \"%s\"\n", run->engine_name);
+        exit(EXIT_FAILURE);
+      }
+      run->engine = (int)engine;
+    } break;
+    case 3: {
+      enum fdtd3D_engine engine = 0;
+      while (engine < num_engines3D &&
+             strcmp(run->engine_name, fdtd3D_engine_name[engine]) != 0)
+        engine++;
+      if (engine == num_engines3D) {
+        fprintf(stderr, "Unknown 3D engine \"%s\"\n", run->engine_name);
+        exit(EXIT_FAILURE);
+      }
+      run->engine = (int)engine;
+    } break;
+    default:
+      fprintf(stderr, "The engine selection is not available for the 1D "
+                      "solver, ignoring \"%s\"\n",
+              run->engine_name);
+      break;
+    }
+  }
+
+  // The command line shape takes precedence over the environment
+  const char *tile_shape_name = run->tile_shape_name;
+  if (tile_shape_name == NULL && run->dimension == 3)
+    tile_shape_name = getenv("FDTD_TILE_SHAPE");
+  if (tile_shape_name != NULL) {
+    if (run->dimension != 3) {
+      fprintf(stderr, "The tile shape is only used by the 3D solver, "
+                      "ignoring \"%s\"\n",
+              tile_shape_name);
+    } else if (sscanf(tile_shape_name, "%jux%jux%ju", &run->tile_shape[0],
+                      &run->tile_shape[1], &run->tile_shape[2]) != 3) {
+      fprintf(stderr, "Please enter the tile shape as IxJxK instead of "
+                      "\"%s\"\n",
+              tile_shape_name);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (run->time_tile_depth > 0 && run->dimension != 3)
+    fprintf(stderr, "The time tile depth is only used by the 3D solver, "
+                    "ignoring %u\n",
+            run->time_tile_depth);
+
+  if (run->kernel_name != NULL) {
+    if (run->dimension != 3) {
+      fprintf(stderr, "The kernel selection is only available for the 3D "
+                      "solver, ignoring \"%s\"\n",
+              run->kernel_name);
+    } else {
+      enum fdtd3D_kernel kernel = 0;
+      while (kernel < num_kernels3D &&
+             strcmp(run->kernel_name, fdtd3D_kernel_name[kernel]) != 0)
+        kernel++;
+      if (kernel == num_kernels3D) {
+        fprintf(stderr, "Unknown 3D kernel \"%s\"\n", run->kernel_name);
+        exit(EXIT_FAILURE);
+      }
+      run->kernel = (int)kernel;
+    }
+  }
+}
+
+// Initializes, runs, dumps and frees one simulation, returns its kernel time.
+// The batch runs skip the placement report and the MPI synchronizations. The
+// 3D grids are advanced by the parareal driver when parareal is not NULL,
+// and the final fields are copied to snapshot when it is not NULL.
+static double run_simulation(const struct run_config *run, bool batch,
+                             const struct fdtd3D_parareal *parareal,
+                             bool is_root,
+                             struct fdtd_field_snapshot *snapshot) {
+  float_type domain_size[3] = {run->domain_size[0], run->domain_size[1],
+                               run->domain_size[2]};
   struct fdtd fdtd =
-      initializeFdtd_cmpl(initialize_setup_id, domain_size, Sc,
-                          smallest_wavelength, border_cpml_width);
-
-  float_type stop_time;
-  if (end_time > float_cst(0.)) {
-    stop_time = end_time;
-  } else {
-    stop_time = (float_type)num_iterations * get_time_step_fdtd(&fdtd);
+      initializeFdtd_cmpl(run->initialize_setup_id, domain_size, run->Sc,
+                          run->smallest_wavelength, run->border_cpml_width);
+
+  if (fdtd.type != fdtd_one_dim && is_root && !batch)
+    fdtd_print_padding_stats(stderr);
+
+  if (run->engine >= 0) {
+    if (fdtd.type == fdtd_two_dims)
+      fdtd.twoDims.engine = (enum fdtd2D_engine)run->engine;
+    else if (fdtd.type == fdtd_three_dims)
+      fdtd.threeDims.engine = (enum fdtd3D_engine)run->engine;
+  }
+  if (run->kernel >= 0 && fdtd.type == fdtd_three_dims)
+    fdtd.threeDims.kernel = (enum fdtd3D_kernel)run->kernel;
+  if (run->time_tile_depth > 0 && fdtd.type == fdtd_three_dims)
+    fdtd.threeDims.time_tile_depth = run->time_tile_depth;
+  if (fdtd.type == fdtd_three_dims)
+    memcpy(fdtd.threeDims.tile_shape, run->tile_shape,
+           sizeof(run->tile_shape));
+
+  size_t num_steps = run->num_iterations;
+  if (run->end_time > float_cst(0.)) {
+    // Steps of the time accumulated up to the end time
+    const float_type dt = get_time_step_fdtd(&fdtd);
+    num_steps = 0;
+    for (float_type time = float_cst(0.); time < run->end_time; time += dt)
+      num_steps++;
   }
   time_measure startTime, endTime;
+#ifdef FDTD_USE_MPI
+  if (!batch)
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
   get_current_time(&startTime);
-  run_fdtd(&fdtd, stop_time, verbose);
+  if (parareal != NULL && fdtd.type == fdtd_three_dims)
+    run_3D_parareal(&fdtd.threeDims, num_steps, parareal, run->verbose);
+  else
+    run_fdtd(&fdtd, num_steps, run->verbose);
+#ifdef FDTD_USE_MPI
+  if (!batch)
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
   get_current_time(&endTime);
-  fprintf(stdout, "Kernel time %.4fs\n",
-          measuring_difftime(startTime, endTime));
-  if (output_filename) {
-    dump_fdtd(&fdtd, output_filename, dump_ez);
+  // After the run, the pages landing on their nodes and the transparent huge
+  // pages being faulted in by the first touch of the kernels
+  if (fdtd.type == fdtd_two_dims && is_root && !batch) {
+    fdtd_print_huge_pages(stderr, &fdtd.twoDims.arena);
+  } else if (fdtd.type == fdtd_three_dims && is_root && !batch) {
+    print_memory_placement_3D(&fdtd.threeDims, stderr);
+    fdtd_print_huge_pages(stderr, &fdtd.threeDims.arena);
+  }
+  if (run->output_filename) {
+    dump_fdtd(&fdtd, run->output_filename, dump_ez);
+  }
+  if (snapshot != NULL) {
+    snapshot_fdtd(&fdtd, snapshot);
+    snapshot->num_steps = num_steps;
   }
   free_fdtd(&fdtd);
+  return measuring_difftime(startTime, endTime);
+}
+
+// One line of the batch file
+struct batch_run {
+  unsigned line_number;
+  char *options;   // Line as written in the file
+  char *arguments; // Tokenized copy of the line referenced by argv
+  char **argv;
+  struct run_config config;
+  size_t memory; // Upper bound of the memory used by the run
+  double kernel_time;
+};
+
+static size_t read_batch_file(const char *filename, char *program_name,
+                              struct batch_run **runs) {
+  FILE *in = fopen(filename, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Unable to open the batch file \"%s\"\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  size_t num_runs = 0, allocated = 0;
+  *runs = NULL;
+  char *line = NULL;
+  size_t line_size = 0;
+  unsigned line_number = 0;
+  while (getline(&line, &line_size, in) != -1) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    const char *first = line + strspn(line, " \t");
+    if (*first == '\0' || *first == '#')
+      continue;
+    if (num_runs == allocated) {
+      allocated = allocated == 0 ? 16 : 2 * allocated;
+      *runs = realloc(*runs, allocated * sizeof(**runs));
+    }
+    struct batch_run *run = &(*runs)[num_runs++];
+    run->line_number = line_number;
+    run->options = strdup(first);
+    run->arguments = strdup(first);
+    // At most one argument every two characters, plus the program name
+    run->argv = calloc(strlen(first) / 2 + 3, sizeof(*run->argv));
+    int argc = 0;
+    run->argv[argc++] = program_name;
+    char *saveptr;
+    for (char *token = strtok_r(run->arguments, " \t", &saveptr);
+         token != NULL; token = strtok_r(NULL, " \t", &saveptr))
+      run->argv[argc++] = token;
+    run->config = default_run_config;
+    parse_options(argc, run->argv, &run->config, NULL);
+    run->config.verbose = false; // Concurrent runs would mix their progress
+    resolve_run_config(&run->config, NULL);
+    run->memory = fdtd_memory_footprint(
+        run->config.initialize_setup_id, run->config.domain_size,
+        run->config.smallest_wavelength, run->config.border_cpml_width);
+    run->kernel_time = 0.;
+  }
+  free(line);
+  fclose(in);
+  return num_runs;
+}
+
+// Runs the batch file simulations on the OpenMP threads, each run on one
+// thread. A run starts only when the memory of the active runs plus its own
+// fits in the cap, the arenas freed by the finished runs are reused.
+static void run_batch(const struct process_config *process,
+                      char *program_name) {
+  struct batch_run *runs;
+  const size_t num_runs =
+      read_batch_file(process->batch_filename, program_name, &runs);
+  const size_t MiB = 1024 * 1024;
+  const size_t memory_cap = process->batch_memory * MiB;
+  for (size_t r = 0; r < num_runs; ++r) {
+    if (memory_cap > 0 && runs[r].memory > memory_cap) {
+      fprintf(stderr,
+              "The run of line %u needs %.1f MiB, more than the batch memory "
+              "cap\n",
+              runs[r].line_number, (double)runs[r].memory / (double)MiB);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  fdtd_set_buffer_recycling(true);
+  size_t next_run = 0, reserved_memory = 0;
+  unsigned num_workers = 1;
+  time_measure startTime, endTime;
+  get_current_time(&startTime);
+#pragma omp parallel
+  {
+#ifdef _OPENMP
+#pragma omp master
+    num_workers = (unsigned)omp_get_num_threads();
+#endif
+    while (true) {
+      size_t run = num_runs;
+      bool wait = false;
+#pragma omp critical(batch_schedule)
+      if (next_run < num_runs) {
+        const size_t needed = runs[next_run].memory;
+        if (memory_cap == 0 || reserved_memory + needed <= memory_cap) {
+          // The cached volumes count in the cap as well
+          if (memory_cap > 0)
+            fdtd_trim_buffer_cache(memory_cap - reserved_memory - needed);
+          reserved_memory += needed;
+          run = next_run++;
+        } else {
+          wait = true;
+        }
+      }
+      if (run == num_runs) {
+        if (!wait)
+          break;
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000}, NULL);
+        continue;
+      }
+      // Own team so that the orphaned worksharing of the solvers does not
+      // bind to the batch workers
+#pragma omp parallel num_threads(1)
+      {
+        // A larger cached mapping would exceed what the cap admitted
+        if (memory_cap > 0)
+          fdtd_set_buffer_reuse_limit(runs[run].memory);
+        runs[run].kernel_time =
+            run_simulation(&runs[run].config, true, NULL, true, NULL);
+      }
+#pragma omp critical(batch_schedule)
+      reserved_memory -= runs[run].memory;
+    }
+  }
+  get_current_time(&endTime);
+  const double wall_time = measuring_difftime(startTime, endTime);
+
+  FILE *summary = fopen(process->batch_summary, "w");
+  if (summary == NULL) {
+    fprintf(stderr, "Unable to open the batch summary \"%s\"\n",
+            process->batch_summary);
+    exit(EXIT_FAILURE);
+  }
+  struct fdtd_buffer_cache_stats stats = fdtd_get_buffer_cache_stats();
+  fprintf(summary, "# Batch %s: %zu runs on %u workers in %.4fs\n",
+          process->batch_filename, num_runs, num_workers, wall_time);
+  fprintf(summary, "# Memory cap %zu MiB, %zu of %zu arenas reused\n",
+          process->batch_memory, stats.reused, stats.allocations);
+  fprintf(summary, "# line kernel_time(s) memory(MiB) output options\n");
+  for (size_t r = 0; r < num_runs; ++r) {
+    fprintf(summary, "%u %.4f %.1f %s %s\n", runs[r].line_number,
+            runs[r].kernel_time, (double)runs[r].memory / (double)MiB,
+            runs[r].config.output_filename != NULL
+                ? runs[r].config.output_filename
+                : "-",
+            runs[r].options);
+  }
+  fclose(summary);
+  printf("Batch of %zu runs done in %.4fs, summary written to %s\n", num_runs,
+         wall_time, process->batch_summary);
+
+  fdtd_trim_buffer_cache(0);
+  for (size_t r = 0; r < num_runs; ++r) {
+    free(runs[r].options);
+    free(runs[r].arguments);
+    free(runs[r].argv);
+  }
+  free(runs);
+}
+
+#ifdef FDTD_USE_DOUBLE
+void fdtd_reference_fields(int argc, char **argv, size_t num_steps,
+                           struct fdtd_field_snapshot *reference) {
+  struct run_config run = default_run_config;
+  struct process_config process = default_process_config;
+  parse_options(argc, argv, &run, &process);
+  // The steps of the compared run rather than those of its end time, which
+  // the time accumulated in double reaches after a different count
+  run.end_time = default_end_time;
+  run.num_iterations = num_steps;
+  run.output_filename = NULL;
+  run.verbose = false;
+  resolve_run_config(
+      &run, process.parareal.num_slices > 0 ? &process.parareal : NULL);
+  fdtd_set_kernel_isa(fdtd_detect_kernel_isa());
+  run_simulation(&run, true, NULL, true, reference);
+}
+#endif
+
+int fdtd_main(int argc, char **argv) {
+  struct run_config run = default_run_config;
+  struct process_config process = default_process_config;
+  bool is_root = true; // Prints the reports (MPI rank 0)
+
+#ifdef FDTD_USE_MPI
+  // Only the master thread of the OpenMP teams communicates
+  int mpi_thread_support, mpi_rank, mpi_size;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &mpi_thread_support);
+  MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+  is_root = mpi_rank == 0;
+  if (mpi_thread_support < MPI_THREAD_FUNNELED && is_root)
+    fprintf(stderr, "The MPI library does not support OpenMP threads\n");
+#endif
+
+  parse_options(argc, argv, &run, &process);
+  if (process.help) {
+    if (is_root)
+      printf("Usage: %s <options>\n%s%s\n", argv[0], help_string,
+             placement_help_string);
+#ifdef FDTD_USE_MPI
+    MPI_Finalize();
+#endif
+    return EXIT_SUCCESS;
+  }
+
+  if (process.num_threads > 0) {
+#ifdef _OPENMP
+    omp_set_num_threads((int)process.num_threads);
+#else
+    fprintf(stderr, "Ignoring the number of threads: fdtd was compiled "
+                    "without OpenMP support\n");
+#endif
+  }
+  unsigned first_thread = 0; // Of the process among the threads of its node
+#ifdef FDTD_USE_MPI
+  {
+    // The ranks sharing a node follow each other in the thread placement
+    MPI_Comm node;
+    int node_rank;
+    unsigned num_threads = 1;
+#ifdef _OPENMP
+    num_threads = (unsigned)omp_get_max_threads();
+#endif
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, mpi_rank,
+                        MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &node_rank);
+    MPI_Exscan(&num_threads, &first_thread, 1, MPI_UNSIGNED, MPI_SUM, node);
+    if (node_rank == 0)
+      first_thread = 0;
+    MPI_Comm_free(&node);
+  }
+#endif
+  fdtd_apply_affinity(is_root ? stderr : NULL, first_thread);
+
+  const enum fdtd_kernel_isa detected_isa = fdtd_detect_kernel_isa();
+  const enum fdtd_kernel_isa kernel_isa =
+      process.kernel_isa >= 0 ? (enum fdtd_kernel_isa)process.kernel_isa
+                              : detected_isa;
+  if (!fdtd_set_kernel_isa(kernel_isa)) {
+    if (is_root)
+      fprintf(stderr, "The %s kernels are not supported by this CPU or "
+                      "build\n",
+              fdtd_kernel_isa_name[kernel_isa]);
+#ifdef FDTD_USE_MPI
+    MPI_Finalize();
+#endif
+    exit(EXIT_FAILURE);
+  }
+  if (is_root && run.verbose)
+    fprintf(stderr,
+            "Field update kernels: %s (widest supported %s), %s precision\n",
+            fdtd_kernel_isa_name[kernel_isa],
+            fdtd_kernel_isa_name[detected_isa],
+            fdtd_precision_name[field_type_precision]);
+
+  if (process.precision_report && process.batch_filename != NULL) {
+    fprintf(stderr, "The precision report is not available in batch mode\n");
+    exit(EXIT_FAILURE);
+  }
+  if (process.batch_filename != NULL) {
+#ifdef FDTD_USE_MPI
+    if (mpi_size > 1) {
+      if (is_root)
+        fprintf(stderr, "The batch mode runs on a single MPI process\n");
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    // The worker threads must not call MPI
+    fdtd3D_enable_decomposition(false);
+#endif
+    run_batch(&process, argv[0]);
+#ifdef FDTD_USE_MPI
+    MPI_Finalize();
+#endif
+    return EXIT_SUCCESS;
+  }
+
+#ifdef FDTD_USE_MPI
+  if (mpi_size > 1) {
+    if (run.dimension != 3) {
+      if (is_root)
+        fprintf(stderr, "Only the 3D solver runs on several MPI processes\n");
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    if (process.parareal.num_slices > 0) {
+      if (is_root)
+        fprintf(stderr, "The parareal mode runs on a single MPI process\n");
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    if (process.precision_report) {
+      if (is_root)
+        fprintf(stderr, "The precision report runs on a single MPI process\n");
+      MPI_Finalize();
+      exit(EXIT_FAILURE);
+    }
+    run.verbose = run.verbose && is_root;
+  }
+#endif
+
+  resolve_run_config(
+      &run, process.parareal.num_slices > 0 ? &process.parareal : NULL);
+  if (process.parareal.num_slices > 0 && run.dimension != 3) {
+    fprintf(stderr, "The parareal mode is only available for the 3D solver\n");
+    exit(EXIT_FAILURE);
+  }
+  struct fdtd_field_snapshot fields;
+  double kernel_time = run_simulation(
+      &run, false, process.parareal.num_slices > 0 ? &process.parareal : NULL,
+      is_root, process.precision_report ? &fields : NULL);
+  if (is_root)
+    fprintf(stdout, "Kernel time %.4fs\n", kernel_time);
+  if (process.precision_report) {
+    struct fdtd_field_snapshot reference;
+    fdtd_reference_fields_double(argc, argv, fields.num_steps, &reference);
+    fdtd_print_precision_report(stdout, field_type_precision, &fields,
+                                &reference);
+    fdtd_free_field_snapshot(&fields);
+    fdtd_free_field_snapshot(&reference);
+  }
+#ifdef FDTD_USE_MPI
+  MPI_Finalize();
+#endif
 
   return EXIT_SUCCESS;
 }